@@ -0,0 +1,189 @@
+#include <model/aabb-tree.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace leo;
+
+/* Builds an AABBTree over random boxes, moves them around and checks every kind of query against a
+   * brute force walk over the same enlarged leaf bounds, timing both.
+   * Usage: AABBTreeBenchmark [number of boxes]
+   */
+
+namespace
+{
+
+typedef std::chrono::high_resolution_clock Clock;
+
+double getMilliseconds(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool intersectsRay(const AABB &box, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance)
+{
+  float enter = 0.f;
+  float exit = maxDistance;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    float t0 = (box.min[axis] - origin[axis]) / direction[axis];
+    float t1 = (box.max[axis] - origin[axis]) / direction[axis];
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+  }
+  return enter <= exit;
+}
+
+// The results of the tree and of the brute force walk, as sorted entity lists
+bool compare(const char *query, std::vector<const Entity *> &tree, std::vector<const Entity *> &bruteForce)
+{
+  std::sort(tree.begin(), tree.end());
+  std::sort(bruteForce.begin(), bruteForce.end());
+  if (tree == bruteForce)
+    return true;
+  std::cerr << "AABBTreeBenchmark: " << query << " query returned " << tree.size() << " entities instead of "
+            << bruteForce.size() << std::endl;
+  return false;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const size_t nbBoxes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+  const int nbQueries = 200;
+  const float worldSize = 1000.f;
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> position(-worldSize, worldSize);
+  std::uniform_real_distribution<float> extent(0.5f, 5.f);
+  std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+  std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+  auto randomBox = [&](const glm::vec3 &center) {
+    AABB box;
+    glm::vec3 e(extent(random), extent(random), extent(random));
+    box.add(center - e);
+    box.add(center + e);
+    return box;
+  };
+
+  // The tree never dereferences the entities, the boxes stand in for them
+  std::vector<AABB> boxes(nbBoxes);
+  std::vector<int> proxies(nbBoxes);
+  std::vector<const Entity *> entities(nbBoxes);
+  AABBTree tree;
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < nbBoxes; ++i)
+  {
+    boxes[i] = randomBox(glm::vec3(position(random), position(random), position(random)));
+    entities[i] = reinterpret_cast<const Entity *>(&boxes[i]);
+    proxies[i] = tree.insert(boxes[i], entities[i]);
+  }
+  std::cout << "insert: " << nbBoxes << " boxes in " << getMilliseconds(start) << " ms, height " << tree.getHeight() << std::endl;
+
+  // Mostly small moves that stay in the enlarged bounds, one box in ten jumps across the world
+  start = Clock::now();
+  size_t nbMoved = 0;
+  for (size_t i = 0; i < nbBoxes; ++i)
+  {
+    glm::vec3 offset = i % 10 ? glm::vec3(step(random), step(random), step(random))
+                              : glm::vec3(position(random), position(random), position(random)) - boxes[i].getCenter();
+    boxes[i].min += offset;
+    boxes[i].max += offset;
+    nbMoved += tree.update(proxies[i], boxes[i]);
+  }
+  std::cout << "update: " << nbMoved << " of " << nbBoxes << " leaves moved in " << getMilliseconds(start) << " ms, height "
+            << tree.getHeight() << std::endl;
+
+  // A tenth of the boxes leave then come back
+  start = Clock::now();
+  for (size_t i = 0; i < nbBoxes; i += 10)
+    tree.remove(proxies[i]);
+  for (size_t i = 0; i < nbBoxes; i += 10)
+    proxies[i] = tree.insert(boxes[i], entities[i]);
+  std::cout << "remove and insert: " << (nbBoxes + 9) / 10 << " boxes in " << getMilliseconds(start) << " ms" << std::endl;
+
+  bool valid = tree.size() == nbBoxes;
+  double treeTimes[4] = {0., 0., 0., 0.};
+  double bruteForceTimes[4] = {0., 0., 0., 0.};
+  std::vector<const Entity *> treeResults, bruteForceResults;
+  for (int q = 0; q < nbQueries && valid; ++q)
+  {
+    glm::vec3 center(position(random), position(random), position(random));
+
+    // Frustum of a camera looking at a random point
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 300.f) *
+                               glm::lookAt(center, center + glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.f, 0.f, 1e-3f),
+                                           glm::vec3(0.f, 1.f, 0.f));
+    Frustum frustum(viewProjection);
+    treeResults.clear();
+    bruteForceResults.clear();
+    start = Clock::now();
+    tree.queryFrustum(frustum, treeResults);
+    treeTimes[0] += getMilliseconds(start);
+    start = Clock::now();
+    for (size_t i = 0; i < nbBoxes; ++i)
+      if (frustum.test(tree.getFatBounds(proxies[i])) != OUTSIDE_FRUSTUM)
+        bruteForceResults.push_back(entities[i]);
+    bruteForceTimes[0] += getMilliseconds(start);
+    valid = valid && compare("frustum", treeResults, bruteForceResults);
+
+    BoundingSphere sphere;
+    sphere.center = center;
+    sphere.radius = 50.f;
+    treeResults.clear();
+    bruteForceResults.clear();
+    start = Clock::now();
+    tree.querySphere(sphere, treeResults);
+    treeTimes[1] += getMilliseconds(start);
+    start = Clock::now();
+    for (size_t i = 0; i < nbBoxes; ++i)
+      if (sphere.intersects(tree.getFatBounds(proxies[i])))
+        bruteForceResults.push_back(entities[i]);
+    bruteForceTimes[1] += getMilliseconds(start);
+    valid = valid && compare("sphere", treeResults, bruteForceResults);
+
+    AABB box;
+    box.add(center - glm::vec3(40.f));
+    box.add(center + glm::vec3(40.f));
+    treeResults.clear();
+    bruteForceResults.clear();
+    start = Clock::now();
+    tree.queryBox(box, treeResults);
+    treeTimes[2] += getMilliseconds(start);
+    start = Clock::now();
+    for (size_t i = 0; i < nbBoxes; ++i)
+      if (box.intersects(tree.getFatBounds(proxies[i])))
+        bruteForceResults.push_back(entities[i]);
+    bruteForceTimes[2] += getMilliseconds(start);
+    valid = valid && compare("box", treeResults, bruteForceResults);
+
+    glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(1e-3f));
+    treeResults.clear();
+    bruteForceResults.clear();
+    start = Clock::now();
+    tree.queryRay(center, direction, worldSize, treeResults);
+    treeTimes[3] += getMilliseconds(start);
+    start = Clock::now();
+    for (size_t i = 0; i < nbBoxes; ++i)
+      if (intersectsRay(tree.getFatBounds(proxies[i]), center, direction, worldSize))
+        bruteForceResults.push_back(entities[i]);
+    bruteForceTimes[3] += getMilliseconds(start);
+    valid = valid && compare("ray", treeResults, bruteForceResults);
+  }
+
+  const char *names[4] = {"frustum", "sphere", "box", "ray"};
+  for (int i = 0; i < 4; ++i)
+  {
+    std::cout << names[i] << " queries: " << treeTimes[i] / nbQueries << " ms with the tree, " << bruteForceTimes[i] / nbQueries
+              << " ms brute force" << std::endl;
+  }
+  std::cout << (valid ? "All queries match the brute force results" : "Mismatch between the tree and the brute force results") << std::endl;
+  return valid ? 0 : 1;
+}
@@ -1,6 +1,21 @@
 #version 450 core
 
 #define MAX_NUM_LIGHTS 10
+#define MAX_TEXTURE_ARRAYS 8
+
+// Feature keys are injected by Shader::getVariant, the defaults match a material with every map
+#ifndef NB_DIRECTION_LIGHTS
+#define NB_DIRECTION_LIGHTS MAX_NUM_LIGHTS
+#define HAS_POINT_LIGHTS
+#define HAS_DIFFUSE_MAP
+#define HAS_SPECULAR_MAP
+#define HAS_NORMAL_MAP
+#define HAS_PARALLAX_MAP
+#endif
+
+#ifdef USE_BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
 
 struct UPointLight {
   vec3 ambient;
@@ -23,15 +38,29 @@ struct UDirectionLight {
 };
 
 struct Material {
-  vec3 diffuse_value;
   sampler2D diffuse_texture;
-  vec3 specular_value;
   sampler2D specular_texture;
   sampler2D reflection_map;
   sampler2D normal_map;
   sampler2D parallax_map;
-  float shininess;
   vec3 emissive_value;
+  // Texture array slot and layer of each map, slot -1 when the map is not packed
+  ivec2 diffuse_layer;
+  ivec2 specular_layer;
+  ivec2 reflection_layer;
+  ivec2 normal_layer;
+  ivec2 parallax_layer;
+};
+
+struct MaterialData {
+  vec4 diffuse;  // w: shininess
+  vec4 specular;
+  uvec2 maps[5];  // Bindless handles, only valid with USE_BINDLESS_TEXTURES
+  ivec2 layers[5];
+};
+
+layout (std430, binding = 1) readonly buffer Materials {
+  MaterialData materials[];
 };
 
 struct PBRMaterial {
@@ -51,40 +80,100 @@ layout (std140, binding = 1) uniform s1 {
   UDirectionLight udl[MAX_NUM_LIGHTS];
 };
 
+// Point lights sorted in clusters of the view frustum, see LightClusters
+layout (std430, binding = 7) readonly buffer PointLights {
+  UPointLight pointLights[];
+};
+
+layout (std430, binding = 8) readonly buffer LightClusters {
+  uvec4 clusterSize;   // Clusters along x, y and z, number of point lights
+  vec4 clusterSlices;  // x: near plane, y: depth slices per unit of log depth
+  uvec2 clusters[];    // Offset in lightIndices and number of lights
+};
+
+layout (std430, binding = 9) readonly buffer LightIndices {
+  uint lightIndices[];
+};
+
+uvec2 getLightCluster(vec2 screenPosition, float viewDepth)
+{
+  uvec2 tile = uvec2(clamp(screenPosition * vec2(clusterSize.xy), vec2(0.0), vec2(clusterSize.xy - 1u)));
+  float slice = log(max(viewDepth, clusterSlices.x) / clusterSlices.x) * clusterSlices.y;
+  uint z = uint(clamp(slice, 0.0, float(clusterSize.z - 1u)));
+  return clusters[(z * clusterSize.y + tile.y) * clusterSize.x + tile.x];
+}
+
+// Shadow maps of every light packed in one depth texture, see ShadowAtlas
+struct ShadowTile {
+  mat4 matrix;  // World space to atlas texture coordinates and depth
+  vec4 rect;    // Atlas texture coordinates of the tile, empty without a shadow
+};
+
+layout (std430, binding = 10) readonly buffer ShadowTiles {
+  vec4 shadowAtlasSize;    // xy: texels, zw: size of a texel
+  uvec4 shadowFirstTiles;  // x: direction lights, y: point lights, six tiles each
+  ShadowTile shadowTiles[];
+};
+
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 Tangent;
 in vec3 BiTangent;
 in vec3 FragPos;
-in vec4 FragPosLightSpace;
 in mat3 TBN;
+flat in uint MaterialIndex;
+
+MaterialData materialData; // Data of the current draw, set first thing in main
 
 out vec4 color;
 
+layout (std140, binding = 0) uniform FrameGlobals {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  vec4 cameraPosition;
+  vec4 time;        // x: seconds since the start, y: duration of the last frame
+  vec4 resolution;  // xy: pixels, zw: size of a pixel
+};
+
 uniform Material material;
+uniform sampler2DArray texture_arrays[MAX_TEXTURE_ARRAYS];
 uniform PBRMaterial pbrMaterial;
-uniform vec3 viewPos;
 uniform vec3 ambientLight;
-uniform sampler2D shadowMap0;
+uniform sampler2D shadowAtlas;
 
 uniform float far_plane;
-uniform vec3 lightPos0;
-uniform samplerCube shadowCubeMap0;
 
+// Samples stay inside the tile, filtering would read the neighbouring ones
+float sampleShadowTile(ShadowTile tile, vec2 texCoords)
+{
+  vec2 margin = 0.5 * shadowAtlasSize.zw;
+  return texture(shadowAtlas, clamp(texCoords, tile.rect.xy + margin, tile.rect.zw - margin)).r;
+}
 
-float computeShadow(float bias)
+float computeShadow(int light, float bias)
 {
-  vec3 projCoords = FragPosLightSpace.xyz / FragPosLightSpace.w;
-  projCoords = projCoords * 0.5 + 0.5;
-  float closestDepth = texture(shadowMap0, projCoords.xy).r;
+  uint tileIndex = shadowFirstTiles.x + uint(light);
+  if (tileIndex >= shadowFirstTiles.y)
+    return 0.0;
+  ShadowTile tile = shadowTiles[tileIndex];
+  if (tile.rect.z <= tile.rect.x)
+    return 0.0;
+  vec4 projCoords = tile.matrix * vec4(FragPos, 1.0);
+  projCoords.xyz /= projCoords.w;
+  // Outside of the light's box
+  if (any(lessThan(projCoords.xy, tile.rect.xy)) || any(greaterThan(projCoords.xy, tile.rect.zw)) || projCoords.z > 1.0)
+    return 0.0;
   float currentDepth = projCoords.z;
-  vec2 texelSize = 1.0 / textureSize(shadowMap0, 0);
+  vec2 texelSize = shadowAtlasSize.zw;
   float shadow = 0.0;
   for(int x = -1; x <= 1; ++x)
   {
     for(int y = -1; y <= 1; ++y)
     {
-        float pcfDepth = texture(shadowMap0, projCoords.xy + vec2(x, y) * texelSize).r; 
+        float pcfDepth = sampleShadowTile(tile, projCoords.xy + vec2(x, y) * texelSize);
         shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;        
     }    
   }
@@ -92,6 +181,17 @@ float computeShadow(float bias)
   return shadow;
 }
 
+// Tiles of the faces are in the order of the cube map faces: +x, -x, +y, -y, +z, -z
+float sampleShadowCube(uint firstTile, vec3 lightPosition, vec3 direction)
+{
+  vec3 axis = abs(direction);
+  uint face = axis.x >= axis.y && axis.x >= axis.z ? (direction.x > 0.0 ? 0u : 1u)
+            : (axis.y >= axis.z ? (direction.y > 0.0 ? 2u : 3u) : (direction.z > 0.0 ? 4u : 5u));
+  ShadowTile tile = shadowTiles[firstTile + face];
+  vec4 projCoords = tile.matrix * vec4(lightPosition + direction, 1.0);
+  return sampleShadowTile(tile, projCoords.xy / projCoords.w);
+}
+
 vec3 sampleOffsetDirections[20] = vec3[]
 (
    vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
@@ -101,22 +201,24 @@ vec3 sampleOffsetDirections[20] = vec3[]
    vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
 );
 
-float computePointLightShadow(float bias)
+float computePointLightShadow(uint light, vec3 lightPosition, float bias)
 {
+  uint firstTile = shadowFirstTiles.y + 6u * light;
+  if (firstTile + 6u > uint(shadowTiles.length()) || shadowTiles[firstTile].rect.z <= shadowTiles[firstTile].rect.x)
+    return 0.0;
   // get vector between fragment position and light position
-  vec3 fragToLight = FragPos - lightPos0;
+  vec3 fragToLight = FragPos - lightPosition;
   // use the light to fragment vector to sample from the depth map    
   float currentDepth = length(fragToLight);
 
-  vec2 texelSize = 1.0 / textureSize(shadowCubeMap0, 0);
   float offset  = 0.1;
   float shadow = 0.0;
   int samples  = 20;
-  float viewDistance = length(viewPos - FragPos);
+  float viewDistance = length(cameraPosition.xyz - FragPos);
   float diskRadius = (1.0 + (viewDistance / far_plane)) / 100.0;
   for(int i = 0; i < samples; ++i)
   {
-    float closestDepth = texture(shadowCubeMap0, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
+    float closestDepth = sampleShadowCube(firstTile, lightPosition, fragToLight + sampleOffsetDirections[i] * diskRadius);
     closestDepth *= far_plane;   // Undo mapping [0;1]
     if(currentDepth - bias > closestDepth)
         shadow += 1.0;
@@ -125,10 +227,32 @@ float computePointLightShadow(float bias)
   return shadow;
 }
 
+// Map and layer arguments of sampleMaterialTexture
+#ifdef USE_BINDLESS_TEXTURES
+#define MATERIAL_DIFFUSE sampler2D(materialData.maps[0]), materialData.layers[0]
+#define MATERIAL_SPECULAR sampler2D(materialData.maps[1]), materialData.layers[1]
+#define MATERIAL_REFLECTION sampler2D(materialData.maps[2]), materialData.layers[2]
+#define MATERIAL_NORMAL sampler2D(materialData.maps[3]), materialData.layers[3]
+#define MATERIAL_PARALLAX sampler2D(materialData.maps[4]), materialData.layers[4]
+#else
+#define MATERIAL_DIFFUSE material.diffuse_texture, material.diffuse_layer
+#define MATERIAL_SPECULAR material.specular_texture, material.specular_layer
+#define MATERIAL_REFLECTION material.reflection_map, material.reflection_layer
+#define MATERIAL_NORMAL material.normal_map, material.normal_layer
+#define MATERIAL_PARALLAX material.parallax_map, material.parallax_layer
+#endif
+
+vec4 sampleMaterialTexture(sampler2D map, ivec2 layer, vec2 texCoords)
+{
+  if (layer.x < 0)
+    return texture(map, texCoords);
+  return texture(texture_arrays[layer.x], vec3(texCoords, layer.y));
+}
+
 vec2 parallaxMapping(vec2 texCoords, vec3 TSviewDir)
 {
   float height_scale = 0.05;
-  float height =  texture(material.parallax_map, texCoords).r;    
+  float height =  sampleMaterialTexture(MATERIAL_PARALLAX, texCoords).r;    
   vec2 p = TSviewDir.xy / TSviewDir.z * (height * height_scale);
   return texCoords - p; 
 }
@@ -144,16 +268,16 @@ vec2 steepParallaxMapping(vec2 texCoords, vec3 TSviewDir)
   vec2 P = TSviewDir.xy * height_scale;
   vec2 deltaTexCoords = P / numLayers;
   vec2  currentTexCoords = texCoords;
-  float currentDepthMapValue = texture(material.parallax_map, currentTexCoords).r;
+  float currentDepthMapValue = sampleMaterialTexture(MATERIAL_PARALLAX, currentTexCoords).r;
   while(currentLayerDepth < currentDepthMapValue)
   {
     currentTexCoords -= deltaTexCoords;
-    currentDepthMapValue = texture(material.parallax_map, currentTexCoords).r;  
+    currentDepthMapValue = sampleMaterialTexture(MATERIAL_PARALLAX, currentTexCoords).r;  
     currentLayerDepth += layerDepth;  
   }
 
   vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
-  float beforeDepth = texture(material.parallax_map, prevTexCoords).r - currentLayerDepth + layerDepth;
+  float beforeDepth = sampleMaterialTexture(MATERIAL_PARALLAX, prevTexCoords).r - currentLayerDepth + layerDepth;
   float afterDepth  = currentDepthMapValue - currentLayerDepth;
   float weight = afterDepth / (afterDepth - beforeDepth);
   vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
@@ -164,40 +288,59 @@ vec2 steepParallaxMapping(vec2 texCoords, vec3 TSviewDir)
 
 void main()
 {
+  materialData = materials[MaterialIndex];
   // Light Variables
   vec3 norm = normalize(Normal);
   vec3 tang = normalize(Tangent);
   vec3 bita = normalize(BiTangent);
 
-  vec3 viewDir = normalize(viewPos - FragPos);
-  vec3 tangViewDir = normalize(TBN * viewPos - TBN * FragPos);
-
+  vec3 viewDir = normalize(cameraPosition.xyz - FragPos);
+#ifdef HAS_PARALLAX_MAP
+  vec3 tangViewDir = normalize(TBN * cameraPosition.xyz - TBN * FragPos);
   vec2 pTexCoords = steepParallaxMapping(TexCoords, tangViewDir);
+#else
+  vec2 pTexCoords = TexCoords;
+#endif
   /*
   if(pTexCoords.x > 1.0 || pTexCoords.y > 1.0 || pTexCoords.x < 0.0 || pTexCoords.y < 0.0)
     discard;
   */
 
-  vec4 diffuse_sample_rgba = texture(material.diffuse_texture, pTexCoords);
+#ifdef HAS_DIFFUSE_MAP
+  vec4 diffuse_sample_rgba = sampleMaterialTexture(MATERIAL_DIFFUSE, pTexCoords);
   vec3 diffuse_sample = diffuse_sample_rgba.xyz;
+#else
+  vec3 diffuse_sample = vec3(1.0);
+#endif
 
   float specularStrength = 0.5;
-  vec4 specular_sample_rgba = texture(material.specular_texture, pTexCoords);
+#ifdef HAS_SPECULAR_MAP
+  vec4 specular_sample_rgba = sampleMaterialTexture(MATERIAL_SPECULAR, pTexCoords);
   vec3 specular_sample = specular_sample_rgba.xyz;
+#else
+  vec3 specular_sample = vec3(1.0);
+#endif
 
-  vec4 normal_sample_rgba = texture(material.normal_map, pTexCoords);
+#ifdef HAS_NORMAL_MAP
+  vec4 normal_sample_rgba = sampleMaterialTexture(MATERIAL_NORMAL, pTexCoords);
   vec3 normal_sample = normalize(normal_sample_rgba.xyz);
   vec3 normal = normalize(normal_sample * 2.0 - 1.0);
   normal = TBN * normal;
+#else
+  vec3 normal = normalize(Normal);
+#endif
 
   vec3 diffuse = vec3(0.0, 0.0, 0.0);
   vec3 specular = vec3(0.0, 0.0, 0.0);
-  vec3 ambient = ambientLight * material.diffuse_value * diffuse_sample;
+  vec3 ambient = ambientLight * materialData.diffuse.xyz * diffuse_sample;
 
   float bias = 0.01;
 
-  for (int i = 0; i < MAX_NUM_LIGHTS; i++) {
-    UPointLight iupl = upl[i];
+#ifdef HAS_POINT_LIGHTS
+  uvec2 cluster = getLightCluster(gl_FragCoord.xy * resolution.zw, -(view * vec4(FragPos, 1.0)).z);
+  for (uint i = 0; i < cluster.y; i++) {
+    uint lightIndex = lightIndices[cluster.x + i];
+    UPointLight iupl = pointLights[lightIndex];
 
     float distance = length(iupl.position - FragPos);
     // Unstable because uninitialized lights yield negative values. SHoud fix itself once we generate shader code
@@ -205,47 +348,48 @@ void main()
 
     vec3 lightDir = normalize(iupl.position - FragPos);
     float diffuseFactor = max(dot(normal, lightDir), 0.0);
-    vec3 diffuseContribution = attenuation * (iupl.diffuse * diffuseFactor * (material.diffuse_value * diffuse_sample));
-    float shadow = (1 - computePointLightShadow(bias));
+    vec3 diffuseContribution = attenuation * (iupl.diffuse * diffuseFactor * (materialData.diffuse.xyz * diffuse_sample));
+    float shadow = (1 - computePointLightShadow(lightIndex, iupl.position, bias));
     diffuse += shadow * (max(vec3(0.0), diffuseContribution));  // TODO: remove max after attenuation fix
     //vec3 reflectDir = normalize(reflect(-lightDir, norm));
-    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialData.diffuse.w);
     vec3 halfwayVec = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayVec), 0.0), material.shininess);
-    vec3 specularContribution = attenuation * (iupl.specular * spec * (material.specular_value * specular_sample));
+    float spec = pow(max(dot(normal, halfwayVec), 0.0), materialData.diffuse.w);
+    vec3 specularContribution = attenuation * (iupl.specular * spec * (materialData.specular.xyz * specular_sample));
     specular += shadow * (max(vec3(0.0), specularContribution));  // TODO: remove max after attenuation fix
   }
+#endif
 
-  for (int i = 0; i < MAX_NUM_LIGHTS; i++) {
+  for (int i = 0; i < NB_DIRECTION_LIGHTS; i++) {
     UDirectionLight iudl = udl[i];
     vec3 lightDir = normalize(-iudl.direction);
     float diffuseFactor = max(dot(normal, lightDir), 0.0);
-    float shadow = (1 - computeShadow(bias));
-    diffuse += shadow * (iudl.diffuse * diffuseFactor * (material.diffuse_value * diffuse_sample));
+    float shadow = (1 - computeShadow(i, bias));
+    diffuse += shadow * (iudl.diffuse * diffuseFactor * (materialData.diffuse.xyz * diffuse_sample));
     //vec3 reflectDir = normalize(reflect(-lightDir, norm));
-    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialData.diffuse.w);
     vec3 halfwayVec = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayVec), 0.0), material.shininess);
-    specular += shadow * (iudl.specular * spec * (material.specular_value * specular_sample));
+    float spec = pow(max(dot(normal, halfwayVec), 0.0), materialData.diffuse.w);
+    specular += shadow * (iudl.specular * spec * (materialData.specular.xyz * specular_sample));
   }
 
   /*
   vec3 reflection = reflect(-viewDir, norm);
   vec4 reflectionColor = vec4(texture(cubeMap, reflection).rgb, 1.0);
-  float reflectionFactor = texture(material.reflection_map, TexCoords).x;
+  float reflectionFactor = sampleMaterialTexture(MATERIAL_REFLECTION, TexCoords).x;
   */
 
   vec3 result = material.emissive_value + diffuse + specular + (ambient * diffuse_sample)/* + vec3(reflectionColor * reflectionFactor)*/;
-  //vec3 result = vec3(material.shininess / 100.0);
+  //vec3 result = vec3(materialData.diffuse.w / 100.0);
   //color = vec4(FragPosLightSpace, 1.0);
   //color = vec4(diffuse_value, 1.0);
   //color = vec4(diffuse_sample, 1.0);
   //color = vec4(udl[0].diffuse, 1.0);
 
   //color = vec4(0.0, 1.0, 0.0, 1.0);
-  //color = vec4(texture(material.diffuse_texture, TexCoords).rgb, 1.0);
-  //color = vec4(texture(material.specular_texture, TexCoords).rgb, 1.0);
-  //color = vec4(texture(material.reflection_map, TexCoords).rgb, 1.0);
+  //color = vec4(sampleMaterialTexture(MATERIAL_DIFFUSE, TexCoords).rgb, 1.0);
+  //color = vec4(sampleMaterialTexture(MATERIAL_SPECULAR, TexCoords).rgb, 1.0);
+  //color = vec4(sampleMaterialTexture(MATERIAL_REFLECTION, TexCoords).rgb, 1.0);
 
   //color = vec4(vec3(closestDepth), 1.0);
   color = vec4(result, 1.0);
@@ -5,6 +5,17 @@ layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
 layout (location = 3) in vec3 tangent;
 layout (location = 4) in vec3 biTangent;
+layout (location = 8) in uint drawId;
+
+struct DrawData {
+  mat4 model;
+  mat3x4 normalMatrix;  // Inverse transpose of model, computed on the CPU
+  uvec4 indices;
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+  DrawData draws[];
+};
 
 out vec2 TexCoords;
 out vec3 Normal;
@@ -15,23 +26,36 @@ out vec3 FragPosViewSpace;
 out vec3 Tangent;
 out vec3 BiTangent;
 out mat3 TBN;
+flat out uint MaterialIndex;
+
+layout (std140, binding = 0) uniform FrameGlobals {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  vec4 cameraPosition;
+  vec4 time;        // x: seconds since the start, y: duration of the last frame
+  vec4 resolution;  // xy: pixels, zw: size of a pixel
+};
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat4 lightSpaceMatrix0;
 
 void main() {
-    gl_Position = projection * view * model * vec4(position, 1.0);
+    mat4 model = draws[drawId].model;
+    mat3 normalMatrix = mat3(draws[drawId].normalMatrix);
+    MaterialIndex = draws[drawId].indices.x;
+    vec4 worldPosition = model * vec4(position, 1.0);
+    gl_Position = viewProjection * worldPosition;
     TexCoords = texCoords;
-    FragPos = vec3(model * vec4(position, 1.0));
-    FragPosViewSpace = (view * model * vec4(position, 1.0)).xyz;
-    FragPosLightSpace = lightSpaceMatrix0 * vec4(FragPos, 1.0);
-    Normal = normalize(mat3(transpose(inverse(model))) * normal);
-    NormalViewSpace = normalize(transpose(inverse(mat3(view * model))) * normal);
-    BiTangent = normalize(mat3(transpose(inverse(model))) * biTangent);
-
-    vec3 in_tangent = normalize(mat3(transpose(inverse(model))) * tangent);
+    FragPos = worldPosition.xyz;
+    FragPosViewSpace = (view * worldPosition).xyz;
+    FragPosLightSpace = lightSpaceMatrix0 * worldPosition;
+    Normal = normalize(normalMatrix * normal);
+    // The view is a rigid transform, it is its own inverse transpose
+    NormalViewSpace = normalize(mat3(view) * Normal);
+
+    vec3 in_tangent = normalize(normalMatrix * tangent);
 
     // Graham Schmitt
     in_tangent = normalize(in_tangent - dot(in_tangent, Normal) * Normal);
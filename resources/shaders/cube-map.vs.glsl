@@ -4,11 +4,19 @@ layout (location = 0) in vec3 position;
 
 out vec3 TexCoords;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140, binding = 0) uniform FrameGlobals {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  vec4 cameraPosition;
+  vec4 time;        // x: seconds since the start, y: duration of the last frame
+  vec4 resolution;  // xy: pixels, zw: size of a pixel
+};
 
 void main() {
   TexCoords = position;
-  vec4 p = projection * view * vec4(position, 1.0f);
+  vec4 p = projection * mat4(mat3(view)) * vec4(position, 1.0f);  // Untranslated, the sky box follows the camera
   gl_Position = p.xyww;  // To have a z value of 1 after projection division
 }
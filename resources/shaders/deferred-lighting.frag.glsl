@@ -6,6 +6,17 @@ out vec4 FragColor;
   
 in vec2 TexCoords;
 
+layout (std140, binding = 0) uniform FrameGlobals {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  vec4 cameraPosition;
+  vec4 time;        // x: seconds since the start, y: duration of the last frame
+  vec4 resolution;  // xy: pixels, zw: size of a pixel
+};
+
 // GBuffer
 uniform sampler2D fb0;
 uniform sampler2D fb1;
@@ -38,28 +49,74 @@ layout (std140, binding = 1) uniform s1 {
   UDirectionLight udl[MAX_NUM_LIGHTS];
 };
 
-uniform vec3 viewPos;
+// Point lights sorted in clusters of the view frustum, see LightClusters
+layout (std430, binding = 7) readonly buffer PointLights {
+  UPointLight pointLights[];
+};
+
+layout (std430, binding = 8) readonly buffer LightClusters {
+  uvec4 clusterSize;   // Clusters along x, y and z, number of point lights
+  vec4 clusterSlices;  // x: near plane, y: depth slices per unit of log depth
+  uvec2 clusters[];    // Offset in lightIndices and number of lights
+};
+
+layout (std430, binding = 9) readonly buffer LightIndices {
+  uint lightIndices[];
+};
+
+uvec2 getLightCluster(vec2 screenPosition, float viewDepth)
+{
+  uvec2 tile = uvec2(clamp(screenPosition * vec2(clusterSize.xy), vec2(0.0), vec2(clusterSize.xy - 1u)));
+  float slice = log(max(viewDepth, clusterSlices.x) / clusterSlices.x) * clusterSlices.y;
+  uint z = uint(clamp(slice, 0.0, float(clusterSize.z - 1u)));
+  return clusters[(z * clusterSize.y + tile.y) * clusterSize.x + tile.x];
+}
+
+// Shadow maps of every light packed in one depth texture, see ShadowAtlas
+struct ShadowTile {
+  mat4 matrix;  // World space to atlas texture coordinates and depth
+  vec4 rect;    // Atlas texture coordinates of the tile, empty without a shadow
+};
+
+layout (std430, binding = 10) readonly buffer ShadowTiles {
+  vec4 shadowAtlasSize;    // xy: texels, zw: size of a texel
+  uvec4 shadowFirstTiles;  // x: direction lights, y: point lights, six tiles each
+  ShadowTile shadowTiles[];
+};
+
 uniform vec3 ambientLight;
-uniform sampler2D shadowMap0;
-uniform mat4 lightSpaceMatrix0;
+uniform sampler2D shadowAtlas;
 
 uniform float far_plane;
-uniform vec3 lightPos0;
-uniform samplerCube shadowCubeMap0;
 
-float computeShadow(float bias, vec4 FragPosLightSpace)
+// Samples stay inside the tile, filtering would read the neighbouring ones
+float sampleShadowTile(ShadowTile tile, vec2 texCoords)
 {
-  vec3 projCoords = FragPosLightSpace.xyz / FragPosLightSpace.w;
-  projCoords = projCoords * 0.5 + 0.5;
-  float closestDepth = texture(shadowMap0, projCoords.xy).r;
+  vec2 margin = 0.5 * shadowAtlasSize.zw;
+  return texture(shadowAtlas, clamp(texCoords, tile.rect.xy + margin, tile.rect.zw - margin)).r;
+}
+
+float computeShadow(int light, float bias, vec3 FragPos)
+{
+  uint tileIndex = shadowFirstTiles.x + uint(light);
+  if (tileIndex >= shadowFirstTiles.y)
+    return 0.0;
+  ShadowTile tile = shadowTiles[tileIndex];
+  if (tile.rect.z <= tile.rect.x)
+    return 0.0;
+  vec4 projCoords = tile.matrix * vec4(FragPos, 1.0);
+  projCoords.xyz /= projCoords.w;
+  // Outside of the light's box
+  if (any(lessThan(projCoords.xy, tile.rect.xy)) || any(greaterThan(projCoords.xy, tile.rect.zw)) || projCoords.z > 1.0)
+    return 0.0;
   float currentDepth = projCoords.z;
-  vec2 texelSize = 1.0 / textureSize(shadowMap0, 0);
+  vec2 texelSize = shadowAtlasSize.zw;
   float shadow = 0.0;
   for(int x = -1; x <= 1; ++x)
   {
     for(int y = -1; y <= 1; ++y)
     {
-        float pcfDepth = texture(shadowMap0, projCoords.xy + vec2(x, y) * texelSize).r; 
+        float pcfDepth = sampleShadowTile(tile, projCoords.xy + vec2(x, y) * texelSize);
         shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;        
     }    
   }
@@ -68,6 +125,17 @@ float computeShadow(float bias, vec4 FragPosLightSpace)
   return shadow;
 }
 
+// Tiles of the faces are in the order of the cube map faces: +x, -x, +y, -y, +z, -z
+float sampleShadowCube(uint firstTile, vec3 lightPosition, vec3 direction)
+{
+  vec3 axis = abs(direction);
+  uint face = axis.x >= axis.y && axis.x >= axis.z ? (direction.x > 0.0 ? 0u : 1u)
+            : (axis.y >= axis.z ? (direction.y > 0.0 ? 2u : 3u) : (direction.z > 0.0 ? 4u : 5u));
+  ShadowTile tile = shadowTiles[firstTile + face];
+  vec4 projCoords = tile.matrix * vec4(lightPosition + direction, 1.0);
+  return sampleShadowTile(tile, projCoords.xy / projCoords.w);
+}
+
 vec3 sampleOffsetDirections[20] = vec3[]
 (
    vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
@@ -77,22 +145,24 @@ vec3 sampleOffsetDirections[20] = vec3[]
    vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
 );
 
-float computePointLightShadow(float bias, vec3 FragPos)
+float computePointLightShadow(uint light, vec3 lightPosition, float bias, vec3 FragPos)
 {
+  uint firstTile = shadowFirstTiles.y + 6u * light;
+  if (firstTile + 6u > uint(shadowTiles.length()) || shadowTiles[firstTile].rect.z <= shadowTiles[firstTile].rect.x)
+    return 0.0;
   // get vector between fragment position and light position
-  vec3 fragToLight = FragPos - lightPos0;
+  vec3 fragToLight = FragPos - lightPosition;
   // use the light to fragment vector to sample from the depth map    
   float currentDepth = length(fragToLight);
 
-  vec2 texelSize = 1.0 / textureSize(shadowCubeMap0, 0);
   float offset  = 0.1;
   float shadow = 0.0;
   int samples  = 20;
-  float viewDistance = length(viewPos - FragPos);
+  float viewDistance = length(cameraPosition.xyz - FragPos);
   float diskRadius = (1.0 + (viewDistance / far_plane)) / 100.0;
   for(int i = 0; i < samples; ++i)
   {
-    float closestDepth = texture(shadowCubeMap0, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
+    float closestDepth = sampleShadowCube(firstTile, lightPosition, fragToLight + sampleOffsetDirections[i] * diskRadius);
     closestDepth *= far_plane;   // Undo mapping [0;1]
     if(currentDepth - bias > closestDepth)
         shadow += 1.0;
@@ -114,7 +184,6 @@ void main()
 
 
   vec3 FragPos = fbColor0.xyz;
-  vec4 FragPosLightSpace = lightSpaceMatrix0 * vec4(FragPos, 1.0);
   vec3 normal = fbColor1.xyz;
   vec3 ambient = ambientLight * fbColor2.xyz;
   vec3 albedo = fbColor2.xyz * occlusion;
@@ -123,15 +192,17 @@ void main()
 
   //FragColor = vec4(ambient, 1.0);
 
-  vec3 viewDir = normalize(viewPos - FragPos);
+  vec3 viewDir = normalize(cameraPosition.xyz - FragPos);
 
   vec3 diffuse = vec3(0.0, 0.0, 0.0);
   vec3 specular = vec3(0.0, 0.0, 0.0);
 
   float bias = 0.01;
 
-  for (int i = 0; i < MAX_NUM_LIGHTS; i++) {
-    UPointLight iupl = upl[i];
+  uvec2 cluster = getLightCluster(TexCoords, -(view * vec4(FragPos, 1.0)).z);
+  for (uint i = 0; i < cluster.y; i++) {
+    uint lightIndex = lightIndices[cluster.x + i];
+    UPointLight iupl = pointLights[lightIndex];
 
     float distance = length(iupl.position - FragPos);
     // Unstable because uninitialized lights yield negative values. SHoud fix itself once we generate shader code
@@ -140,7 +211,7 @@ void main()
     vec3 lightDir = normalize(iupl.position - FragPos);
     float diffuseFactor = max(dot(normal, lightDir), 0.0);
     vec3 diffuseContribution = attenuation * (iupl.diffuse * diffuseFactor * albedo);
-    float shadow = (1 - computePointLightShadow(bias, FragPos));
+    float shadow = (1 - computePointLightShadow(lightIndex, iupl.position, bias, FragPos));
     diffuse += shadow * (max(vec3(0.0), diffuseContribution));  // TODO: remove max after attenuation fix
     vec3 halfwayVec = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayVec), 0.0), shininess);
@@ -152,7 +223,7 @@ void main()
     UDirectionLight iudl = udl[i];
     vec3 lightDir = normalize(-iudl.direction);
     float diffuseFactor = max(dot(normal, lightDir), 0.0);
-    float shadow = (1 - computeShadow(bias, FragPosLightSpace));
+    float shadow = (1 - computeShadow(i, bias, FragPos));
     diffuse += shadow * (iudl.diffuse * diffuseFactor * albedo);
     vec3 halfwayVec = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayVec), 0.0), shininess);
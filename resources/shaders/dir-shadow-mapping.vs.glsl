@@ -2,11 +2,22 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
+layout (location = 8) in uint drawId;
+
+struct DrawData {
+  mat4 model;
+  mat3x4 normalMatrix;  // Inverse transpose of model, computed on the CPU
+  uvec4 indices;
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+  DrawData draws[];
+};
 
 uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
 
 void main()
 {
+    mat4 model = draws[drawId].model;
     gl_Position = lightSpaceMatrix * model * vec4(position, 1.0);
 } 
\ No newline at end of file
@@ -1,6 +1,21 @@
 #version 450 core
 
 #define MAX_NUM_LIGHTS 10
+#define MAX_TEXTURE_ARRAYS 8
+
+// Feature keys are injected by Shader::getVariant, the defaults match a material with every map
+#ifndef NB_DIRECTION_LIGHTS
+#define NB_DIRECTION_LIGHTS MAX_NUM_LIGHTS
+#define HAS_POINT_LIGHTS
+#define HAS_DIFFUSE_MAP
+#define HAS_SPECULAR_MAP
+#define HAS_NORMAL_MAP
+#define HAS_PARALLAX_MAP
+#endif
+
+#ifdef USE_BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#endif
 
 layout (location = 0) out vec4 Positions;
 layout (location = 1) out vec4 Normals;
@@ -8,15 +23,29 @@ layout (location = 2) out vec4 Albedo;
 layout (location = 3) out vec4 Spec;
 
 struct Material {
-  vec3 diffuse_value;
   sampler2D diffuse_texture;
-  vec3 specular_value;
   sampler2D specular_texture;
   sampler2D reflection_map;
   sampler2D normal_map;
   sampler2D parallax_map;
-  float shininess;
   vec3 emissive_value;
+  // Texture array slot and layer of each map, slot -1 when the map is not packed
+  ivec2 diffuse_layer;
+  ivec2 specular_layer;
+  ivec2 reflection_layer;
+  ivec2 normal_layer;
+  ivec2 parallax_layer;
+};
+
+struct MaterialData {
+  vec4 diffuse;  // w: shininess
+  vec4 specular;
+  uvec2 maps[5];  // Bindless handles, only valid with USE_BINDLESS_TEXTURES
+  ivec2 layers[5];
+};
+
+layout (std430, binding = 1) readonly buffer Materials {
+  MaterialData materials[];
 };
 
 struct PBRMaterial {
@@ -35,16 +64,52 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 in mat3 TBN;
+flat in uint MaterialIndex;
+
+MaterialData materialData; // Data of the current draw, set first thing in main
+
+layout (std140, binding = 0) uniform FrameGlobals {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  vec4 cameraPosition;
+  vec4 time;        // x: seconds since the start, y: duration of the last frame
+  vec4 resolution;  // xy: pixels, zw: size of a pixel
+};
 
 uniform Material material;
+uniform sampler2DArray texture_arrays[MAX_TEXTURE_ARRAYS];
 uniform PBRMaterial pbrMaterial;
-uniform vec3 viewPos;
 uniform float far_plane;
 
+// Map and layer arguments of sampleMaterialTexture
+#ifdef USE_BINDLESS_TEXTURES
+#define MATERIAL_DIFFUSE sampler2D(materialData.maps[0]), materialData.layers[0]
+#define MATERIAL_SPECULAR sampler2D(materialData.maps[1]), materialData.layers[1]
+#define MATERIAL_REFLECTION sampler2D(materialData.maps[2]), materialData.layers[2]
+#define MATERIAL_NORMAL sampler2D(materialData.maps[3]), materialData.layers[3]
+#define MATERIAL_PARALLAX sampler2D(materialData.maps[4]), materialData.layers[4]
+#else
+#define MATERIAL_DIFFUSE material.diffuse_texture, material.diffuse_layer
+#define MATERIAL_SPECULAR material.specular_texture, material.specular_layer
+#define MATERIAL_REFLECTION material.reflection_map, material.reflection_layer
+#define MATERIAL_NORMAL material.normal_map, material.normal_layer
+#define MATERIAL_PARALLAX material.parallax_map, material.parallax_layer
+#endif
+
+vec4 sampleMaterialTexture(sampler2D map, ivec2 layer, vec2 texCoords)
+{
+  if (layer.x < 0)
+    return texture(map, texCoords);
+  return texture(texture_arrays[layer.x], vec3(texCoords, layer.y));
+}
+
 vec2 parallaxMapping(vec2 texCoords, vec3 TSviewDir)
 {
   float height_scale = 0.05;
-  float height =  texture(material.parallax_map, texCoords).r;    
+  float height =  sampleMaterialTexture(MATERIAL_PARALLAX, texCoords).r;    
   vec2 p = TSviewDir.xy / TSviewDir.z * (height * height_scale);
   return texCoords - p; 
 }
@@ -60,16 +125,16 @@ vec2 steepParallaxMapping(vec2 texCoords, vec3 TSviewDir)
   vec2 P = TSviewDir.xy * height_scale;
   vec2 deltaTexCoords = P / numLayers;
   vec2  currentTexCoords = texCoords;
-  float currentDepthMapValue = texture(material.parallax_map, currentTexCoords).r;
+  float currentDepthMapValue = sampleMaterialTexture(MATERIAL_PARALLAX, currentTexCoords).r;
   while(currentLayerDepth < currentDepthMapValue)
   {
     currentTexCoords -= deltaTexCoords;
-    currentDepthMapValue = texture(material.parallax_map, currentTexCoords).r;  
+    currentDepthMapValue = sampleMaterialTexture(MATERIAL_PARALLAX, currentTexCoords).r;  
     currentLayerDepth += layerDepth;  
   }
 
   vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
-  float beforeDepth = texture(material.parallax_map, prevTexCoords).r - currentLayerDepth + layerDepth;
+  float beforeDepth = sampleMaterialTexture(MATERIAL_PARALLAX, prevTexCoords).r - currentLayerDepth + layerDepth;
   float afterDepth  = currentDepthMapValue - currentLayerDepth;
   float weight = afterDepth / (afterDepth - beforeDepth);
   vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
@@ -80,25 +145,41 @@ vec2 steepParallaxMapping(vec2 texCoords, vec3 TSviewDir)
 
 void main()
 {
+  materialData = materials[MaterialIndex];
   // Light Variables
-  vec3 tangViewDir = normalize(TBN * viewPos - TBN * FragPos);
-
+#ifdef HAS_PARALLAX_MAP
+  vec3 tangViewDir = normalize(TBN * cameraPosition.xyz - TBN * FragPos);
   vec2 pTexCoords = steepParallaxMapping(TexCoords, tangViewDir);
+#else
+  vec2 pTexCoords = TexCoords;
+#endif
 
-  vec4 diffuse_sample_rgba = texture(material.diffuse_texture, pTexCoords);
+#ifdef HAS_DIFFUSE_MAP
+  vec4 diffuse_sample_rgba = sampleMaterialTexture(MATERIAL_DIFFUSE, pTexCoords);
   vec3 diffuse_sample = diffuse_sample_rgba.xyz;
+#else
+  vec3 diffuse_sample = vec3(1.0);
+#endif
 
   float specularStrength = 0.5;
-  vec4 specular_sample_rgba = texture(material.specular_texture, pTexCoords);
+#ifdef HAS_SPECULAR_MAP
+  vec4 specular_sample_rgba = sampleMaterialTexture(MATERIAL_SPECULAR, pTexCoords);
   vec3 specular_sample = specular_sample_rgba.xyz;
+#else
+  vec3 specular_sample = vec3(1.0);
+#endif
 
-  vec4 normal_sample_rgba = texture(material.normal_map, pTexCoords);
+#ifdef HAS_NORMAL_MAP
+  vec4 normal_sample_rgba = sampleMaterialTexture(MATERIAL_NORMAL, pTexCoords);
   vec3 normal_sample = normalize(normal_sample_rgba.xyz);
   vec3 normal = normalize(normal_sample * 2.0 - 1.0);
   normal = TBN * normal;
+#else
+  vec3 normal = normalize(Normal);
+#endif
 
   Positions = vec4(FragPos, 1.0);
   Normals = vec4(normal, 1.0);
-  Albedo = vec4(material.diffuse_value * diffuse_sample, 1.0);
-  Spec = vec4(material.specular_value * specular_sample, material.shininess / 100.f);  // TODO: remove ugly /100
+  Albedo = vec4(materialData.diffuse.xyz * diffuse_sample, 1.0);
+  Spec = vec4(materialData.specular.xyz * specular_sample, materialData.diffuse.w / 100.f);  // TODO: remove ugly /100
 }
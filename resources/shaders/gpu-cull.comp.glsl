@@ -0,0 +1,126 @@
+#version 450 core
+
+// Tests the world space bounds of every draw and appends the visible ones to the commands of their segment
+
+layout (local_size_x = 64) in;
+
+struct DrawElementsIndirectCommand {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+
+struct CullData {
+  vec3 boundsMin;
+  uint segment;
+  vec3 boundsMax;
+  uint segmentStart; // First command of the segment
+};
+
+layout (std430, binding = 2) readonly buffer Commands {
+  DrawElementsIndirectCommand commands[];
+};
+
+layout (std430, binding = 3) readonly buffer Cull {
+  CullData cullData[];
+};
+
+layout (std430, binding = 4) writeonly buffer Output {
+  DrawElementsIndirectCommand outputs[];
+};
+
+layout (std430, binding = 5) buffer Counts {
+  uint counts[];
+};
+
+layout (std430, binding = 6) buffer Stats {
+  uint tested;
+  uint visible;
+  uint frustumCulled;
+  uint occluded;
+};
+
+uniform uint nbDraws;
+uniform uint outputBase; // In commands
+uniform uint countBase;
+uniform mat4 viewProjection;
+uniform bool occlusion;
+uniform mat4 hiZViewProjection; // Of the frame the pyramid was built from
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+
+bool isInFrustum(vec3 boundsMin, vec3 boundsMax)
+{
+  // Outside when all the corners are on the outer side of one of the clip planes
+  uvec3 outsideMin = uvec3(1);
+  uvec3 outsideMax = uvec3(1);
+  for (int i = 0; i < 8; ++i)
+  {
+    vec3 corner = vec3((i & 1) != 0 ? boundsMax.x : boundsMin.x, (i & 2) != 0 ? boundsMax.y : boundsMin.y,
+                       (i & 4) != 0 ? boundsMax.z : boundsMin.z);
+    vec4 clip = viewProjection * vec4(corner, 1.0);
+    outsideMin &= uvec3(lessThan(clip.xyz, vec3(-clip.w)));
+    outsideMax &= uvec3(greaterThan(clip.xyz, vec3(clip.w)));
+  }
+  return all(equal(outsideMin | outsideMax, uvec3(0)));
+}
+
+bool isOccluded(vec3 boundsMin, vec3 boundsMax)
+{
+  // Screen rectangle and nearest depth of the box when the pyramid was built
+  vec2 rectMin = vec2(1.0);
+  vec2 rectMax = vec2(0.0);
+  float nearest = 1.0;
+  for (int i = 0; i < 8; ++i)
+  {
+    vec3 corner = vec3((i & 1) != 0 ? boundsMax.x : boundsMin.x, (i & 2) != 0 ? boundsMax.y : boundsMin.y,
+                       (i & 4) != 0 ? boundsMax.z : boundsMin.z);
+    vec4 clip = hiZViewProjection * vec4(corner, 1.0);
+    if (clip.w <= 0.0)
+      return false; // Crosses the camera plane
+    vec3 ndc = clip.xyz / clip.w;
+    rectMin = min(rectMin, ndc.xy * 0.5 + 0.5);
+    rectMax = max(rectMax, ndc.xy * 0.5 + 0.5);
+    nearest = min(nearest, ndc.z * 0.5 + 0.5);
+  }
+  rectMin = clamp(rectMin, 0.0, 1.0);
+  rectMax = clamp(rectMax, 0.0, 1.0);
+
+  // The level where the rectangle covers about two texels per side, all of them are read
+  vec2 size = vec2(textureSize(hiZ, 0));
+  vec2 extent = (rectMax - rectMin) * size;
+  int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);
+  ivec2 levelSize = textureSize(hiZ, level);
+  ivec2 first = clamp(ivec2(rectMin * vec2(levelSize)), ivec2(0), levelSize - 1);
+  ivec2 last = clamp(ivec2(rectMax * vec2(levelSize)), ivec2(0), levelSize - 1);
+  float farthest = 0.0;
+  for (int y = first.y; y <= last.y; ++y)
+    for (int x = first.x; x <= last.x; ++x)
+      farthest = max(farthest, texelFetch(hiZ, ivec2(x, y), level).r);
+  return nearest > farthest;
+}
+
+void main()
+{
+  uint draw = gl_GlobalInvocationID.x;
+  if (draw >= nbDraws)
+    return;
+  atomicAdd(tested, 1);
+
+  CullData data = cullData[draw];
+  if (any(greaterThan(data.boundsMin, data.boundsMax)) || !isInFrustum(data.boundsMin, data.boundsMax))
+  {
+    atomicAdd(frustumCulled, 1);
+    return;
+  }
+  if (occlusion && isOccluded(data.boundsMin, data.boundsMax))
+  {
+    atomicAdd(occluded, 1);
+    return;
+  }
+  atomicAdd(visible, 1);
+  uint slot = atomicAdd(counts[countBase + data.segment], 1);
+  outputs[outputBase + data.segmentStart + slot] = commands[draw];
+}
@@ -0,0 +1,28 @@
+#version 450 core
+
+// One level of the hierarchical depth buffer: each texel keeps the farthest depth of the texels it covers
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r32f, binding = 0) uniform writeonly image2D destination;
+
+uniform sampler2D source; // The depth copy for the first level, the previous level of the pyramid after
+uniform int sourceLevel;
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(destination);
+  if (any(greaterThanEqual(texel, size)))
+    return;
+
+  // Odd sizes: the last row and column also take the source texels left over by the halving
+  ivec2 sourceSize = textureSize(source, sourceLevel);
+  ivec2 first = texel * 2;
+  ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (sourceSize & 1), sourceSize - 1);
+  float depth = 0.0;
+  for (int y = first.y; y <= last.y; ++y)
+    for (int x = first.x; x <= last.x; ++x)
+      depth = max(depth, texelFetch(source, ivec2(x, y), sourceLevel).r);
+  imageStore(destination, texel, vec4(depth));
+}
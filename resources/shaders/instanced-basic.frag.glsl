@@ -23,12 +23,18 @@ struct UDirectionLight {
 };
 
 struct Material {
-  vec3 diffuse_value;
   sampler2D diffuse_texture;
-  vec3 specular_value;
   sampler2D specular_texture;
   sampler2D reflection_map;
-  float shininess;
+};
+
+struct MaterialData {
+  vec4 diffuse;  // w: shininess
+  vec4 specular;
+};
+
+layout (std430, binding = 1) readonly buffer Materials {
+  MaterialData materials[];
 };
 
 struct PBRMaterial {
@@ -54,14 +60,26 @@ in vec3 FragPos;
 
 out vec4 color;
 
+layout (std140, binding = 0) uniform FrameGlobals {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  vec4 cameraPosition;
+  vec4 time;        // x: seconds since the start, y: duration of the last frame
+  vec4 resolution;  // xy: pixels, zw: size of a pixel
+};
+
 uniform Material material;
+uniform int materialIndex; // No draw data with instancing, set per material
 uniform PBRMaterial pbrMaterial;
-uniform vec3 viewPos;
 uniform vec3 ambientLight;
 uniform samplerCube cubeMap;
 
 void main()
 {
+  MaterialData materialData = materials[materialIndex];
   // Light Variables
   vec3 norm = normalize(Normal);
 
@@ -69,36 +87,36 @@ void main()
   vec3 diffuse_sample = diffuse_sample_rgba.xyz;
 
   float specularStrength = 0.5;
-  vec3 viewDir = normalize(viewPos - FragPos);
+  vec3 viewDir = normalize(cameraPosition.xyz - FragPos);
   vec4 specular_sample_rgba = texture(material.specular_texture, TexCoords);
   vec3 specular_sample = specular_sample_rgba.xyz;
 
   vec3 diffuse = vec3(0.0, 0.0, 0.0);
   vec3 specular = vec3(0.0, 0.0, 0.0);
-  vec3 ambient = ambientLight * material.diffuse_value * diffuse_sample;
+  vec3 ambient = ambientLight * materialData.diffuse.xyz * diffuse_sample;
 
   for (int i = 0; i < MAX_NUM_LIGHTS; i++) {
     UPointLight iupl = upl[i];
     vec3 lightDir = normalize(iupl.position - FragPos);
     float diffuseFactor = max(dot(norm, lightDir), 0.0);
-    diffuse += iupl.diffuse * diffuseFactor * (material.diffuse_value * diffuse_sample);
+    diffuse += iupl.diffuse * diffuseFactor * (materialData.diffuse.xyz * diffuse_sample);
     //vec3 reflectDir = normalize(reflect(-lightDir, norm));
-    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialData.diffuse.w);
     vec3 halfwayVec = normalize(-lightDir + viewDir);
-    float spec = pow(max(dot(Normal, halfwayVec), 0.0), material.shininess);
-    specular += iupl.specular * spec * (material.specular_value * specular_sample);
+    float spec = pow(max(dot(Normal, halfwayVec), 0.0), materialData.diffuse.w);
+    specular += iupl.specular * spec * (materialData.specular.xyz * specular_sample);
   }
 
   for (int i = 0; i < MAX_NUM_LIGHTS; i++) {
     UDirectionLight iudl = udl[i];
     vec3 lightDir = normalize(-iudl.direction);
     float diffuseFactor = max(dot(norm, lightDir), 0.0);
-    diffuse += iudl.diffuse * diffuseFactor * (material.diffuse_value * diffuse_sample);
+    diffuse += iudl.diffuse * diffuseFactor * (materialData.diffuse.xyz * diffuse_sample);
     //vec3 reflectDir = normalize(reflect(-lightDir, norm));
-    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    //float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialData.diffuse.w);
     vec3 halfwayVec = normalize(-lightDir + viewDir);
-    float spec = pow(max(dot(Normal, halfwayVec), 0.0), material.shininess);
-    specular += iudl.specular * spec * (material.specular_value * specular_sample);
+    float spec = pow(max(dot(Normal, halfwayVec), 0.0), materialData.diffuse.w);
+    specular += iudl.specular * spec * (materialData.specular.xyz * specular_sample);
   }
 
   /*
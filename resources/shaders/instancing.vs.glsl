@@ -4,18 +4,27 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
 layout (location = 3) in mat4 instanceMatrix;
+layout (location = 9) in mat3x4 instanceNormalMatrix;  // Inverse transpose of instanceMatrix, computed on the CPU
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140, binding = 0) uniform FrameGlobals {
+  mat4 view;
+  mat4 projection;
+  mat4 viewProjection;
+  mat4 inverseView;
+  mat4 inverseProjection;
+  vec4 cameraPosition;
+  vec4 time;        // x: seconds since the start, y: duration of the last frame
+  vec4 resolution;  // xy: pixels, zw: size of a pixel
+};
 
 void main() {
-    gl_Position = projection * view * instanceMatrix * vec4(position, 1.0f);
+    gl_Position = viewProjection * instanceMatrix * vec4(position, 1.0f);
     TexCoords = texCoords;
     FragPos = vec3(instanceMatrix * vec4(position, 1.0));
-    Normal = mat3(transpose(inverse(instanceMatrix))) * normal;
+    Normal = mat3(instanceNormalMatrix) * normal;
 }
@@ -4,13 +4,17 @@ layout (triangle_strip, max_vertices=18) out;
 
 uniform mat4 shadowMatrices[6];
 
+flat in uint FaceMask[]; // Faces culled on the CPU are skipped
+
 out vec4 FragPos; // FragPos from GS (output per emitvertex)
 
 void main()
 {
     for(int face = 0; face < 6; ++face)
     {
-        gl_Layer = face; // built-in variable that specifies to which face we render.
+        if ((FaceMask[0] & (1u << face)) == 0u)
+            continue;
+        gl_ViewportIndex = face; // Each face has its own tile of the shadow atlas
         for(int i = 0; i < 3; ++i) // for each triangle's vertices
         {
             FragPos = gl_in[i].gl_Position;
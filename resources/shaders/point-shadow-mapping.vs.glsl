@@ -2,10 +2,23 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
+layout (location = 8) in uint drawId;
 
-uniform mat4 model;
+struct DrawData {
+  mat4 model;
+  mat3x4 normalMatrix;  // Inverse transpose of model, computed on the CPU
+  uvec4 indices;  // y: faces the draw's bounds touch
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+  DrawData draws[];
+};
+
+flat out uint FaceMask;
 
 void main()
 {
+    mat4 model = draws[drawId].model;
+    FaceMask = draws[drawId].indices.y;
     gl_Position = model * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
+#include <cstring>
 #include <iostream>
 
 #include <renderer/engine.hpp>
+#include <renderer/gl-state-cache.hpp>
 #include <renderer/shader.hpp>
 #include <model/components/material.hpp>
 #include <model/components/volume.hpp>
@@ -18,6 +20,8 @@
 
 using namespace leo;
 
+bool gpuCulling = false; // --gpu-culling
+
 void print_matrix(const glm::mat4x4 &mat)
 {
   for (int i = 0; i < 4; i++)
@@ -42,7 +46,7 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
   // make sure the viewport matches the new window dimensions; note that width and
   // height will be significantly larger than specified on retina displays.
-  glViewport(0, 0, width, height);
+  GLStateCache::getInstance()->viewport(0, 0, width, height);
 }
 
 void testInstanced()
@@ -107,6 +111,7 @@ void testInstanced()
   // Render
   Engine engine;
 
+  engine.setGPUCulling(gpuCulling);
   engine.setScene(&scene);
   engine.setInstancedScene(&instancedScene, transformations);
   engine.gameLoop();
@@ -251,6 +256,7 @@ void cubeScene()
   // Render
   Engine engine;
 
+  engine.setGPUCulling(gpuCulling);
   engine.setScene(&scene);
 
   // Test oberver mode
@@ -364,12 +370,18 @@ void blinnPhong()
 
   Engine engine;
 
+  engine.setGPUCulling(gpuCulling);
   engine.setScene(&scene);
   engine.gameLoop();
 }
 
-int main()
+int main(int argc, char **argv)
 {
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "--gpu-culling") == 0)
+      gpuCulling = true;
+  }
   cubeScene();
   //testInstanced();
   //blinnPhong();
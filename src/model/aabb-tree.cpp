@@ -0,0 +1,359 @@
+#include "aabb-tree.hpp"
+
+#include <algorithm>
+
+namespace leo
+{
+
+namespace
+{
+
+float surfaceArea(const AABB &box)
+{
+  glm::vec3 d = box.max - box.min;
+  return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+AABB merge(const AABB &a, const AABB &b)
+{
+  AABB result = a;
+  result.add(b);
+  return result;
+}
+
+bool contains(const AABB &outer, const AABB &inner)
+{
+  return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::lessThanEqual(inner.max, outer.max));
+}
+
+bool intersectsRay(const AABB &box, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance)
+{
+  // Slabs, a zero direction component gives infinite bounds which the comparisons handle
+  glm::vec3 t0 = (box.min - origin) * inverseDirection;
+  glm::vec3 t1 = (box.max - origin) * inverseDirection;
+  glm::vec3 tMin = glm::min(t0, t1);
+  glm::vec3 tMax = glm::max(t0, t1);
+  float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+  float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+  return enter <= exit;
+}
+
+} // namespace
+
+AABBTree::AABBTree()
+{
+}
+
+int AABBTree::insert(const AABB &bounds, const Entity *entity)
+{
+  int leaf = this->_allocateNode();
+  AABBTreeNode &node = this->_nodes[leaf];
+  node.bounds.min = bounds.min - glm::vec3(FAT_MARGIN);
+  node.bounds.max = bounds.max + glm::vec3(FAT_MARGIN);
+  node.entity = entity;
+  node.height = 0;
+  this->_insertLeaf(leaf);
+  this->_nbLeaves++;
+  return leaf;
+}
+
+void AABBTree::remove(int proxy)
+{
+  this->_removeLeaf(proxy);
+  this->_freeNode(proxy);
+  this->_nbLeaves--;
+}
+
+bool AABBTree::update(int proxy, const AABB &bounds)
+{
+  if (contains(this->_nodes[proxy].bounds, bounds))
+    return false;
+  this->_removeLeaf(proxy);
+  this->_nodes[proxy].bounds.min = bounds.min - glm::vec3(FAT_MARGIN);
+  this->_nodes[proxy].bounds.max = bounds.max + glm::vec3(FAT_MARGIN);
+  this->_insertLeaf(proxy);
+  return true;
+}
+
+void AABBTree::clear()
+{
+  this->_nodes.clear();
+  this->_root = -1;
+  this->_freeList = -1;
+  this->_nbLeaves = 0;
+}
+
+void AABBTree::queryFrustum(const Frustum &frustum, std::vector<const Entity *> &results) const
+{
+  if (this->_root < 0)
+    return;
+  std::vector<int> stack(1, this->_root);
+  while (!stack.empty())
+  {
+    int index = stack.back();
+    stack.pop_back();
+    const AABBTreeNode &node = this->_nodes[index];
+    FrustumTest result = frustum.test(node.bounds);
+    if (result == OUTSIDE_FRUSTUM)
+      continue;
+    if (result == INSIDE_FRUSTUM)
+      this->_collectLeaves(index, results); // No more tests needed below
+    else if (node.isLeaf())
+      results.push_back(node.entity);
+    else
+    {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+void AABBTree::querySphere(const BoundingSphere &sphere, std::vector<const Entity *> &results) const
+{
+  if (this->_root < 0)
+    return;
+  std::vector<int> stack(1, this->_root);
+  while (!stack.empty())
+  {
+    const AABBTreeNode &node = this->_nodes[stack.back()];
+    stack.pop_back();
+    if (!sphere.intersects(node.bounds))
+      continue;
+    if (node.isLeaf())
+      results.push_back(node.entity);
+    else
+    {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+void AABBTree::queryBox(const AABB &box, std::vector<const Entity *> &results) const
+{
+  if (this->_root < 0)
+    return;
+  std::vector<int> stack(1, this->_root);
+  while (!stack.empty())
+  {
+    const AABBTreeNode &node = this->_nodes[stack.back()];
+    stack.pop_back();
+    if (!box.intersects(node.bounds))
+      continue;
+    if (node.isLeaf())
+      results.push_back(node.entity);
+    else
+    {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+void AABBTree::queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+                        std::vector<const Entity *> &results) const
+{
+  if (this->_root < 0)
+    return;
+  glm::vec3 inverseDirection = 1.f / direction;
+  std::vector<int> stack(1, this->_root);
+  while (!stack.empty())
+  {
+    const AABBTreeNode &node = this->_nodes[stack.back()];
+    stack.pop_back();
+    if (!intersectsRay(node.bounds, origin, inverseDirection, maxDistance))
+      continue;
+    if (node.isLeaf())
+      results.push_back(node.entity);
+    else
+    {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+int AABBTree::_allocateNode()
+{
+  if (this->_freeList < 0)
+  {
+    this->_nodes.push_back(AABBTreeNode());
+    return (int)this->_nodes.size() - 1;
+  }
+  int node = this->_freeList;
+  this->_freeList = this->_nodes[node].parent;
+  this->_nodes[node] = AABBTreeNode();
+  return node;
+}
+
+void AABBTree::_freeNode(int node)
+{
+  this->_nodes[node].parent = this->_freeList;
+  this->_nodes[node].height = -1;
+  this->_nodes[node].entity = nullptr;
+  this->_freeList = node;
+}
+
+void AABBTree::_insertLeaf(int leaf)
+{
+  if (this->_root < 0)
+  {
+    this->_root = leaf;
+    this->_nodes[leaf].parent = -1;
+    return;
+  }
+
+  // Go down towards the sibling that makes the tree's total surface area grow the least
+  AABB leafBounds = this->_nodes[leaf].bounds;
+  int index = this->_root;
+  while (!this->_nodes[index].isLeaf())
+  {
+    const AABBTreeNode &node = this->_nodes[index];
+    float area = surfaceArea(node.bounds);
+    float combinedArea = surfaceArea(merge(node.bounds, leafBounds));
+    float cost = 2.f * combinedArea;                     // New parent of this node and the leaf
+    float inheritanceCost = 2.f * (combinedArea - area); // Paid by the ancestors when going down
+    float childCosts[2];
+    int children[2] = {node.left, node.right};
+    for (int i = 0; i < 2; ++i)
+    {
+      const AABBTreeNode &child = this->_nodes[children[i]];
+      float mergedArea = surfaceArea(merge(child.bounds, leafBounds));
+      childCosts[i] = (child.isLeaf() ? mergedArea : mergedArea - surfaceArea(child.bounds)) + inheritanceCost;
+    }
+    if (cost < childCosts[0] && cost < childCosts[1])
+      break;
+    index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+  }
+
+  int sibling = index;
+  int oldParent = this->_nodes[sibling].parent;
+  int newParent = this->_allocateNode();
+  AABBTreeNode &parent = this->_nodes[newParent];
+  parent.parent = oldParent;
+  parent.bounds = merge(leafBounds, this->_nodes[sibling].bounds);
+  parent.height = this->_nodes[sibling].height + 1;
+  parent.left = sibling;
+  parent.right = leaf;
+  if (oldParent >= 0)
+  {
+    if (this->_nodes[oldParent].left == sibling)
+      this->_nodes[oldParent].left = newParent;
+    else
+      this->_nodes[oldParent].right = newParent;
+  }
+  else
+    this->_root = newParent;
+  this->_nodes[sibling].parent = newParent;
+  this->_nodes[leaf].parent = newParent;
+
+  this->_refitFrom(newParent);
+}
+
+void AABBTree::_removeLeaf(int leaf)
+{
+  if (leaf == this->_root)
+  {
+    this->_root = -1;
+    return;
+  }
+
+  // The parent goes away, the sibling takes its place
+  int parent = this->_nodes[leaf].parent;
+  int grandParent = this->_nodes[parent].parent;
+  int sibling = this->_nodes[parent].left == leaf ? this->_nodes[parent].right : this->_nodes[parent].left;
+  this->_nodes[sibling].parent = grandParent;
+  if (grandParent >= 0)
+  {
+    if (this->_nodes[grandParent].left == parent)
+      this->_nodes[grandParent].left = sibling;
+    else
+      this->_nodes[grandParent].right = sibling;
+  }
+  else
+    this->_root = sibling;
+  this->_freeNode(parent);
+  this->_nodes[leaf].parent = -1;
+  if (grandParent >= 0)
+    this->_refitFrom(grandParent);
+}
+
+void AABBTree::_refitFrom(int node)
+{
+  for (int index = node; index >= 0; index = this->_nodes[index].parent)
+  {
+    index = this->_balance(index);
+    AABBTreeNode &n = this->_nodes[index];
+    const AABBTreeNode &left = this->_nodes[n.left];
+    const AABBTreeNode &right = this->_nodes[n.right];
+    n.height = 1 + std::max(left.height, right.height);
+    n.bounds = merge(left.bounds, right.bounds);
+  }
+}
+
+int AABBTree::_balance(int a)
+{
+  AABBTreeNode &nodeA = this->_nodes[a];
+  if (nodeA.isLeaf() || nodeA.height < 2)
+    return a;
+
+  // The taller child is rotated up, its taller child stays under it and the other one goes to a
+  int b = nodeA.left;
+  int c = nodeA.right;
+  int balance = this->_nodes[c].height - this->_nodes[b].height;
+  if (balance >= -1 && balance <= 1)
+    return a;
+
+  int up = balance > 1 ? c : b;
+  int other = balance > 1 ? b : c;
+  AABBTreeNode &nodeUp = this->_nodes[up];
+  int f = nodeUp.left;
+  int g = nodeUp.right;
+
+  nodeUp.left = a;
+  nodeUp.parent = nodeA.parent;
+  nodeA.parent = up;
+  if (nodeUp.parent >= 0)
+  {
+    if (this->_nodes[nodeUp.parent].left == a)
+      this->_nodes[nodeUp.parent].left = up;
+    else
+      this->_nodes[nodeUp.parent].right = up;
+  }
+  else
+    this->_root = up;
+
+  int kept = this->_nodes[f].height > this->_nodes[g].height ? f : g;
+  int moved = kept == f ? g : f;
+  nodeUp.right = kept;
+  if (balance > 1)
+    nodeA.right = moved;
+  else
+    nodeA.left = moved;
+  this->_nodes[moved].parent = a;
+
+  nodeA.bounds = merge(this->_nodes[other].bounds, this->_nodes[moved].bounds);
+  nodeA.height = 1 + std::max(this->_nodes[other].height, this->_nodes[moved].height);
+  nodeUp.bounds = merge(nodeA.bounds, this->_nodes[kept].bounds);
+  nodeUp.height = 1 + std::max(nodeA.height, this->_nodes[kept].height);
+  return up;
+}
+
+void AABBTree::_collectLeaves(int node, std::vector<const Entity *> &results) const
+{
+  std::vector<int> stack(1, node);
+  while (!stack.empty())
+  {
+    const AABBTreeNode &n = this->_nodes[stack.back()];
+    stack.pop_back();
+    if (n.isLeaf())
+      results.push_back(n.entity);
+    else
+    {
+      stack.push_back(n.left);
+      stack.push_back(n.right);
+    }
+  }
+}
+
+} // namespace leo
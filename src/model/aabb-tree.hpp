@@ -0,0 +1,72 @@
+#pragma once
+
+#include <utils/bounds.hpp>
+#include <utils/frustum.hpp>
+
+#include <vector>
+
+namespace leo
+{
+
+class Entity;
+
+typedef struct AABBTreeNode
+{
+  AABB bounds; // Enlarged by FAT_MARGIN for leaves, so that small moves do not restructure the tree
+  int parent = -1;
+  int left = -1;
+  int right = -1;
+  int height = 0; // -1 for free nodes, 0 for leaves
+  const Entity *entity = nullptr;
+
+  bool isLeaf() const { return this->left < 0; }
+} AABBTreeNode;
+
+/* Dynamic bounding volume hierarchy over world space boxes, each leaf (proxy) referencing an entity.
+   * Leaves are inserted next to the sibling that grows the tree's surface area the least, and the
+   * branches are rebalanced by rotations on the way up. Leaf boxes are enlarged: update only moves
+   * a leaf once its tight bounds leave the enlarged ones, otherwise nothing changes.
+   */
+class AABBTree
+{
+public:
+  AABBTree();
+
+public:
+  int insert(const AABB &bounds, const Entity *entity);
+  void remove(int proxy);
+  bool update(int proxy, const AABB &bounds); // True when the leaf was moved
+  void clear();
+  const Entity *getEntity(int proxy) const { return this->_nodes[proxy].entity; }
+  const AABB &getFatBounds(int proxy) const { return this->_nodes[proxy].bounds; }
+  int getHeight() const { return this->_root < 0 ? 0 : this->_nodes[this->_root].height; }
+  size_t size() const { return this->_nbLeaves; }
+
+public:
+  // Results are appended, boxes are only tested against the enlarged leaf bounds
+  void queryFrustum(const Frustum &frustum, std::vector<const Entity *> &results) const;
+  void querySphere(const BoundingSphere &sphere, std::vector<const Entity *> &results) const;
+  void queryBox(const AABB &box, std::vector<const Entity *> &results) const;
+  void queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance,
+                std::vector<const Entity *> &results) const;
+
+public:
+  static constexpr float FAT_MARGIN = 0.1f;
+
+private:
+  int _allocateNode();
+  void _freeNode(int node);
+  void _insertLeaf(int leaf);
+  void _removeLeaf(int leaf);
+  void _refitFrom(int node);
+  int _balance(int node);
+  void _collectLeaves(int node, std::vector<const Entity *> &results) const;
+
+private:
+  std::vector<AABBTreeNode> _nodes;
+  int _root = -1;
+  int _freeList = -1; // Linked through the parent index
+  size_t _nbLeaves = 0;
+};
+
+} // namespace leo
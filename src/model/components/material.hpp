@@ -2,6 +2,7 @@
 
 #include <model/icomponent.hpp>
 #include <model/texture-manager.hpp>
+#include <model/texture-array.hpp>
 
 #include <renderer/global.hpp>
 
@@ -30,6 +31,12 @@ public:
   Texture *reflection_map = TextureManager::black.get();
   Texture *normal_map = TextureManager::blue.get();
   Texture *parallax_map = TextureManager::black.get();
+  // Set when the map was packed at import, the renderer then samples the array instead of the map
+  TextureArrayLayer diffuse_layer;
+  TextureArrayLayer specular_layer;
+  TextureArrayLayer reflection_layer;
+  TextureArrayLayer normal_layer;
+  TextureArrayLayer parallax_layer;
   float shininess = 32.f;
   bool force = false;
 };
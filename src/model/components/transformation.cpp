@@ -45,6 +45,11 @@ const glm::mat4x4 &Transformation::getTransformationMatrix() const
   return this->_transformationMatrix;
 }
 
+const glm::mat3 &Transformation::getNormalMatrix() const
+{
+  return this->_normalMatrix;
+}
+
 void Transformation::setRelativeTranslation(glm::vec3 value)
 {
   this->_absoluteTranslation += value - this->_relativeTranslation;
@@ -118,6 +123,10 @@ void Transformation::_recomputeTransformationMatrix()
   this->_transformationMatrix = glm::rotate(this->_transformationMatrix, glm::degrees(this->_absoluteRotation.z),
                                             glm::vec3(0.0f, 0.0f, 1.0f));
   this->_transformationMatrix = glm::scale(this->_transformationMatrix, this->_absoluteScaling);
+  // Computed here once rather than for every vertex of every draw
+  this->_normalMatrix = glm::transpose(glm::inverse(glm::mat3(this->_transformationMatrix)));
+  if (this->_entity)
+    this->_entity->invalidateBounds();
 }
 
 } // namespace leo
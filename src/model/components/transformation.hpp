@@ -20,6 +20,7 @@ public:
   const glm::vec3 &getAbsoluteRotation() const;
   const glm::vec3 &getAbsoluteScaling() const;
   const glm::mat4x4 &getTransformationMatrix() const;
+  const glm::mat3 &getNormalMatrix() const;
   void setRelativeTranslation(glm::vec3 value);
   void setRelativeRotation(glm::vec3 value);
   void setRelativeScaling(glm::vec3 value);
@@ -45,6 +46,7 @@ private:
   glm::vec3 _absoluteRotation;
   glm::vec3 _absoluteScaling;
   glm::mat4x4 _transformationMatrix;
+  glm::mat3 _normalMatrix; // Inverse transpose of the transformation, for normals
 };
 
 } // namespace leo
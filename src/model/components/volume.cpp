@@ -1,5 +1,8 @@
 #include "volume.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 namespace leo
 {
 
@@ -43,9 +46,11 @@ glm::vec3 computeBiTangent(const glm::vec3 E1, const glm::vec3 E2, const glm::ve
 Volume::Volume(std::vector<Vertex> vertices, std::vector<unsigned int> indices) : _vertices(vertices),
                                                                                   _indices(indices)
 {
+  this->_computeBounds();
 }
 
-Volume::Volume(const Volume &other) : _indices(other._indices), _vertices(other._vertices)
+Volume::Volume(const Volume &other) : _indices(other._indices), _vertices(other._vertices),
+                                      _bounds(other._bounds), _boundingSphere(other._boundingSphere)
 {
 }
 
@@ -63,6 +68,16 @@ const std::vector<unsigned int> &Volume::getIndices() const
   return this->_indices;
 }
 
+const AABB &Volume::getBounds() const
+{
+  return this->_bounds;
+}
+
+const BoundingSphere &Volume::getBoundingSphere() const
+{
+  return this->_boundingSphere;
+}
+
 Volume Volume::createCustom(std::vector<Vertex> vertices, std::vector<unsigned int> indices)
 {
   Volume volume(vertices, indices);
@@ -261,6 +276,7 @@ Volume Volume::createCube(float side)
       21, 22, 23};
 
   volume._computeTangents();
+  volume._computeBounds();
 
   return volume;
 }
@@ -330,6 +346,7 @@ Volume Volume::createPlane(float width, float height)
   };
 
   volume._computeTangents();
+  volume._computeBounds();
 
   return volume;
 }
@@ -384,8 +401,28 @@ Volume Volume::createPostProcessPlane()
       2,
       3,
   };
+  volume._computeBounds();
 
   return volume;
 }
 
+void Volume::_computeBounds()
+{
+  this->_bounds = AABB();
+  for (const Vertex &v : this->_vertices)
+    this->_bounds.add(v.position);
+  this->_boundingSphere = BoundingSphere();
+  if (this->_bounds.isEmpty())
+    return;
+  // Centered on the box, tighter than its half diagonal
+  this->_boundingSphere.center = this->_bounds.getCenter();
+  float radius2 = 0.f;
+  for (const Vertex &v : this->_vertices)
+  {
+    glm::vec3 d = v.position - this->_boundingSphere.center;
+    radius2 = std::max(radius2, glm::dot(d, d));
+  }
+  this->_boundingSphere.radius = std::sqrt(radius2);
+}
+
 } // namespace leo
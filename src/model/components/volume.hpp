@@ -3,6 +3,7 @@
 #include <model/icomponent.hpp>
 
 #include <utils/geometry.hpp>
+#include <utils/bounds.hpp>
 
 #include <vector>
 
@@ -21,6 +22,8 @@ protected:
 public:
   const std::vector<Vertex> &getVertices() const;
   const std::vector<unsigned int> &getIndices() const;
+  const AABB &getBounds() const;
+  const BoundingSphere &getBoundingSphere() const;
 
 public:
   static Volume createCustom(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
@@ -36,10 +39,13 @@ public:
 
 protected:
   void _computeTangents();
+  void _computeBounds();
 
 protected:
   std::vector<Vertex> _vertices;
   std::vector<unsigned int> _indices;
+  AABB _bounds; // In model space
+  BoundingSphere _boundingSphere;
 };
 
 } // namespace leo
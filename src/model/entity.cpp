@@ -4,6 +4,8 @@
 #include <model/scene-graph.hpp>
 #include <model/components/point-light.hpp>
 #include <model/components/direction-light.hpp>
+#include <model/components/transformation.hpp>
+#include <model/components/volume.hpp>
 #include <controller/event.hpp>
 
 namespace leo
@@ -28,6 +30,7 @@ bool Entity::addComponent(IComponent *component)
   bool result = this->_components.insert(
                                      std::pair<t_typeId, IComponent *>(component->getTypeId(), component))
                     .second;
+  this->invalidateBounds();
   this->_notify(*component, Event::COMPONENT_ADDED);
   return result;
 }
@@ -64,6 +67,7 @@ bool Entity::addChild(Entity *child)
   {
     child->setParent(this);
     child->_setSceneGraphRec(this->_sceneGraph);
+    child->invalidateBounds();
   }
   for (Observer *obs : this->_observers)
     child->watch(obs);
@@ -101,6 +105,77 @@ void Entity::_setSceneGraphRec(SceneGraph *sceneGraph)
     it.second->_setSceneGraphRec(sceneGraph);
 }
 
+const AABB &Entity::getWorldBounds() const
+{
+  this->_updateBounds();
+  return this->_worldBounds;
+}
+
+const AABB &Entity::getSubtreeBounds() const
+{
+  this->_updateBounds();
+  return this->_subtreeBounds;
+}
+
+unsigned int Entity::getSubtreeVolumeCount() const
+{
+  this->_updateBounds();
+  return this->_subtreeVolumeCount;
+}
+
+const Transformation *Entity::getEffectiveTransformation() const
+{
+  for (const Entity *e = this; e; e = e->_parent)
+  {
+    const IComponent *transformation = e->getComponent(ComponentType::TRANSFORMATION);
+    if (transformation)
+      return static_cast<const Transformation *>(transformation);
+  }
+  return nullptr;
+}
+
+void Entity::invalidateBounds() const
+{
+  this->_invalidateBoundsRec();
+  // A dirty entity always has dirty ancestors, the walk up stops at the first one
+  for (const Entity *e = this->_parent; e && !e->_boundsDirty; e = e->_parent)
+    e->_boundsDirty = true;
+}
+
+void Entity::_invalidateBoundsRec() const
+{
+  this->_boundsDirty = true;
+  // Descendants with their own transformation keep their absolute matrix, they are told when it changes
+  for (auto &child : this->_children)
+  {
+    if (!child.second->getComponent(ComponentType::TRANSFORMATION))
+      child.second->_invalidateBoundsRec();
+  }
+}
+
+void Entity::_updateBounds() const
+{
+  if (!this->_boundsDirty)
+    return;
+  this->_worldBounds = AABB();
+  this->_subtreeVolumeCount = 0;
+  const IComponent *volume = this->getComponent(ComponentType::VOLUME);
+  if (volume)
+  {
+    const Transformation *transformation = this->getEffectiveTransformation();
+    const AABB &bounds = static_cast<const Volume *>(volume)->getBounds();
+    this->_worldBounds = transformation ? bounds.transform(transformation->getTransformationMatrix()) : bounds;
+    this->_subtreeVolumeCount = 1;
+  }
+  this->_subtreeBounds = this->_worldBounds;
+  for (auto &child : this->_children)
+  {
+    this->_subtreeBounds.add(child.second->getSubtreeBounds());
+    this->_subtreeVolumeCount += child.second->_subtreeVolumeCount;
+  }
+  this->_boundsDirty = false;
+}
+
 void Entity::watch(Observer *observer)
 {
   Subject::watch(observer);
@@ -3,6 +3,8 @@
 #include <controller/subject.hpp>
 #include <model/registered-object.hpp>
 
+#include <utils/bounds.hpp>
+
 #include <map>
 #include <vector>
 #include <memory>
@@ -14,6 +16,7 @@ class SceneGraph;
 class IComponent;
 class PointLight;
 class DirectionLight;
+class Transformation;
 
 using t_typeId = unsigned int;
 
@@ -39,8 +42,18 @@ public:
   const SceneGraph *getSceneGraph() const;
   void setSceneGraph(SceneGraph *sceneGraph);
 
+public:
+  // World space bounds, recomputed lazily once a transformation, volume or child changed
+  const AABB &getWorldBounds() const;   // Of the entity's own volume, empty without one
+  const AABB &getSubtreeBounds() const; // Of the volumes of the entity and all its descendants
+  unsigned int getSubtreeVolumeCount() const;
+  const Transformation *getEffectiveTransformation() const; // Own one or the closest ancestor's
+  void invalidateBounds() const;
+
 private:
   void _setSceneGraphRec(SceneGraph *sceneGraph);
+  void _invalidateBoundsRec() const;
+  void _updateBounds() const;
   static t_id _count;
 
 private:
@@ -48,6 +61,10 @@ private:
   std::map<t_id, Entity *> _children;
   Entity *_parent = nullptr;
   SceneGraph *_sceneGraph = nullptr;
+  mutable AABB _worldBounds;
+  mutable AABB _subtreeBounds;
+  mutable unsigned int _subtreeVolumeCount = 0;
+  mutable bool _boundsDirty = true; // An entity is only clean when all its descendants are
 
 }; // class Entity
 
@@ -6,6 +6,7 @@
 #include <model/texture-manager.hpp>
 #include <model/component-manager.hpp>
 #include <model/entity-manager.hpp>
+#include <model/texture-array-packer.hpp>
 
 #include <SOIL.h>
 
@@ -36,7 +37,9 @@ Entity *ModelLoader::loadModel(std::string path, std::string objFileName)
     }
     Entity *entity = this->_entityManager.createEntity();
     textureCache.clear();
+    this->_materials.clear();
     this->_processNode(entity, scene->mRootNode, scene, path);
+    TextureArrayPacker(this->_textureManager).pack(this->_materials);
     return entity;
 }
 
@@ -135,6 +138,7 @@ Entity *ModelLoader::_processMesh(aiMesh *mesh, const aiScene *scene, const std:
             material->normal_map = normalMaps[0];
         if (parallaxMaps.size())
             material->parallax_map = parallaxMaps[0];
+        this->_materials.push_back(material);
     }
 
     entity->addComponent(volume);
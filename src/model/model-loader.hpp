@@ -38,6 +38,7 @@ private:
 
 private:
   std::vector<Texture *> textureCache;
+  std::vector<Material *> _materials;
   EntityManager &_entityManager;
   ComponentManager &_componentManager;
   TextureManager &_textureManager;
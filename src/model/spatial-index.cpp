@@ -0,0 +1,109 @@
+#include "spatial-index.hpp"
+
+#include <model/entity.hpp>
+#include <model/icomponent.hpp>
+#include <model/scene-graph.hpp>
+#include <model/type-id.hpp>
+
+namespace leo
+{
+
+SpatialIndex::SpatialIndex(SceneGraph &sceneGraph)
+{
+  sceneGraph.watch(this);
+  if (sceneGraph.getRoot())
+    this->insert(*sceneGraph.getRoot());
+}
+
+void SpatialIndex::notified(Subject *subject, Event event)
+{
+  IComponent *c = dynamic_cast<IComponent *>(subject);
+  if (c)
+  {
+    const Entity *entity = c->getEntity();
+    if (!entity)
+      return;
+    switch (c->getTypeId())
+    {
+    case ComponentType::VOLUME:
+      if (event == Event::COMPONENT_DELETED || event == Event::COMPONENT_REMOVED)
+        this->remove(*entity);
+      else
+        this->_insertEntity(*entity);
+      break;
+    case ComponentType::TRANSFORMATION:
+      this->update(*entity);
+      break;
+    default:
+      break;
+    }
+    return;
+  }
+  Entity *e = dynamic_cast<Entity *>(subject);
+  if (e)
+  {
+    switch (event)
+    {
+    case Event::BASE_ADDED:
+      this->insert(*e);
+      break;
+    case Event::BASE_REMOVED:
+    case Event::BASE_DELETED:
+      this->remove(*e);
+      break;
+    case Event::COMPONENT_UPDATED: // New parent
+      this->update(*e);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void SpatialIndex::insert(const Entity &entity)
+{
+  this->_insertEntity(entity);
+  for (auto &child : entity.getChildren())
+    this->insert(*child.second);
+}
+
+void SpatialIndex::remove(const Entity &entity)
+{
+  auto it = this->_proxies.find(entity.getId());
+  if (it != this->_proxies.end())
+  {
+    this->_tree.remove(it->second);
+    this->_proxies.erase(it);
+  }
+  for (auto &child : entity.getChildren())
+    this->remove(*child.second);
+}
+
+void SpatialIndex::update(const Entity &entity)
+{
+  auto it = this->_proxies.find(entity.getId());
+  if (it != this->_proxies.end())
+    this->_tree.update(it->second, entity.getWorldBounds());
+  else
+    this->_insertEntity(entity);
+  // Descendants with their own transformation are updated when it changes
+  for (auto &child : entity.getChildren())
+  {
+    if (!child.second->getComponent(ComponentType::TRANSFORMATION))
+      this->update(*child.second);
+  }
+}
+
+void SpatialIndex::_insertEntity(const Entity &entity)
+{
+  const AABB &bounds = entity.getWorldBounds();
+  if (bounds.isEmpty())
+    return; // No volume
+  auto it = this->_proxies.find(entity.getId());
+  if (it != this->_proxies.end())
+    this->_tree.update(it->second, bounds);
+  else
+    this->_proxies.insert(std::pair<t_id, int>(entity.getId(), this->_tree.insert(bounds, &entity)));
+}
+
+} // namespace leo
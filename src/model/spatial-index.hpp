@@ -0,0 +1,42 @@
+#pragma once
+
+#include <controller/observer.hpp>
+#include <model/aabb-tree.hpp>
+#include <model/registered-object.hpp>
+
+#include <map>
+#include <vector>
+
+namespace leo
+{
+
+class Entity;
+class SceneGraph;
+
+/* AABBTree of the entities of a scene graph that have a volume, kept up to date through the
+   * scene events: entities and volumes are inserted when added, and moved when a transformation
+   * (their own or an inherited one) changes. Queries return entities, see AABBTree.
+   */
+class SpatialIndex : public Observer
+{
+public:
+  SpatialIndex(SceneGraph &sceneGraph);
+
+public:
+  virtual void notified(Subject *subject, Event event) override;
+
+public:
+  void insert(const Entity &entity); // With its descendants
+  void remove(const Entity &entity); // With its descendants
+  void update(const Entity &entity); // Refits the entity and the descendants sharing its transformation
+  const AABBTree &getTree() const { return this->_tree; }
+
+private:
+  void _insertEntity(const Entity &entity);
+
+private:
+  AABBTree _tree;
+  std::map<t_id, int> _proxies; // Entity id to leaf of the tree
+};
+
+} // namespace leo
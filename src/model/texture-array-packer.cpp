@@ -0,0 +1,72 @@
+#include "texture-array-packer.hpp"
+
+#include <model/components/material.hpp>
+#include <model/texture-array.hpp>
+#include <model/texture-manager.hpp>
+
+#include <map>
+#include <tuple>
+#include <utility>
+
+namespace leo
+{
+
+TextureArrayPacker::TextureArrayPacker(TextureManager &textureManager) : _textureManager(textureManager)
+{
+}
+
+void TextureArrayPacker::pack(const std::vector<Material *> &materials)
+{
+    using t_groupKey = std::tuple<int, int, TextureMode>;
+
+    // Gather the distinct packable textures, in order of first use
+    std::map<t_groupKey, std::vector<const Texture *>> groups;
+    std::map<const Texture *, TextureArrayLayer> packed;
+    for (Material *material : materials)
+    {
+        for (const Texture *t : {material->diffuse_texture, material->specular_texture, material->reflection_map,
+                                 material->normal_map, material->parallax_map})
+        {
+            if (!t || !t->data || packed.count(t))
+                continue;
+            if (t->width > MAX_LAYER_SIZE || t->height > MAX_LAYER_SIZE)
+                continue;
+            groups[t_groupKey(t->width, t->height, t->mode)].push_back(t);
+            packed[t] = TextureArrayLayer();
+        }
+    }
+
+    for (auto &p : groups)
+    {
+        const std::vector<const Texture *> &textures = p.second;
+        if (textures.size() < MIN_LAYERS)
+            continue;
+        TextureArray *array = nullptr;
+        for (const Texture *t : textures)
+        {
+            if (!array || array->layers.size() >= MAX_LAYERS)
+                array = this->_textureManager.createTextureArray(t->width, t->height, t->mode);
+            TextureArrayLayer &layer = packed[t];
+            layer.array = array;
+            layer.layer = array->addLayer(t);
+        }
+    }
+
+    for (Material *material : materials)
+    {
+        std::pair<const Texture *, TextureArrayLayer *> maps[] = {
+            {material->diffuse_texture, &material->diffuse_layer},
+            {material->specular_texture, &material->specular_layer},
+            {material->reflection_map, &material->reflection_layer},
+            {material->normal_map, &material->normal_layer},
+            {material->parallax_map, &material->parallax_layer}};
+        for (auto &map : maps)
+        {
+            auto it = packed.find(map.first);
+            if (it != packed.end() && it->second.array)
+                *map.second = it->second;
+        }
+    }
+}
+
+} // namespace leo
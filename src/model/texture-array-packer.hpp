@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+namespace leo
+{
+
+class Material;
+class TextureManager;
+
+/* Groups the small textures of imported materials by size and mode, and packs every group
+   * with at least two textures into texture arrays. Each packed map of a material then references
+   * its array and layer, so switching between those materials does not rebind textures.
+   */
+class TextureArrayPacker
+{
+public:
+  TextureArrayPacker(TextureManager &textureManager);
+
+public:
+  void pack(const std::vector<Material *> &materials);
+
+public:
+  static const int MAX_LAYER_SIZE = 2048;
+  static const unsigned int MAX_LAYERS = 256; // GL 4.5 guarantees 2048, stay well below
+  static const unsigned int MIN_LAYERS = 2;
+
+private:
+  TextureManager &_textureManager;
+};
+
+} // namespace leo
@@ -0,0 +1,19 @@
+#include "texture-array.hpp"
+
+namespace leo
+{
+
+t_id TextureArray::_count = 1;
+
+TextureArray::TextureArray(int width, int height, TextureMode mode)
+    : RegisteredObject(_count++), width(width), height(height), mode(mode)
+{
+}
+
+int TextureArray::addLayer(const Texture *texture)
+{
+  this->layers.push_back(texture);
+  return (int)this->layers.size() - 1;
+}
+
+} // namespace leo
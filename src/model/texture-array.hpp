@@ -0,0 +1,44 @@
+#pragma once
+
+#include <model/registered-object.hpp>
+
+#include <utils/texture.hpp>
+
+#include <vector>
+
+namespace leo
+{
+
+/* Same size and mode textures meant to be uploaded as the layers of a single GL_TEXTURE_2D_ARRAY.
+   * The layers are not owned, they stay in the TextureManager like any other texture.
+   */
+class TextureArray : public RegisteredObject
+{
+public:
+  TextureArray(int width, int height, TextureMode mode);
+  TextureArray(const TextureArray &other) = delete;
+
+public:
+  TextureArray &operator=(const TextureArray &other) = delete;
+
+public:
+  int addLayer(const Texture *texture);
+
+public:
+  std::vector<const Texture *> layers;
+  const int width = 0;
+  const int height = 0;
+  const TextureMode mode = TextureMode::ERROR;
+
+private:
+  static t_id _count;
+
+}; // class TextureArray
+
+typedef struct TextureArrayLayer
+{
+  const TextureArray *array = nullptr;
+  int layer = 0;
+} TextureArrayLayer;
+
+} // namespace leo
@@ -13,6 +13,7 @@ TextureManager::TextureManager()
 
 TextureManager::~TextureManager()
 {
+    this->_textureArrays.clear();
     this->_textures.clear();
 }
 
@@ -26,4 +27,11 @@ Texture *TextureManager::getTexture(t_textureId id)
     return it->second.get();
 }
 
+TextureArray *TextureManager::createTextureArray(int width, int height, TextureMode mode)
+{
+    TextureArray *a = new TextureArray(width, height, mode);
+    this->_textureArrays.insert(std::pair<t_textureId, std::unique_ptr<TextureArray>>(a->getId(), a));
+    return a;
+}
+
 } // namespace leo
\ No newline at end of file
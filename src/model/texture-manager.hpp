@@ -1,5 +1,7 @@
 #pragma once
 
+#include <model/texture-array.hpp>
+
 #include <utils/texture.hpp>
 
 #include <vector>
@@ -28,6 +30,7 @@ public:
   Texture *createTexture(ARGS &&... args);
 
   Texture *getTexture(t_textureId id);
+  TextureArray *createTextureArray(int width, int height, TextureMode mode);
 
 public:
   static std::unique_ptr<Texture> black;
@@ -36,6 +39,7 @@ public:
 
 private:
   std::map<t_textureId, std::unique_ptr<Texture>> _textures;
+  std::map<t_textureId, std::unique_ptr<TextureArray>> _textureArrays;
 };
 
 template <typename... ARGS>
@@ -22,23 +22,20 @@ void CubeMapNode::render()
     this->_load();
 
     this->_shader.use();
-    glm::mat4 untranslatedMatrix = glm::mat4(glm::mat3(this->_camera.getViewMatrix()));
-    this->_shader.setMat4("view", untranslatedMatrix);
-    this->_shader.setMat4("projection", glm::perspective(this->_camera.getZoom(), (float)1620 / (float)1080, 0.1f, 100.0f));
     this->_loadOutputFramebuffer();
 
     if (this->_cubeMap)
     {
-        glDepthFunc(GL_LEQUAL);
+        this->_context.getState().depthFunc(GL_LEQUAL);
 
         GLuint VAO = this->_context.loadCubeMap(*this->_cubeMap);
         this->_shader.setTexture(
-            "skybox", this->_context.getTextureWrapperId(*this->_cubeMap->getTextures()[0]), 0, GL_TEXTURE_CUBE_MAP);
-        glBindVertexArray(VAO);
+            "skybox", this->_context.getCubeMapTextureId(*this->_cubeMap), 0, GL_TEXTURE_CUBE_MAP);
+        this->_context.getState().bindVertexArray(VAO);
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+        this->_context.getState().bindVertexArray(0);
 
-        glDepthFunc(GL_LESS);
+        this->_context.getState().depthFunc(GL_LESS);
     }
 
     this->_unload();
@@ -23,12 +23,7 @@ namespace leo
 CubeShadowMapNode::CubeShadowMapNode(OpenGLContext &context, SceneContext &sceneContext, const SceneGraph &sceneGraph, Shader &shader, const PointLight &light)
     : RenderNode(context, sceneContext, shader), _sceneGraph(sceneGraph), _light(light)
 {
-    DepthBufferOptions options;
-    options.width = 1024;
-    options.height = 1024;
-    options.type = DepthBufferType::CUBE_MAP;
-    this->_output = new Framebuffer();
-    this->_output->setDepthBuffer(options);
+    this->_output = &sceneContext.shadowAtlas.getFramebuffer();
 }
 
 void CubeShadowMapNode::render()
@@ -36,22 +31,39 @@ void CubeShadowMapNode::render()
     if (!this->_output)
         return;
 
-    glClearColor(1.0, 1.0, 1.0, 1);
+    const PointLightWrapper &plw = this->_sceneContext.pLights.find(this->_light.getId())->second;
+    ShadowAtlas &atlas = this->_sceneContext.shadowAtlas;
+    // The faces share one size, their tiles move together
+    const AtlasTile &firstTile = atlas.getTile(plw.shadowSlot, 0);
+    if (firstTile != this->_tile)
+        this->_cacheValid = false;
+    this->_tile = firstTile;
+    if (!firstTile.size || (this->_cacheValid && !this->_dynamicCasters && !this->_drewDynamicCasters))
+    {
+        // Not important enough for the atlas this frame, or its tiles still hold last frame's shadows
+        this->_cullStats = CullStats();
+        return;
+    }
+
+    this->_context.getState().clearColor(1.0, 1.0, 1.0, 1);
 
     this->_loadShader();
 
     this->_loadInputFramebuffers();
 
-    this->_loadOutputFramebuffer();
-
-    glEnable(GL_DEPTH_TEST);
+    this->_context.getState().enable(GL_DEPTH_TEST);
 
-    // 1. first render to depth map
-    glViewport(0, 0, 1024, 1024);
-
-    glClear(GL_DEPTH_BUFFER_BIT);
+    // The geometry shader picks the viewport of each face
+    for (int i = 0; i < 6; ++i)
+    {
+        const AtlasTile &tile = atlas.getTile(plw.shadowSlot, i);
+        // glViewport sets every viewport, the first one goes through the state cache before the others
+        if (i == 0)
+            this->_context.getState().viewport(tile.x, tile.y, tile.size, tile.size);
+        else
+            glViewportIndexedf(i, (GLfloat)tile.x, (GLfloat)tile.y, (GLfloat)tile.size, (GLfloat)tile.size);
+    }
 
-    const PointLightWrapper &plw = this->_sceneContext.pLights.find(this->_light.getId())->second;
     const auto &shadowTransforms = plw.shadowTransforms;
     for (int i = 0; i < 6; ++i)
     {
@@ -60,46 +72,107 @@ void CubeShadowMapNode::render()
     this->_shader.setVector3("lightPos", plw.uniform.position);
     this->_shader.setFloat("far_plane", PointLightWrapper::far);
 
+    this->_lightSphere.center = plw.uniform.position;
+    this->_lightSphere.radius = PointLightWrapper::far;
+    for (int i = 0; i < 6; ++i)
+        this->_faceFrusta[i] = Frustum(shadowTransforms[i]);
+
+    // Casters are gathered first and drawn with one multi-draw per geometry page, each one
+    // only to the faces its bounds touch
     glm::mat4x4 m;
-    this->_renderRec(this->_sceneGraph.getRoot(), &m);
+    this->_draws.clear();
+    this->_staticDraws.clear();
+    this->_cullStats = CullStats();
+    this->_renderRec(this->_sceneGraph.getRoot(), &m, ALL_FACES, false);
+
+    // 1. first render the static casters to the cache layer when they changed
+    if (!this->_cacheValid)
+    {
+        this->_context.loadFramebuffer(&atlas.getCacheFramebuffer());
+        for (int i = 0; i < 6; ++i)
+            atlas.clearTile(this->_context, atlas.getTile(plw.shadowSlot, i));
+        this->_staticDraws.upload(this->_context);
+        this->_staticDraws.draw(this->_context);
+        this->_cacheValid = true;
+    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // 2. then the dynamic ones over a copy of it, in the faces' tiles of the shadow atlas
+    for (int i = 0; i < 6; ++i)
+        atlas.copyCachedTile(atlas.getTile(plw.shadowSlot, i));
+    if (this->_draws.size())
+    {
+        this->_loadOutputFramebuffer();
+        this->_draws.upload(this->_context);
+        this->_draws.draw(this->_context);
+    }
+    this->_drewDynamicCasters = this->_draws.size() > 0;
+
+    this->_context.getState().bindFramebuffer(GL_FRAMEBUFFER, 0);
     // 2. then render scene as normal with shadow mapping (using depth map)
-    glViewport(0, 0, 1620, 1080);
+    this->_context.getState().viewport(0, 0, 1620, 1080);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void CubeShadowMapNode::_renderRec(const Entity *root, const glm::mat4x4 *matrix)
+void CubeShadowMapNode::_renderRec(const Entity *root, const glm::mat4x4 *matrix, unsigned int faces, bool dynamic)
 {
+    unsigned int nbVolumes = root->getSubtreeVolumeCount();
+    if (!nbVolumes)
+        return;
+    // Faces the subtree misses are not tested again below it
+    faces = this->_testFaces(root->getSubtreeBounds(), faces);
+    if (!faces)
+    {
+        this->_cullStats.culled += nbVolumes;
+        return;
+    }
+
     const glm::mat4x4 *newMatrix = matrix;
     const IComponent *p_component;
     p_component = root->getComponent(ComponentType::TRANSFORMATION);
     if (p_component)
     {
         newMatrix = &(static_cast<const Transformation *>(p_component))->getTransformationMatrix();
-        this->_shader.setMat4("model", *newMatrix);
+        dynamic = dynamic || this->_sceneContext.isDynamicCaster(root->getId());
     }
 
     p_component = root->getComponent(ComponentType::VOLUME);
     if (p_component)
     {
-        this->_context.drawVolume(*static_cast<const Volume *>(p_component),
-                                  this->_sceneContext.bufferCollections.find(p_component->getId())->second);
+        // Without children the subtree bounds are the volume's, already tested
+        unsigned int volumeFaces = root->getChildren().size() ? this->_testFaces(root->getWorldBounds(), faces) : faces;
+        // Static casters are only needed to redraw the cache
+        MultiDrawBuffer *draws = dynamic ? &this->_draws : (this->_cacheValid ? nullptr : &this->_staticDraws);
+        if (volumeFaces && draws)
+        {
+            this->_cullStats.visible++;
+            draws->add(this->_context.getGeometryPool().allocate(*static_cast<const Volume *>(p_component)), *newMatrix,
+                       glm::mat3(), 0, volumeFaces);
+        }
+        else if (!volumeFaces)
+            this->_cullStats.culled++;
     }
 
     for (auto &child : root->getChildren())
-        this->_renderRec(child.second, newMatrix);
-    if (newMatrix != matrix)
-        this->_shader.setMat4("model", *matrix);
+        this->_renderRec(child.second, newMatrix, faces, dynamic);
+}
+
+unsigned int CubeShadowMapNode::_testFaces(const AABB &bounds, unsigned int faces)
+{
+    this->_cullStats.tested++;
+    if (!this->_lightSphere.intersects(bounds))
+        return 0;
+    for (int i = 0; i < 6; ++i)
+    {
+        if ((faces & (1u << i)) && this->_faceFrusta[i].test(bounds) == OUTSIDE_FRUSTUM)
+            faces &= ~(1u << i);
+    }
+    return faces;
 }
 
 void CubeShadowMapNode::_loadShader()
 {
     RenderNode::_loadShader();
     this->_shader.use();
-
-    glm::mat4 m;
-    this->_shader.setMat4("model", m);
 }
 
 void CubeShadowMapNode::notified(Subject *subject, Event event)
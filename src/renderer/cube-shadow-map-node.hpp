@@ -1,6 +1,8 @@
 #pragma once
 
 #include <renderer/render-node.hpp>
+#include <renderer/multi-draw-buffer.hpp>
+#include <renderer/shadow-atlas.hpp>
 
 #include <controller/observer.hpp>
 
@@ -19,6 +21,9 @@ class SceneGraph;
 class CubeMap;
 class Transformation;
 
+/* Shadow map of a point light, six tiles of the SceneContext's ShadowAtlas drawn in one pass.
+   * Static casters are cached like in the ShadowMappingNode.
+   */
 class CubeShadowMapNode : public RenderNode
 {
   public:
@@ -27,14 +32,28 @@ class CubeShadowMapNode : public RenderNode
   public:
     virtual void render() override;
     virtual void notified(Subject *subject, Event event);
+    void invalidateCache() { this->_cacheValid = false; }
+    void setDynamicCasters(bool inReach) { this->_dynamicCasters = inReach; }
+
+  public:
+    static const unsigned int ALL_FACES = 0x3f; // Layer mask of the six cube map faces
 
   private:
-    void _renderRec(const Entity *root, const glm::mat4x4 *matrix);
+    void _renderRec(const Entity *root, const glm::mat4x4 *matrix, unsigned int faces, bool dynamic);
+    unsigned int _testFaces(const AABB &bounds, unsigned int faces);
     void _loadShader();
 
   private:
     const SceneGraph &_sceneGraph;
+    MultiDrawBuffer _draws;       // Dynamic casters
+    MultiDrawBuffer _staticDraws; // Only gathered when the cache is redrawn
     const PointLight &_light;
+    BoundingSphere _lightSphere; // Reach of the light, up to the far plane of the faces
+    Frustum _faceFrusta[6];
+    AtlasTile _tile; // Of the first face, last frame
+    bool _cacheValid = false;
+    bool _dynamicCasters = false;     // In the light's reach this frame, set by the SceneContext
+    bool _drewDynamicCasters = false; // Over the cached tiles, last frame
 };
 
 } // namespace leo
\ No newline at end of file
@@ -39,7 +39,6 @@ protected:
   void _loadLightsToShader();
 
 private:
-  GLuint _lightsUBO = 0;
   const SceneGraph &_sceneGraph;
   const Camera &_camera;
   bool _hdr = true;
@@ -5,6 +5,8 @@
 #include <renderer/input-manager.hpp>
 #include <model/scene-graph.hpp>
 
+#include <iostream>
+
 namespace leo
 {
 
@@ -56,6 +58,7 @@ void Engine::_initRenderer(Shader shader)
         this->_camera,
         shader,
         *this->_scene);
+    this->_renderer->setGPUCulling(this->_gpuCulling);
     this->_renderer->createMainNode(this->_scene);
     this->_renderer->createBlitNode();
     this->_renderer->createCubeMapNode(this->_scene);
@@ -81,6 +84,13 @@ void Engine::setInstancedScene(SceneGraph *scene, const std::vector<glm::mat4> &
   this->_renderer->createInstancedNode(scene, transformations);
 }
 
+void Engine::setGPUCulling(bool enabled)
+{
+  this->_gpuCulling = enabled;
+  if (this->_renderer)
+    this->_renderer->setGPUCulling(enabled);
+}
+
 void Engine::gameLoop()
 {
   // Render to our framebuffer
@@ -95,6 +105,7 @@ void Engine::gameLoop()
     lastFrame = currentFrame;
 
     this->doMovement(deltaTime);
+    this->_processToggles();
 
     if (this->_scene)
     {
@@ -135,4 +146,20 @@ void Engine::doMovement(float deltaTime)
   }
 }
 
+void Engine::_processToggles()
+{
+  bool gpuCullingKey = this->inputManager->keys[GLFW_KEY_G];
+  if (gpuCullingKey && !this->_gpuCullingKey)
+  {
+    this->setGPUCulling(!this->_gpuCulling);
+    std::cout << "GPU culling " << (this->_gpuCulling ? "enabled" : "disabled") << std::endl;
+  }
+  this->_gpuCullingKey = gpuCullingKey;
+
+  bool reportKey = this->inputManager->keys[GLFW_KEY_C];
+  if (reportKey && !this->_reportKey && this->_renderer)
+    this->_renderer->printCullReport(std::cout);
+  this->_reportKey = reportKey;
+}
+
 } // namespace leo
@@ -29,11 +29,13 @@ public:
 private:
   void _init();
   void doMovement(float deltaTime);
+  void _processToggles();
   void _initRenderer(Shader shader);
 
 public:
   void setScene(SceneGraph *scene);
   void setInstancedScene(SceneGraph *instancedScene, const std::vector<glm::mat4> &transformations);
+  void setGPUCulling(bool enabled); // Toggled with G while running, C prints the culling report
   void gameLoop();
 
 public: // Control attributes
@@ -46,6 +48,9 @@ private:
   SceneGraph *_scene = nullptr;
   GLuint screenWidth = 1620;
   GLuint screenHeight = 1080;
+  bool _gpuCulling = false;
+  bool _gpuCullingKey = false; // Pressed last frame, toggles only act on a new press
+  bool _reportKey = false;
 };
 
 } // namespace leo
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+namespace leo
+{
+
+/* Camera and timing data of a frame, std140 layout of the "FrameGlobals" uniform block.
+   * Written once per frame by SceneContext::updateFrameGlobals and bound at FRAME_GLOBALS_BINDING for every program.
+   */
+typedef struct FrameGlobals
+{
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat4 viewProjection;
+  glm::mat4 inverseView;
+  glm::mat4 inverseProjection;
+  glm::vec4 cameraPosition; // w: 1
+  glm::vec4 time;           // x: seconds since the start, y: duration of the last frame
+  glm::vec4 resolution;     // xy: pixels, zw: size of a pixel
+} FrameGlobals;
+
+static const GLuint FRAME_GLOBALS_BINDING = 0; // Uniform buffer binding, the lights block uses 1
+
+} // namespace leo
@@ -0,0 +1,113 @@
+#include "frame-ring-buffer.hpp"
+
+#include <renderer/gpu-memory-tracker.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace leo
+{
+
+FrameRingBuffer::FrameRingBuffer(size_t frameSize) : _frameSize(frameSize)
+{
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+    for (GLsync &fence : this->_fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    if (!this->_buffer)
+        return;
+    GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_buffer);
+    glUnmapNamedBuffer(this->_buffer);
+    glDeleteBuffers(1, &this->_buffer);
+}
+
+void FrameRingBuffer::beginFrame()
+{
+    if (!this->_buffer)
+        this->_init();
+    this->_frame++;
+    this->_offset = 0;
+    this->_overflowReported = false;
+
+    // The region was last written NB_FRAMES frames ago, the GPU is usually done with it
+    GLsync &fence = this->_fences[this->_frame % NB_FRAMES];
+    if (!fence)
+        return;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+void FrameRingBuffer::endFrame()
+{
+    GLsync &fence = this->_fences[this->_frame % NB_FRAMES];
+    if (fence)
+        glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+FrameAllocation FrameRingBuffer::allocate(size_t size)
+{
+    if (!this->_buffer)
+        this->_init();
+    FrameAllocation allocation;
+    if (!this->_mapped)
+        return allocation;
+    size_t offset = (this->_offset + this->_alignment - 1) / this->_alignment * this->_alignment;
+    if (offset + size > this->_frameSize)
+    {
+        if (!this->_overflowReported)
+            std::cerr << "FrameRingBuffer: " << this->_frameSize << " bytes per frame are not enough" << std::endl;
+        this->_overflowReported = true;
+        return allocation;
+    }
+    this->_offset = offset + size;
+    allocation.buffer = this->_buffer;
+    allocation.offset = (GLintptr)((this->_frame % NB_FRAMES) * this->_frameSize + offset);
+    allocation.size = (GLsizeiptr)size;
+    allocation.data = this->_mapped + allocation.offset;
+    return allocation;
+}
+
+FrameAllocation FrameRingBuffer::upload(const void *data, size_t size)
+{
+    FrameAllocation allocation = this->allocate(size);
+    if (allocation.data)
+        std::memcpy(allocation.data, data, size);
+    return allocation;
+}
+
+void FrameRingBuffer::bindRange(GLenum target, GLuint binding, const FrameAllocation &allocation) const
+{
+    if (allocation.buffer)
+        glBindBufferRange(target, binding, allocation.buffer, allocation.offset, allocation.size);
+}
+
+void FrameRingBuffer::_init()
+{
+    GLint uniformAlignment = 0;
+    GLint storageAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    this->_alignment = (size_t)std::max({uniformAlignment, storageAlignment, 16});
+
+    // Coherent, written data is visible to the next commands without flushing
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    size_t size = NB_FRAMES * this->_frameSize;
+    glCreateBuffers(1, &this->_buffer);
+    glNamedBufferStorage(this->_buffer, size, nullptr, flags);
+    this->_mapped = static_cast<unsigned char *>(glMapNamedBufferRange(this->_buffer, 0, size, flags));
+    if (!this->_mapped)
+        std::cerr << "FrameRingBuffer: Cannot map the buffer persistently" << std::endl;
+    GPUMemoryTracker::getInstance()->track(GL_BUFFER, this->_buffer, GPUMemoryCategory::UNIFORM_BUFFERS, size, "frame ring buffer");
+}
+
+} // namespace leo
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+namespace leo
+{
+
+typedef struct FrameAllocation
+{
+  GLuint buffer = 0;
+  GLintptr offset = 0;
+  GLsizeiptr size = 0;
+  void *data = nullptr; // Write-only, null when the allocation failed
+} FrameAllocation;
+
+/* Persistently mapped buffer that every node writes its per-frame data into (lights, draw data, indirect commands).
+   * It is split in NB_FRAMES regions used in turn, a fence per region makes the CPU wait before overwriting data
+   * the GPU may still read. Allocations are only valid until the end of the frame and are bound by range, so
+   * writing them never makes the driver synchronize.
+   */
+class FrameRingBuffer
+{
+public:
+  FrameRingBuffer(size_t frameSize = DEFAULT_FRAME_SIZE);
+  ~FrameRingBuffer();
+  FrameRingBuffer(const FrameRingBuffer &other) = delete;
+  FrameRingBuffer &operator=(const FrameRingBuffer &other) = delete;
+
+public:
+  void beginFrame();
+  void endFrame();
+  FrameAllocation allocate(size_t size);
+  FrameAllocation upload(const void *data, size_t size);
+  void bindRange(GLenum target, GLuint binding, const FrameAllocation &allocation) const;
+  unsigned long long getFrame() const { return this->_frame; }
+
+public:
+  static const unsigned int NB_FRAMES = 3;
+  static const size_t DEFAULT_FRAME_SIZE = 16 * 1024 * 1024;
+
+private:
+  void _init();
+
+private:
+  GLuint _buffer = 0;
+  unsigned char *_mapped = nullptr;
+  size_t _frameSize = 0;
+  size_t _alignment = 256;
+  size_t _offset = 0; // In the current region
+  GLsync _fences[NB_FRAMES] = {};
+  unsigned long long _frame = 0;
+  bool _overflowReported = false;
+};
+
+} // namespace leo
@@ -1,5 +1,8 @@
 #include "framebuffer.hpp"
 
+#include <renderer/gl-state-cache.hpp>
+#include <renderer/gpu-memory-tracker.hpp>
+
 #include <utils/texture.hpp>
 
 namespace leo
@@ -16,9 +19,10 @@ void Framebuffer::addColorBuffer(ColorBufferOptions options)
   if (!this->_id)
     glGenFramebuffers(1, &this->_id);
 
-  glBindFramebuffer(GL_FRAMEBUFFER, this->_id);
+  GLStateCache::getInstance()->bindFramebuffer(GL_FRAMEBUFFER, this->_id);
 
   TextureOptions textureOptions;
+  textureOptions.mipmaps = false;
   GLTextureOptions glOptions;
 
   // Special texture types
@@ -35,6 +39,8 @@ void Framebuffer::addColorBuffer(ColorBufferOptions options)
 
   this->_colorBuffers.push_back(TextureWrapper(options.width, options.height, glOptions, textureOptions));
   TextureWrapper &tw = this->_colorBuffers.back();
+  GPUMemoryTracker::getInstance()->track(GL_TEXTURE, tw.getId(), GPUMemoryCategory::RENDER_TARGETS, tw.getMemorySize(),
+                                         this->_name + " color " + std::to_string(this->_colorBuffers.size() - 1));
 
   // Set "renderedTexture" as our colour attachement #0
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + this->_colorBuffers.size() - 1, tw.getId(), 0);
@@ -49,12 +55,12 @@ void Framebuffer::addColorBuffer(ColorBufferOptions options)
     exit(1);
   }
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLStateCache::getInstance()->bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::useRenderBuffer(RenderBufferOptions options)
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, this->_id);
+  GLStateCache::getInstance()->bindFramebuffer(GL_FRAMEBUFFER, this->_id);
 
   // The depth buffer
   GLuint depthrenderbuffer;
@@ -69,6 +75,8 @@ void Framebuffer::useRenderBuffer(RenderBufferOptions options)
   {
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, options.width, options.height);
   }
+  GPUMemoryTracker::getInstance()->track(GL_RENDERBUFFER, depthrenderbuffer, GPUMemoryCategory::RENDER_TARGETS,
+                                         (size_t)options.width * options.height * 4 * options.nbSamples, this->_name + " depth stencil");
 
   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthrenderbuffer);
 
@@ -87,9 +95,10 @@ void Framebuffer::setDepthBuffer(DepthBufferOptions options)
   if (!this->_id)
     glGenFramebuffers(1, &this->_id);
 
-  glBindFramebuffer(GL_FRAMEBUFFER, this->_id);
+  GLStateCache::getInstance()->bindFramebuffer(GL_FRAMEBUFFER, this->_id);
 
   TextureOptions textureOptions;
+  textureOptions.mipmaps = false;
   GLTextureOptions glOptions;
 
   if (options.type == DepthBufferType::CUBE_MAP) // For depth cube map
@@ -97,13 +106,14 @@ void Framebuffer::setDepthBuffer(DepthBufferOptions options)
     glOptions.textureType = GL_TEXTURE_CUBE_MAP;
   }
 
-  glOptions.internalFormat = GL_DEPTH_COMPONENT;
+  glOptions.internalFormat = options.internalFormat;
   glOptions.format = GL_DEPTH_COMPONENT;
   glOptions.wrapping = options.type == DepthBufferType::CUBE_MAP ? GL_CLAMP_TO_EDGE : GL_CLAMP_TO_BORDER;
-  glOptions.type = GL_FLOAT;
+  glOptions.type = options.dataType;
 
   this->_depthBuffer = std::unique_ptr<TextureWrapper>(new TextureWrapper(options.width, options.height, glOptions, textureOptions));
   TextureWrapper &tw = *this->_depthBuffer.get();
+  GPUMemoryTracker::getInstance()->track(GL_TEXTURE, tw.getId(), GPUMemoryCategory::SHADOW_MAPS, tw.getMemorySize(), this->_name + " depth");
 
   if (options.type == DepthBufferType::DEPTH_MAP)
   {
@@ -124,29 +134,31 @@ void Framebuffer::setDepthBuffer(DepthBufferOptions options)
     exit(1);
   }
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  GLStateCache::getInstance()->bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-Framebuffer::Framebuffer(const Framebuffer &other) : _id(other._id), _colorBuffers(other._colorBuffers)
+Framebuffer::Framebuffer(const Framebuffer &other) : _id(other._id), _name(other._name), _colorBuffers(other._colorBuffers)
 {
   this->_depthBuffer = other._depthBuffer.get() ? std::unique_ptr<TextureWrapper>(new TextureWrapper(*other._depthBuffer.get())) : nullptr;
 }
 
 Framebuffer::~Framebuffer()
 {
+  GLStateCache::getInstance()->forgetFramebuffer(this->_id);
   glDeleteFramebuffers(1, &this->_id);
 }
 
 Framebuffer &Framebuffer::operator=(const Framebuffer &other)
 {
   this->_id = other._id;
+  this->_name = other._name;
   this->_colorBuffers = other._colorBuffers;
   return *this;
 }
 
 void Framebuffer::loadFrameBuffer(GLuint bindingType) const
 {
-  glBindFramebuffer(bindingType, this->_id);
+  GLStateCache::getInstance()->bindFramebuffer(bindingType, this->_id);
 }
 
 } // namespace leo
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <string>
 
 namespace leo
 {
@@ -33,6 +34,8 @@ typedef struct DepthBufferOptions
   DepthBufferType type = DepthBufferType::DEPTH_MAP;
   unsigned int width = 1620;
   unsigned int height = 1080;
+  GLuint internalFormat = GL_DEPTH_COMPONENT; // Sized formats such as GL_DEPTH_COMPONENT16 save memory
+  GLuint dataType = GL_FLOAT;
 } DepthBufferOptions;
 
 typedef struct RenderBufferOptions
@@ -54,6 +57,8 @@ public:
 
 public:
   GLuint getId() const { return this->_id; }
+  const std::string &getName() const { return this->_name; }
+  void setName(const std::string &name) { this->_name = name; } // Used to label the buffers in memory reports
   const std::vector<TextureWrapper> &getColorBuffers() const { return this->_colorBuffers; }
   const TextureWrapper &getDepthBuffer() const { return *this->_depthBuffer.get(); }
   void loadFrameBuffer(GLuint bindingType = GL_FRAMEBUFFER) const;
@@ -63,6 +68,7 @@ public:
 
 private:
   GLuint _id = 0;
+  std::string _name = "framebuffer";
   std::vector<TextureWrapper> _colorBuffers;
   std::unique_ptr<TextureWrapper> _depthBuffer = nullptr;
 
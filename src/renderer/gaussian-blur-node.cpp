@@ -13,10 +13,10 @@
 namespace leo
 {
 
-GaussianBlurNode::GaussianBlurNode(OpenGLContext &context, SceneContext &sceneContext, SceneGraph &sceneGraph, unsigned int amount)
-    : _gaussianBlurShader("resources/shaders/post-process.vs.glsl", "resources/shaders/blur.frag.glsl"),
-      PostProcessNode(context, sceneContext, sceneGraph, _gaussianBlurShader), _amount(amount)
+GaussianBlurNode::GaussianBlurNode(OpenGLContext &context, SceneContext &sceneContext, SceneGraph &sceneGraph, Shader &shader, unsigned int amount)
+    : PostProcessNode(context, sceneContext, sceneGraph, shader), _amount(amount)
 {
+    this->_pingPong.setName("blur ping pong");
     this->_pingPong.addColorBuffer();
     this->_pingPong.useRenderBuffer();
 }
@@ -40,17 +40,16 @@ void GaussianBlurNode::render()
     {
         this->_shader.setInt("horizontal", horizontal);
 
-        glUniform1i(glGetUniformLocation(this->_shader.getProgram(), "fb"), 0);
-        glActiveTexture(GL_TEXTURE0);
+        this->_shader.setInt("fb", 0);
         if (i == 0)
-            glBindTexture(GL_TEXTURE_2D, this->_inputs.begin()->second.getId());  // First time we use the input buffer
+            this->_context.getState().bindTexture(0, GL_TEXTURE_2D, this->_inputs.begin()->second.getId());  // First time we use the input buffer
         else
-            glBindTexture(GL_TEXTURE_2D, inputs[(i) % 2]->getId());
+            this->_context.getState().bindTexture(0, GL_TEXTURE_2D, inputs[(i) % 2]->getId());
 
         this->_context.loadFramebuffer(outputs[(i + 1) % 2]);
 
         this->_context.drawVolume(*this->_postProcessGeometry,
-                                  this->_sceneContext.bufferCollections.find(this->_postProcessGeometry->getId())->second);
+                                  this->_sceneContext.getBufferCollection(*this->_postProcessGeometry));
 
         horizontal != horizontal;
     }
@@ -18,13 +18,12 @@ class Volume;
 class GaussianBlurNode : public PostProcessNode
 {
   public:
-    GaussianBlurNode(OpenGLContext &context, SceneContext &sceneContext, SceneGraph &sceneGraph, unsigned int amount = 5);
+    GaussianBlurNode(OpenGLContext &context, SceneContext &sceneContext, SceneGraph &sceneGraph, Shader &shader, unsigned int amount = 5);
 
   public:
     virtual void render() override;
 
   private:
-    Shader _gaussianBlurShader;
     Framebuffer _pingPong;
     unsigned int _amount;
 };
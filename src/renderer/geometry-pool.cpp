@@ -0,0 +1,189 @@
+#include "geometry-pool.hpp"
+
+#include <renderer/gpu-memory-tracker.hpp>
+#include <renderer/opengl-context.hpp>
+
+#include <model/components/volume.hpp>
+
+#include <iostream>
+#include <numeric>
+
+namespace leo
+{
+
+RangeAllocator::RangeAllocator(size_t capacity)
+{
+    if (capacity)
+        this->_freeRanges[0] = capacity;
+}
+
+bool RangeAllocator::allocate(size_t size, size_t &offset)
+{
+    for (auto it = this->_freeRanges.begin(); it != this->_freeRanges.end(); ++it)
+    {
+        if (it->second < size)
+            continue;
+        offset = it->first;
+        size_t remaining = it->second - size;
+        this->_freeRanges.erase(it);
+        if (remaining)
+            this->_freeRanges[offset + size] = remaining;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(size_t offset, size_t size)
+{
+    auto next = this->_freeRanges.lower_bound(offset);
+    if (next != this->_freeRanges.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = this->_freeRanges.erase(next);
+    }
+    if (next != this->_freeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+    this->_freeRanges[offset] = size;
+}
+
+GeometryPool::GeometryPool(OpenGLContext &context) : _context(context)
+{
+}
+
+GeometryPool::~GeometryPool()
+{
+    for (GeometryPage &page : this->_pages)
+    {
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, page.VBO);
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, page.EBO);
+        this->_context.getState().forgetVertexArray(page.VAO);
+        glDeleteVertexArrays(1, &page.VAO);
+        glDeleteBuffers(1, &page.VBO);
+        glDeleteBuffers(1, &page.EBO);
+    }
+    if (this->_drawIdBuffer)
+    {
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_drawIdBuffer);
+        glDeleteBuffers(1, &this->_drawIdBuffer);
+    }
+}
+
+const GeometryRange &GeometryPool::allocate(const Volume &volume)
+{
+    auto it = this->_ranges.find(volume.getId());
+    if (it != this->_ranges.end())
+        return it->second;
+
+    const std::vector<Vertex> &vertices = volume.getVertices();
+    const std::vector<GLuint> &indices = volume.getIndices();
+    size_t vertexOffset = 0;
+    size_t indexOffset = 0;
+    unsigned int pageIndex = 0;
+    for (; pageIndex < this->_pages.size(); ++pageIndex)
+    {
+        GeometryPage &page = this->_pages[pageIndex];
+        if (!page.vertices.allocate(vertices.size(), vertexOffset))
+            continue;
+        if (page.indices.allocate(indices.size(), indexOffset))
+            break;
+        page.vertices.free(vertexOffset, vertices.size());
+    }
+    if (pageIndex == this->_pages.size())
+    {
+        pageIndex = this->_createPage(std::max(vertices.size(), PAGE_VERTICES), std::max(indices.size(), PAGE_INDICES));
+        this->_pages[pageIndex].vertices.allocate(vertices.size(), vertexOffset);
+        this->_pages[pageIndex].indices.allocate(indices.size(), indexOffset);
+    }
+
+    const GeometryPage &page = this->_pages[pageIndex];
+    if (vertices.size())
+        glNamedBufferSubData(page.VBO, vertexOffset * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+    if (indices.size())
+        glNamedBufferSubData(page.EBO, indexOffset * sizeof(GLuint), indices.size() * sizeof(GLuint), indices.data());
+
+    GeometryRange &range = this->_ranges[volume.getId()];
+    range.page = pageIndex;
+    range.baseVertex = (GLint)vertexOffset;
+    range.firstIndex = (GLuint)indexOffset;
+    range.vertexCount = (GLuint)vertices.size();
+    range.indexCount = (GLuint)indices.size();
+    range.bounds = volume.getBounds();
+    return range;
+}
+
+const GeometryRange *GeometryPool::find(t_id volumeId) const
+{
+    auto it = this->_ranges.find(volumeId);
+    return it == this->_ranges.end() ? nullptr : &it->second;
+}
+
+void GeometryPool::release(t_id volumeId)
+{
+    // The range can be reused right away: the GL orders the uploads after the draws already submitted
+    auto it = this->_ranges.find(volumeId);
+    if (it == this->_ranges.end())
+        return;
+    GeometryPage &page = this->_pages[it->second.page];
+    page.vertices.free(it->second.baseVertex, it->second.vertexCount);
+    page.indices.free(it->second.firstIndex, it->second.indexCount);
+    this->_ranges.erase(it);
+}
+
+unsigned int GeometryPool::_createPage(size_t nbVertices, size_t nbIndices)
+{
+    GeometryPage page;
+    page.vertices = RangeAllocator(nbVertices);
+    page.indices = RangeAllocator(nbIndices);
+
+    glCreateBuffers(1, &page.VBO);
+    glNamedBufferStorage(page.VBO, nbVertices * sizeof(Vertex), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &page.EBO);
+    glNamedBufferStorage(page.EBO, nbIndices * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateVertexArrays(1, &page.VAO);
+    glVertexArrayVertexBuffer(page.VAO, 0, page.VBO, 0, sizeof(Vertex));
+    glVertexArrayElementBuffer(page.VAO, page.EBO);
+    const GLint sizes[5] = {3, 3, 2, 3, 3};
+    const GLuint offsets[5] = {0, offsetof(Vertex, normal), offsetof(Vertex, texCoords),
+                               offsetof(Vertex, tangent), offsetof(Vertex, biTangent)};
+    for (GLuint attribute = 0; attribute < 5; ++attribute)
+    {
+        glEnableVertexArrayAttrib(page.VAO, attribute);
+        glVertexArrayAttribFormat(page.VAO, attribute, sizes[attribute], GL_FLOAT, GL_FALSE, offsets[attribute]);
+        glVertexArrayAttribBinding(page.VAO, attribute, 0);
+    }
+
+    glVertexArrayVertexBuffer(page.VAO, 1, this->_getDrawIdBuffer(), 0, sizeof(GLuint));
+    glVertexArrayBindingDivisor(page.VAO, 1, 1);
+    glEnableVertexArrayAttrib(page.VAO, DRAW_ID_LOCATION);
+    glVertexArrayAttribIFormat(page.VAO, DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, 0);
+    glVertexArrayAttribBinding(page.VAO, DRAW_ID_LOCATION, 1);
+
+    std::string label = "geometry page " + std::to_string(this->_pages.size());
+    GPUMemoryTracker::getInstance()->track(GL_BUFFER, page.VBO, GPUMemoryCategory::VERTEX_BUFFERS, nbVertices * sizeof(Vertex), label);
+    GPUMemoryTracker::getInstance()->track(GL_BUFFER, page.EBO, GPUMemoryCategory::INDEX_BUFFERS, nbIndices * sizeof(GLuint), label);
+    this->_pages.push_back(page);
+    return (unsigned int)this->_pages.size() - 1;
+}
+
+GLuint GeometryPool::_getDrawIdBuffer()
+{
+    if (this->_drawIdBuffer)
+        return this->_drawIdBuffer;
+    std::vector<GLuint> ids(MAX_DRAWS);
+    std::iota(ids.begin(), ids.end(), 0);
+    glCreateBuffers(1, &this->_drawIdBuffer);
+    glNamedBufferStorage(this->_drawIdBuffer, ids.size() * sizeof(GLuint), ids.data(), 0);
+    GPUMemoryTracker::getInstance()->track(GL_BUFFER, this->_drawIdBuffer, GPUMemoryCategory::VERTEX_BUFFERS,
+                                           ids.size() * sizeof(GLuint), "draw ids");
+    return this->_drawIdBuffer;
+}
+
+} // namespace leo
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <utils/bounds.hpp>
+
+#include <map>
+#include <vector>
+
+namespace leo
+{
+
+class OpenGLContext;
+class Volume;
+
+typedef struct GeometryRange
+{
+  unsigned int page = 0;
+  GLint baseVertex = 0;
+  GLuint firstIndex = 0;
+  GLuint vertexCount = 0;
+  GLuint indexCount = 0;
+  AABB bounds; // Of the volume, in model space
+} GeometryRange;
+
+/* First fit allocator of [offset, offset + size) ranges in a fixed capacity, freed ranges are merged.
+   */
+class RangeAllocator
+{
+public:
+  RangeAllocator(size_t capacity = 0);
+
+public:
+  bool allocate(size_t size, size_t &offset);
+  void free(size_t offset, size_t size);
+
+private:
+  std::map<size_t, size_t> _freeRanges; // Offset to size
+};
+
+/* Static geometry sub-allocated in a few large vertex and index buffers.
+   * Each page has one VAO sharing the vertex layout of OpenGLContext::generateBufferCollection, plus a
+   * per-instance draw id (attribute DRAW_ID_LOCATION) so that shaders can fetch per-draw data with the
+   * baseInstance of indirect commands. Volumes bigger than a page get a page of their own.
+   */
+class GeometryPool
+{
+
+  using t_id = unsigned int;
+
+public:
+  GeometryPool(OpenGLContext &context);
+  ~GeometryPool();
+
+public:
+  const GeometryRange &allocate(const Volume &volume);
+  const GeometryRange *find(t_id volumeId) const;
+  void release(t_id volumeId);
+  GLuint getVAO(unsigned int page) const { return this->_pages[page].VAO; }
+  size_t getNbPages() const { return this->_pages.size(); }
+
+public:
+  static const GLuint DRAW_ID_LOCATION = 8;
+  static const size_t MAX_DRAWS = 65536;          // Per multi-draw call
+  static const size_t PAGE_VERTICES = 512 * 1024; // 28MiB of vertices
+  static const size_t PAGE_INDICES = 3 * PAGE_VERTICES;
+
+private:
+  typedef struct GeometryPage
+  {
+    GLuint VAO = 0;
+    GLuint VBO = 0;
+    GLuint EBO = 0;
+    RangeAllocator vertices;
+    RangeAllocator indices;
+  } GeometryPage;
+
+private:
+  unsigned int _createPage(size_t nbVertices, size_t nbIndices);
+  GLuint _getDrawIdBuffer();
+
+private:
+  OpenGLContext &_context;
+  std::vector<GeometryPage> _pages;
+  std::map<t_id, GeometryRange> _ranges;
+  GLuint _drawIdBuffer = 0; // 0, 1, 2... read once per instance, shared by every page
+};
+
+} // namespace leo
@@ -0,0 +1,60 @@
+#include "gl-extensions.hpp"
+
+#include <iostream>
+
+namespace leo
+{
+
+bool GLExtensions::parallelShaderCompile = false;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC GLExtensions::glMaxShaderCompilerThreadsKHR = nullptr;
+bool GLExtensions::bindlessTexture = false;
+PFNGLGETTEXTUREHANDLEARBPROC GLExtensions::glGetTextureHandleARB = nullptr;
+PFNGLMAKETEXTUREHANDLERESIDENTARBPROC GLExtensions::glMakeTextureHandleResidentARB = nullptr;
+PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC GLExtensions::glMakeTextureHandleNonResidentARB = nullptr;
+bool GLExtensions::indirectParameters = false;
+PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC GLExtensions::glMultiDrawElementsIndirectCountARB = nullptr;
+std::set<std::string> GLExtensions::_extensions;
+
+void GLExtensions::load()
+{
+  _extensions.clear();
+  GLint nbExtensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &nbExtensions);
+  for (GLint i = 0; i < nbExtensions; ++i)
+  {
+    const GLubyte *name = glGetStringi(GL_EXTENSIONS, i);
+    if (name)
+      _extensions.insert(reinterpret_cast<const char *>(name));
+  }
+
+  // The ARB version shares the tokens, only the entry point name differs
+  if (has("GL_KHR_parallel_shader_compile"))
+    glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+  else if (has("GL_ARB_parallel_shader_compile"))
+    glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+  parallelShaderCompile = glMaxShaderCompilerThreadsKHR != nullptr;
+  if (parallelShaderCompile)
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // Let the driver pick the number of threads
+  std::cerr << "Parallel shader compilation " << (parallelShaderCompile ? "enabled" : "unavailable") << std::endl;
+
+  if (has("GL_ARB_bindless_texture"))
+  {
+    glGetTextureHandleARB = (PFNGLGETTEXTUREHANDLEARBPROC)glfwGetProcAddress("glGetTextureHandleARB");
+    glMakeTextureHandleResidentARB = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)glfwGetProcAddress("glMakeTextureHandleResidentARB");
+    glMakeTextureHandleNonResidentARB = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+  }
+  bindlessTexture = glGetTextureHandleARB && glMakeTextureHandleResidentARB && glMakeTextureHandleNonResidentARB;
+  std::cerr << "Bindless textures " << (bindlessTexture ? "enabled" : "unavailable") << std::endl;
+
+  if (has("GL_ARB_indirect_parameters"))
+    glMultiDrawElementsIndirectCountARB = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC)glfwGetProcAddress("glMultiDrawElementsIndirectCountARB");
+  indirectParameters = glMultiDrawElementsIndirectCountARB != nullptr;
+  std::cerr << "Indirect draw counts " << (indirectParameters ? "enabled" : "unavailable") << std::endl;
+}
+
+bool GLExtensions::has(const char *name)
+{
+  return _extensions.find(name) != _extensions.end();
+}
+
+} // namespace leo
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <set>
+#include <string>
+
+// Tokens and entry points of the extensions GLAD was not generated with
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_PARAMETER_BUFFER_ARB
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+#endif
+
+typedef void(APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+typedef GLuint64(APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void(APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void(APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+typedef void(APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC)(GLenum mode, GLenum type, const void *indirect, GLintptr drawcount,
+                                                                   GLsizei maxdrawcount, GLsizei stride);
+
+namespace leo
+{
+
+/* Optional extensions of the current context. Loaded once by OpenGLContext::init, after GLAD.
+   * Every flag is false and every entry point null when the extension is missing.
+   */
+class GLExtensions
+{
+public:
+  static void load();
+  static bool has(const char *name);
+
+public:
+  static bool parallelShaderCompile;
+  static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
+  static bool bindlessTexture;
+  static PFNGLGETTEXTUREHANDLEARBPROC glGetTextureHandleARB;
+  static PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glMakeTextureHandleResidentARB;
+  static PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glMakeTextureHandleNonResidentARB;
+  static bool indirectParameters;
+  static PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC glMultiDrawElementsIndirectCountARB;
+
+private:
+  static std::set<std::string> _extensions;
+};
+
+} // namespace leo
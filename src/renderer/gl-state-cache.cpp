@@ -0,0 +1,288 @@
+#include "gl-state-cache.hpp"
+
+namespace leo
+{
+
+std::shared_ptr<GLStateCache> GLStateCache::_instance = std::shared_ptr<GLStateCache>(nullptr);
+
+GLStateCache::GLStateCache()
+{
+  this->reset();
+}
+
+GLStateCache *GLStateCache::getInstance()
+{
+  if (!_instance)
+    _instance = std::shared_ptr<GLStateCache>(new GLStateCache());
+  return _instance.get();
+}
+
+void GLStateCache::reset()
+{
+  this->_program = UNKNOWN;
+  this->_vao = UNKNOWN;
+  this->_drawFramebuffer = UNKNOWN;
+  this->_readFramebuffer = UNKNOWN;
+  this->_activeUnit = UNKNOWN;
+  this->_textures.clear();
+  this->_capabilities.fill(-1);
+  this->_blendSrc = UNKNOWN;
+  this->_blendDst = UNKNOWN;
+  this->_depthFunc = UNKNOWN;
+  this->_cullFace = UNKNOWN;
+  this->_viewportKnown = false;
+  this->_clearColorKnown = false;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+  if (this->_issue(this->_program != program))
+  {
+    glUseProgram(program);
+    this->_program = program;
+  }
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+  if (this->_issue(this->_vao != vao))
+  {
+    glBindVertexArray(vao);
+    this->_vao = vao;
+  }
+}
+
+void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+  bool draw = target != GL_READ_FRAMEBUFFER;
+  bool read = target != GL_DRAW_FRAMEBUFFER;
+  bool changed = (draw && this->_drawFramebuffer != framebuffer) || (read && this->_readFramebuffer != framebuffer);
+  if (this->_issue(changed))
+  {
+    glBindFramebuffer(target, framebuffer);
+    if (draw)
+      this->_drawFramebuffer = framebuffer;
+    if (read)
+      this->_readFramebuffer = framebuffer;
+  }
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+  int targetIndex = _getTargetIndex(target);
+  if (targetIndex >= 0 && unit < this->_textures.size() && this->_textures[unit][targetIndex] == texture)
+  {
+    this->_issue(false);
+    return;
+  }
+  this->_activeTexture(unit);
+  this->bindTexture(target, texture);
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+  int targetIndex = _getTargetIndex(target);
+  GLuint unit = this->_activeUnit;
+  if (unit == UNKNOWN || targetIndex < 0)
+  {
+    this->_issue(true);
+    glBindTexture(target, texture);
+    return;
+  }
+  if (unit >= this->_textures.size())
+  {
+    std::array<GLuint, NB_TEXTURE_TARGETS> unknown;
+    unknown.fill(UNKNOWN);
+    this->_textures.resize(unit + 1, unknown);
+  }
+  if (this->_issue(this->_textures[unit][targetIndex] != texture))
+  {
+    glBindTexture(target, texture);
+    this->_textures[unit][targetIndex] = texture;
+  }
+}
+
+void GLStateCache::enable(GLenum capability)
+{
+  this->_setCapability(capability, true);
+}
+
+void GLStateCache::disable(GLenum capability)
+{
+  this->_setCapability(capability, false);
+}
+
+void GLStateCache::blendFunc(GLenum sfactor, GLenum dfactor)
+{
+  if (this->_issue(this->_blendSrc != sfactor || this->_blendDst != dfactor))
+  {
+    glBlendFunc(sfactor, dfactor);
+    this->_blendSrc = sfactor;
+    this->_blendDst = dfactor;
+  }
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+  if (this->_issue(this->_depthFunc != func))
+  {
+    glDepthFunc(func);
+    this->_depthFunc = func;
+  }
+}
+
+void GLStateCache::cullFace(GLenum mode)
+{
+  if (this->_issue(this->_cullFace != mode))
+  {
+    glCullFace(mode);
+    this->_cullFace = mode;
+  }
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  std::array<GLint, 4> value = {x, y, width, height};
+  if (this->_issue(!this->_viewportKnown || this->_viewport != value))
+  {
+    glViewport(x, y, width, height);
+    this->_viewport = value;
+    this->_viewportKnown = true;
+  }
+}
+
+void GLStateCache::clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+  std::array<GLfloat, 4> value = {r, g, b, a};
+  if (this->_issue(!this->_clearColorKnown || this->_clearColor != value))
+  {
+    glClearColor(r, g, b, a);
+    this->_clearColor = value;
+    this->_clearColorKnown = true;
+  }
+}
+
+void GLStateCache::forgetProgram(GLuint program)
+{
+  if (this->_program == program)
+    this->_program = UNKNOWN;
+}
+
+void GLStateCache::forgetVertexArray(GLuint vao)
+{
+  if (this->_vao == vao)
+    this->_vao = 0;
+}
+
+void GLStateCache::forgetFramebuffer(GLuint framebuffer)
+{
+  if (this->_drawFramebuffer == framebuffer)
+    this->_drawFramebuffer = 0;
+  if (this->_readFramebuffer == framebuffer)
+    this->_readFramebuffer = 0;
+}
+
+void GLStateCache::forgetTexture(GLuint texture)
+{
+  for (auto &unit : this->_textures)
+  {
+    for (GLuint &binding : unit)
+    {
+      if (binding == texture)
+        binding = 0;
+    }
+  }
+}
+
+void GLStateCache::endFrame()
+{
+  this->_lastFrame = this->_frame;
+  this->_frame = GLStateStats();
+}
+
+void GLStateCache::printReport(std::ostream &os) const
+{
+  unsigned long long total = this->_lastFrame.issued + this->_lastFrame.skipped;
+  os << "GL state changes last frame: " << this->_lastFrame.issued << " issued, " << this->_lastFrame.skipped << " skipped";
+  if (total)
+    os << " (" << (100 * this->_lastFrame.skipped / total) << "% redundant)";
+  os << std::endl;
+}
+
+void GLStateCache::_activeTexture(GLuint unit)
+{
+  if (this->_issue(this->_activeUnit != unit))
+  {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    this->_activeUnit = unit;
+  }
+}
+
+void GLStateCache::_setCapability(GLenum capability, bool enabled)
+{
+  int index = _getCapabilityIndex(capability);
+  if (index >= 0 && this->_capabilities[index] == (int)enabled)
+  {
+    this->_issue(false);
+    return;
+  }
+  this->_issue(true);
+  if (enabled)
+    glEnable(capability);
+  else
+    glDisable(capability);
+  if (index >= 0)
+    this->_capabilities[index] = (int)enabled;
+}
+
+bool GLStateCache::_issue(bool changed)
+{
+  GLStateStats &frame = this->_frame;
+  if (changed)
+  {
+    frame.issued++;
+    this->_total.issued++;
+  }
+  else
+  {
+    frame.skipped++;
+    this->_total.skipped++;
+  }
+  return changed;
+}
+
+int GLStateCache::_getTargetIndex(GLenum target)
+{
+  switch (target)
+  {
+  case GL_TEXTURE_2D:
+    return 0;
+  case GL_TEXTURE_2D_ARRAY:
+    return 1;
+  case GL_TEXTURE_CUBE_MAP:
+    return 2;
+  case GL_TEXTURE_2D_MULTISAMPLE:
+    return 3;
+  default:
+    return -1;
+  }
+}
+
+int GLStateCache::_getCapabilityIndex(GLenum capability)
+{
+  switch (capability)
+  {
+  case GL_DEPTH_TEST:
+    return 0;
+  case GL_BLEND:
+    return 1;
+  case GL_CULL_FACE:
+    return 2;
+  case GL_MULTISAMPLE:
+    return 3;
+  default:
+    return -1;
+  }
+}
+
+} // namespace leo
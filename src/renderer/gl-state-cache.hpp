@@ -0,0 +1,95 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace leo
+{
+
+typedef struct GLStateStats
+{
+  unsigned long long issued = 0;  // Calls forwarded to the driver
+  unsigned long long skipped = 0; // Calls dropped because the state was already set
+} GLStateStats;
+
+/* Shadow copy of the GL state the renderer changes, one per process like the single GL context it mirrors.
+   * It is reached through getInstance() or OpenGLContext::getState(), which resets it once the context is loaded.
+   * Every state change goes through it and is only forwarded to the driver when the value differs
+   * from the last one set. Objects deleted while bound must be forgotten, GL unbinds them itself.
+   * State changed behind its back (direct gl calls) makes the copy wrong until the next reset.
+   */
+class GLStateCache
+{
+public:
+  static GLStateCache *getInstance();
+
+public:
+  void reset();
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vao);
+  void bindFramebuffer(GLenum target, GLuint framebuffer);
+  void bindTexture(GLuint unit, GLenum target, GLuint texture);
+  void bindTexture(GLenum target, GLuint texture); // On the active unit, for texture creation
+  void enable(GLenum capability);
+  void disable(GLenum capability);
+  void blendFunc(GLenum sfactor, GLenum dfactor);
+  void depthFunc(GLenum func);
+  void cullFace(GLenum mode);
+  void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+  void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+  GLuint getProgram() const { return this->_program == UNKNOWN ? 0 : this->_program; }
+
+public:
+  void forgetProgram(GLuint program);
+  void forgetVertexArray(GLuint vao);
+  void forgetFramebuffer(GLuint framebuffer);
+  void forgetTexture(GLuint texture);
+
+public:
+  void endFrame();
+  const GLStateStats &getFrameStats() const { return this->_lastFrame; }
+  const GLStateStats &getTotalStats() const { return this->_total; }
+  void printReport(std::ostream &os) const;
+
+private:
+  GLStateCache();
+  void _activeTexture(GLuint unit);
+  void _setCapability(GLenum capability, bool enabled);
+  bool _issue(bool changed);
+  static int _getTargetIndex(GLenum target);
+  static int _getCapabilityIndex(GLenum capability);
+
+private:
+  static std::shared_ptr<GLStateCache> _instance;
+
+private:
+  static const GLuint UNKNOWN = 0xffffffff; // Forces the next call to be issued
+  static const int NB_TEXTURE_TARGETS = 4;
+  static const int NB_CAPABILITIES = 4;
+
+private:
+  GLuint _program = UNKNOWN;
+  GLuint _vao = UNKNOWN;
+  GLuint _drawFramebuffer = UNKNOWN;
+  GLuint _readFramebuffer = UNKNOWN;
+  GLuint _activeUnit = UNKNOWN;
+  std::vector<std::array<GLuint, NB_TEXTURE_TARGETS>> _textures; // Per unit
+  std::array<int, NB_CAPABILITIES> _capabilities;                // -1 unknown, 0 disabled, 1 enabled
+  GLenum _blendSrc = UNKNOWN;
+  GLenum _blendDst = UNKNOWN;
+  GLenum _depthFunc = UNKNOWN;
+  GLenum _cullFace = UNKNOWN;
+  std::array<GLint, 4> _viewport;
+  std::array<GLfloat, 4> _clearColor;
+  bool _viewportKnown = false;
+  bool _clearColorKnown = false;
+  GLStateStats _frame;
+  GLStateStats _lastFrame;
+  GLStateStats _total;
+};
+
+} // namespace leo
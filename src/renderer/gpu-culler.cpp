@@ -0,0 +1,239 @@
+#include "gpu-culler.hpp"
+
+#include <renderer/gpu-memory-tracker.hpp>
+#include <renderer/multi-draw-buffer.hpp>
+#include <renderer/opengl-context.hpp>
+#include <renderer/program-cache.hpp>
+
+#include <utils/file-reader.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+namespace leo
+{
+
+namespace
+{
+
+const char *cullUniformNames[] = {"nbDraws", "outputBase", "countBase", "viewProjection", "occlusion", "hiZViewProjection", "hiZLevels"};
+enum CullUniform
+{
+    NB_DRAWS,
+    OUTPUT_BASE,
+    COUNT_BASE,
+    VIEW_PROJECTION,
+    OCCLUSION,
+    HIZ_VIEW_PROJECTION,
+    HIZ_LEVELS
+};
+
+} // namespace
+
+GPUCuller::GPUCuller()
+{
+}
+
+GPUCuller::~GPUCuller()
+{
+    this->_deletePyramid();
+    GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_commandBuffer);
+    GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_countBuffer);
+    glDeleteBuffers(1, &this->_commandBuffer);
+    glDeleteBuffers(1, &this->_countBuffer);
+    glDeleteBuffers(NB_FRAMES, this->_statsBuffers);
+}
+
+void GPUCuller::beginFrame()
+{
+    this->_commandsUsed = 0;
+    this->_countsUsed = 0;
+    this->_frame++;
+    if (!this->_initialized || !this->_cullProgram)
+        return;
+
+    // Written NB_FRAMES frames ago, the frame ring buffer already waited for that frame to end
+    unsigned int slot = this->_frame % NB_FRAMES;
+    this->_stats = GPUCullStats();
+    if (this->_statsWritten[slot])
+        glGetNamedBufferSubData(this->_statsBuffers[slot], 0, sizeof(GPUCullStats), &this->_stats);
+    glClearNamedBufferData(this->_statsBuffers[slot], GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    this->_statsWritten[slot] = false;
+}
+
+void GPUCuller::captureDepth(GLuint framebuffer, int width, int height, const glm::mat4 &viewProjection)
+{
+    if (!this->_enabled || !this->_init())
+        return;
+    if (width != this->_width || height != this->_height)
+        this->_createPyramid(width, height);
+
+    glBlitNamedFramebuffer(framebuffer, this->_depthFramebuffer, 0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    // Each level is reduced from the one above it, the first one from the depth copy
+    GLStateCache &state = *GLStateCache::getInstance();
+    GLuint program = state.getProgram();
+    state.useProgram(this->_buildProgram);
+    int levelWidth = std::max(1, width / 2);
+    int levelHeight = std::max(1, height / 2);
+    for (int level = 0; level < this->_nbLevels; ++level)
+    {
+        state.bindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, level ? this->_hiZ : this->_depthTexture);
+        glProgramUniform1i(this->_buildProgram, this->_buildUniforms[1], std::max(level - 1, 0));
+        glBindImageTexture(0, this->_hiZ, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+    state.useProgram(program);
+    this->_hiZViewProjection = viewProjection;
+    this->_hasPyramid = true;
+}
+
+GPUCullResult GPUCuller::cull(OpenGLContext &context, const FrameAllocation &commands, const std::vector<CullData> &data,
+                              size_t nbSegments, const glm::mat4 &viewProjection, bool occlusion)
+{
+    GPUCullResult result;
+    if (!this->_enabled || data.empty() || !commands.buffer || !this->_init())
+        return result;
+    FrameAllocation cullData = context.getFrameData().upload(data.data(), data.size() * sizeof(CullData));
+    if (!cullData.buffer)
+        return result; // The ring buffer is full, the draws are not culled
+
+    size_t nbDraws = data.size();
+    result.commandOffset = this->_reserve(this->_commandBuffer, this->_commandCapacity, this->_commandsUsed,
+                                          nbDraws * sizeof(DrawElementsIndirectCommand), "culled indirect commands");
+    result.countOffset = this->_reserve(this->_countBuffer, this->_countCapacity, this->_countsUsed, nbSegments * sizeof(GLuint),
+                                        "culled draw counts");
+    result.commandBuffer = this->_commandBuffer;
+    result.countBuffer = this->_countBuffer;
+
+    // Without a pyramid yet, only the frustum is tested
+    occlusion = occlusion && this->_hasPyramid;
+    GLuint program = context.getState().getProgram();
+    context.getState().useProgram(this->_cullProgram);
+    glProgramUniform1ui(this->_cullProgram, this->_uniforms[NB_DRAWS], (GLuint)nbDraws);
+    glProgramUniform1ui(this->_cullProgram, this->_uniforms[OUTPUT_BASE], (GLuint)(result.commandOffset / sizeof(DrawElementsIndirectCommand)));
+    glProgramUniform1ui(this->_cullProgram, this->_uniforms[COUNT_BASE], (GLuint)(result.countOffset / sizeof(GLuint)));
+    glProgramUniformMatrix4fv(this->_cullProgram, this->_uniforms[VIEW_PROJECTION], 1, GL_FALSE, &viewProjection[0][0]);
+    glProgramUniform1i(this->_cullProgram, this->_uniforms[OCCLUSION], occlusion);
+    if (occlusion)
+    {
+        glProgramUniformMatrix4fv(this->_cullProgram, this->_uniforms[HIZ_VIEW_PROJECTION], 1, GL_FALSE, &this->_hiZViewProjection[0][0]);
+        glProgramUniform1i(this->_cullProgram, this->_uniforms[HIZ_LEVELS], this->_nbLevels);
+        context.getState().bindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, this->_hiZ);
+    }
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, commands.buffer, commands.offset, commands.size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CULL_DATA_BINDING, cullData.buffer, cullData.offset, cullData.size);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OUTPUT_BINDING, this->_commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTS_BINDING, this->_countBuffer);
+    unsigned int slot = this->_frame % NB_FRAMES;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STATS_BINDING, this->_statsBuffers[slot]);
+    glDispatchCompute((GLuint)((nbDraws + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    // The caller draws right after, with the program it had bound
+    context.getState().useProgram(program);
+    this->_statsWritten[slot] = true;
+    return result;
+}
+
+bool GPUCuller::_init()
+{
+    if (this->_initialized)
+        return this->_cullProgram && this->_buildProgram;
+    this->_initialized = true;
+
+    ProgramCache &programs = *ProgramCache::getInstance();
+    this->_cullProgram = programs.getComputeProgram(FileReader::readFile("resources/shaders/gpu-cull.comp.glsl"));
+    this->_buildProgram = programs.getComputeProgram(FileReader::readFile("resources/shaders/hiz-build.comp.glsl"));
+    if (!this->_cullProgram || !this->_buildProgram)
+    {
+        std::cerr << "GPUCuller: Cannot build the culling programs, draws will not be culled on the GPU" << std::endl;
+        this->_cullProgram = 0;
+        return false;
+    }
+    for (int i = 0; i < 7; ++i)
+        this->_uniforms[i] = glGetUniformLocation(this->_cullProgram, cullUniformNames[i]);
+    glProgramUniform1i(this->_cullProgram, glGetUniformLocation(this->_cullProgram, "hiZ"), HIZ_TEXTURE_UNIT);
+    this->_buildUniforms[0] = glGetUniformLocation(this->_buildProgram, "source");
+    this->_buildUniforms[1] = glGetUniformLocation(this->_buildProgram, "sourceLevel");
+    glProgramUniform1i(this->_buildProgram, this->_buildUniforms[0], HIZ_TEXTURE_UNIT);
+
+    glCreateBuffers(NB_FRAMES, this->_statsBuffers);
+    for (GLuint buffer : this->_statsBuffers)
+    {
+        glNamedBufferStorage(buffer, sizeof(GPUCullStats), nullptr, 0);
+        glClearNamedBufferData(buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+    return true;
+}
+
+void GPUCuller::_createPyramid(int width, int height)
+{
+    this->_deletePyramid();
+    this->_width = width;
+    this->_height = height;
+
+    // Same format as the depth renderbuffers, blits between depth buffers need it
+    glCreateTextures(GL_TEXTURE_2D, 1, &this->_depthTexture);
+    glTextureStorage2D(this->_depthTexture, 1, GL_DEPTH24_STENCIL8, width, height);
+    glTextureParameteri(this->_depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(this->_depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glCreateFramebuffers(1, &this->_depthFramebuffer);
+    glNamedFramebufferTexture(this->_depthFramebuffer, GL_DEPTH_ATTACHMENT, this->_depthTexture, 0);
+    if (glCheckNamedFramebufferStatus(this->_depthFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "GPUCuller: Incomplete depth copy framebuffer" << std::endl;
+    GPUMemoryTracker::getInstance()->track(GL_TEXTURE, this->_depthTexture, GPUMemoryCategory::RENDER_TARGETS,
+                                           (size_t)width * height * 4, "hierarchical Z depth copy");
+
+    int baseWidth = std::max(1, width / 2);
+    int baseHeight = std::max(1, height / 2);
+    this->_nbLevels = 1;
+    while ((baseWidth >> this->_nbLevels) || (baseHeight >> this->_nbLevels))
+        this->_nbLevels++;
+    glCreateTextures(GL_TEXTURE_2D, 1, &this->_hiZ);
+    glTextureStorage2D(this->_hiZ, this->_nbLevels, GL_R32F, baseWidth, baseHeight);
+    glTextureParameteri(this->_hiZ, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(this->_hiZ, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(this->_hiZ, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(this->_hiZ, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GPUMemoryTracker::getInstance()->track(GL_TEXTURE, this->_hiZ, GPUMemoryCategory::RENDER_TARGETS,
+                                           (size_t)baseWidth * baseHeight * 4 * 4 / 3, "hierarchical Z pyramid");
+}
+
+void GPUCuller::_deletePyramid()
+{
+    GPUMemoryTracker::getInstance()->untrack(GL_TEXTURE, this->_depthTexture);
+    GPUMemoryTracker::getInstance()->untrack(GL_TEXTURE, this->_hiZ);
+    glDeleteFramebuffers(1, &this->_depthFramebuffer);
+    glDeleteTextures(1, &this->_depthTexture);
+    glDeleteTextures(1, &this->_hiZ);
+    this->_depthFramebuffer = 0;
+    this->_depthTexture = 0;
+    this->_hiZ = 0;
+    this->_hasPyramid = false;
+}
+
+GLintptr GPUCuller::_reserve(GLuint &buffer, size_t &capacity, size_t &used, size_t size, const char *label)
+{
+    if (used + size > capacity)
+    {
+        // The GL keeps the old buffer alive until the draws already submitted are done with it
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, buffer);
+        glDeleteBuffers(1, &buffer);
+        capacity = std::max(2 * capacity, size);
+        used = 0;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, capacity, nullptr, 0);
+        GPUMemoryTracker::getInstance()->track(GL_BUFFER, buffer, GPUMemoryCategory::UNIFORM_BUFFERS, capacity, label);
+    }
+    GLintptr offset = (GLintptr)used;
+    used += size;
+
+    // Zeroed commands draw nothing, and the counts start from zero
+    glClearNamedBufferSubData(buffer, GL_R32UI, offset, size, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    return offset;
+}
+
+} // namespace leo
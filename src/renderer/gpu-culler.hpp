@@ -0,0 +1,111 @@
+#pragma once
+
+#include <renderer/global.hpp>
+#include <renderer/frame-ring-buffer.hpp>
+
+#include <vector>
+
+namespace leo
+{
+
+class OpenGLContext;
+
+typedef struct CullData
+{
+  glm::vec3 boundsMin; // World space
+  GLuint segment = 0;
+  glm::vec3 boundsMax;
+  GLuint segmentStart = 0; // Index of the segment's first command
+} CullData;
+
+typedef struct GPUCullStats
+{
+  GLuint tested = 0;
+  GLuint visible = 0;
+  GLuint frustumCulled = 0;
+  GLuint occluded = 0;
+} GPUCullStats;
+
+typedef struct GPUCullResult
+{
+  GLuint commandBuffer = 0; // Null when the draws were not culled
+  GLintptr commandOffset = 0;
+  GLuint countBuffer = 0;
+  GLintptr countOffset = 0; // Of the first segment's count
+} GPUCullResult;
+
+/* Compute shader culling of the MultiDrawBuffer commands, the alternative to the CPU occlusion buffer.
+   * captureDepth copies the depth of a pass and reduces it to a pyramid of farthest depths (hierarchical Z).
+   * cull then tests the bounds of every draw against a frustum and, for camera passes, against the pyramid
+   * of the last captured frame, and appends the visible commands at the front of their segment in a buffer
+   * of its own, counting them per segment. Unused slots stay zeroed so they draw nothing when the counts
+   * cannot be read by the multi-draw. A result is only valid until the next call to cull, the output buffers
+   * may be replaced when they grow. Statistics are read back NB_FRAMES frames later, without stalling.
+   * Both calls bind their compute program and bind the caller's program again before returning.
+   */
+class GPUCuller
+{
+public:
+  GPUCuller();
+  ~GPUCuller();
+  GPUCuller(const GPUCuller &other) = delete;
+  GPUCuller &operator=(const GPUCuller &other) = delete;
+
+public:
+  void setEnabled(bool enabled) { this->_enabled = enabled; }
+  bool isEnabled() const { return this->_enabled; }
+  void beginFrame();
+  void captureDepth(GLuint framebuffer, int width, int height, const glm::mat4 &viewProjection);
+  GPUCullResult cull(OpenGLContext &context, const FrameAllocation &commands, const std::vector<CullData> &data,
+                     size_t nbSegments, const glm::mat4 &viewProjection, bool occlusion);
+  const GPUCullStats &getStats() const { return this->_stats; } // Of NB_FRAMES frames ago
+
+public:
+  static const unsigned int NB_FRAMES = FrameRingBuffer::NB_FRAMES;
+  static const GLuint COMMANDS_BINDING = 2; // Draws and materials keep bindings 0 and 1
+  static const GLuint CULL_DATA_BINDING = 3;
+  static const GLuint OUTPUT_BINDING = 4;
+  static const GLuint COUNTS_BINDING = 5;
+  static const GLuint STATS_BINDING = 6;
+  static const GLuint HIZ_TEXTURE_UNIT = 15;
+  static const GLuint WORKGROUP_SIZE = 64;
+
+private:
+  bool _init();
+  void _createPyramid(int width, int height);
+  void _deletePyramid();
+  GLintptr _reserve(GLuint &buffer, size_t &capacity, size_t &used, size_t size, const char *label);
+
+private:
+  bool _enabled = false;
+  bool _initialized = false;
+  GLuint _cullProgram = 0;
+  GLuint _buildProgram = 0;
+  GLint _uniforms[7] = {};      // Of the cull program, in the order of the shader
+  GLint _buildUniforms[2] = {}; // source, sourceLevel
+
+  // Depth copy and pyramid, the pyramid's first level has half the size of the depth
+  GLuint _depthFramebuffer = 0;
+  GLuint _depthTexture = 0;
+  GLuint _hiZ = 0;
+  int _width = 0;
+  int _height = 0;
+  int _nbLevels = 0;
+  glm::mat4 _hiZViewProjection;
+  bool _hasPyramid = false;
+
+  // Outputs, sub-allocated from the start every frame: the GL orders the writes after the draws reading them
+  GLuint _commandBuffer = 0;
+  size_t _commandCapacity = 0; // In bytes
+  size_t _commandsUsed = 0;
+  GLuint _countBuffer = 0;
+  size_t _countCapacity = 0;
+  size_t _countsUsed = 0;
+
+  GLuint _statsBuffers[NB_FRAMES] = {};
+  bool _statsWritten[NB_FRAMES] = {};
+  unsigned long long _frame = 0;
+  GPUCullStats _stats;
+};
+
+} // namespace leo
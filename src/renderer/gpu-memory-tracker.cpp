@@ -0,0 +1,137 @@
+#include "gpu-memory-tracker.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace leo
+{
+
+namespace
+{
+
+const char *categoryNames[NB_GPU_MEMORY_CATEGORIES] = {"material textures", "render targets", "shadow maps",
+                                                       "vertex buffers", "index buffers", "uniform buffers"};
+
+double toMiB(size_t size)
+{
+  return size / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+std::shared_ptr<GPUMemoryTracker> GPUMemoryTracker::_instance = std::shared_ptr<GPUMemoryTracker>(nullptr);
+
+GPUMemoryTracker::GPUMemoryTracker()
+{
+}
+
+GPUMemoryTracker *GPUMemoryTracker::getInstance()
+{
+  if (!_instance)
+    _instance = std::shared_ptr<GPUMemoryTracker>(new GPUMemoryTracker());
+  return _instance.get();
+}
+
+void GPUMemoryTracker::track(GLenum objectType, GLuint name, GPUMemoryCategory category, size_t size, const std::string &label)
+{
+  if (!name)
+    return;
+  GPUAllocation &allocation = this->_allocations[t_key(objectType, name)];
+  this->_usage[allocation.category] -= allocation.size;
+  allocation.category = category;
+  allocation.size = size;
+  allocation.label = label;
+  this->_usage[category] += size;
+}
+
+void GPUMemoryTracker::untrack(GLenum objectType, GLuint name)
+{
+  auto it = this->_allocations.find(t_key(objectType, name));
+  if (it == this->_allocations.end())
+    return;
+  this->_usage[it->second.category] -= it->second.size;
+  this->_allocations.erase(it);
+}
+
+const GPUAllocation *GPUMemoryTracker::getAllocation(GLenum objectType, GLuint name) const
+{
+  auto it = this->_allocations.find(t_key(objectType, name));
+  return it == this->_allocations.end() ? nullptr : &it->second;
+}
+
+size_t GPUMemoryTracker::getUsage(GPUMemoryCategory category) const
+{
+  return this->_usage[category];
+}
+
+size_t GPUMemoryTracker::getUsage() const
+{
+  size_t usage = 0;
+  for (size_t u : this->_usage)
+    usage += u;
+  return usage;
+}
+
+void GPUMemoryTracker::printReport(std::ostream &os, unsigned int nbConsumers) const
+{
+  std::ios::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision(2);
+  os << "GPU memory: " << toMiB(this->getUsage()) << " MiB in " << this->_allocations.size() << " allocations" << std::endl;
+  for (int i = 0; i < NB_GPU_MEMORY_CATEGORIES; ++i)
+    os << "  " << categoryNames[i] << ": " << toMiB(this->_usage[i]) << " MiB" << std::endl;
+
+  std::vector<const GPUAllocation *> consumers = this->_getBiggestConsumers(nbConsumers);
+  os << "  Biggest consumers:" << std::endl;
+  for (size_t i = 0; i < consumers.size(); ++i)
+    os << "    " << consumers[i]->label << " (" << categoryNames[consumers[i]->category] << "): " << toMiB(consumers[i]->size) << " MiB" << std::endl;
+  os.flags(flags);
+}
+
+void GPUMemoryTracker::printSummary(std::ostream &os, unsigned int nbConsumers) const
+{
+  std::ios::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision(1);
+  os << "GPU memory: " << toMiB(this->getUsage()) << " MiB (";
+  for (int i = 0; i < NB_GPU_MEMORY_CATEGORIES; ++i)
+    os << (i ? ", " : "") << categoryNames[i] << " " << toMiB(this->_usage[i]);
+
+  std::vector<const GPUAllocation *> consumers = this->_getBiggestConsumers(nbConsumers);
+  os << "), biggest:";
+  for (size_t i = 0; i < consumers.size(); ++i)
+    os << (i ? ", " : " ") << consumers[i]->label << " " << toMiB(consumers[i]->size);
+  os << std::endl;
+  os.flags(flags);
+}
+
+void GPUMemoryTracker::endFrame()
+{
+  this->_frame++;
+  if (this->_logInterval && this->_frame % this->_logInterval == 0)
+    this->printSummary(std::cout);
+}
+
+void GPUMemoryTracker::setLogInterval(unsigned int nbFrames)
+{
+  this->_logInterval = nbFrames;
+}
+
+std::vector<const GPUAllocation *> GPUMemoryTracker::_getBiggestConsumers(unsigned int nbConsumers) const
+{
+  std::vector<const GPUAllocation *> consumers;
+  for (const auto &p : this->_allocations)
+    consumers.push_back(&p.second);
+  size_t nb = std::min<size_t>(nbConsumers, consumers.size());
+  std::partial_sort(consumers.begin(), consumers.begin() + nb, consumers.end(),
+                    [](const GPUAllocation *a, const GPUAllocation *b) { return a->size > b->size; });
+  consumers.resize(nb);
+  return consumers;
+}
+
+const char *GPUMemoryTracker::getCategoryName(GPUMemoryCategory category)
+{
+  return categoryNames[category];
+}
+
+} // namespace leo
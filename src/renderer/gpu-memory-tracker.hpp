@@ -0,0 +1,73 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace leo
+{
+
+enum GPUMemoryCategory
+{
+  MATERIAL_TEXTURES,
+  RENDER_TARGETS,
+  SHADOW_MAPS,
+  VERTEX_BUFFERS,
+  INDEX_BUFFERS,
+  UNIFORM_BUFFERS,
+  NB_GPU_MEMORY_CATEGORIES
+};
+
+typedef struct GPUAllocation
+{
+  GPUMemoryCategory category = GPUMemoryCategory::MATERIAL_TEXTURES;
+  size_t size = 0;
+  std::string label;
+} GPUAllocation;
+
+/* Accounts for the video memory allocated by the engine.
+   * Allocations are identified by the GL object type (GL_TEXTURE, GL_BUFFER, GL_RENDERBUFFER) and name,
+   * tracking an object again only updates its category, size and label.
+   */
+class GPUMemoryTracker
+{
+
+  using t_key = std::pair<GLenum, GLuint>;
+
+public:
+  static GPUMemoryTracker *getInstance();
+
+public:
+  void track(GLenum objectType, GLuint name, GPUMemoryCategory category, size_t size, const std::string &label);
+  void untrack(GLenum objectType, GLuint name);
+  const GPUAllocation *getAllocation(GLenum objectType, GLuint name) const;
+  size_t getUsage(GPUMemoryCategory category) const;
+  size_t getUsage() const;
+  void printReport(std::ostream &os, unsigned int nbConsumers = 10) const;
+  void printSummary(std::ostream &os, unsigned int nbConsumers = 3) const;
+  void endFrame();
+  void setLogInterval(unsigned int nbFrames);
+
+public:
+  static const char *getCategoryName(GPUMemoryCategory category);
+
+private:
+  GPUMemoryTracker();
+  std::vector<const GPUAllocation *> _getBiggestConsumers(unsigned int nbConsumers) const;
+
+private:
+  static std::shared_ptr<GPUMemoryTracker> _instance;
+
+private:
+  std::map<t_key, GPUAllocation> _allocations;
+  size_t _usage[NB_GPU_MEMORY_CATEGORIES] = {0};
+  unsigned int _logInterval = 600; // In frames, 0 disables the periodic log
+  unsigned long long _frame = 0;
+};
+
+} // namespace leo
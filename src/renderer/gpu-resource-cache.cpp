@@ -0,0 +1,270 @@
+#include <renderer/gpu-resource-cache.hpp>
+
+#include <renderer/gpu-memory-tracker.hpp>
+#include <renderer/opengl-context.hpp>
+
+#include <model/components/volume.hpp>
+#include <model/texture-array.hpp>
+
+#include <utils/texture.hpp>
+
+#include <algorithm>
+
+namespace leo
+{
+
+namespace
+{
+
+const char *categoryNames[NB_GPU_RESOURCE_CATEGORIES] = {"material textures", "cube maps", "texture arrays", "geometry", "instanced geometry"};
+
+size_t getBufferCollectionSize(const Volume &volume)
+{
+    return volume.getVertices().size() * sizeof(Vertex) + volume.getIndices().size() * sizeof(GLuint);
+}
+
+} // namespace
+
+GPUResourceCache::GPUResourceCache(OpenGLContext &context) : _context(context)
+{
+}
+
+GPUResourceCache::~GPUResourceCache()
+{
+    // The GL context may already be gone at this point, leave the objects to the driver
+    for (FrameFence &fence : this->_frameFences)
+        glDeleteSync(fence.sync);
+}
+
+const TextureWrapper &GPUResourceCache::acquireTexture(const Texture &texture, t_id owner, GLTextureOptions glOptions, TextureOptions textureOptions)
+{
+    GPUResource *resource = this->_find(GPUResourceCategory::MATERIAL_TEXTURE, texture.getId());
+    if (!resource)
+    {
+        resource = &this->_insert(GPUResourceCategory::MATERIAL_TEXTURE, texture.getId());
+        resource->texture = std::unique_ptr<TextureWrapper>(new TextureWrapper(texture, glOptions, textureOptions));
+        resource->size = resource->texture->getMemorySize();
+    }
+    resource->owners.insert(owner);
+    return *resource->texture;
+}
+
+const TextureWrapper &GPUResourceCache::acquireCubeMap(const std::vector<std::shared_ptr<Texture>> &textures, t_id owner, GLTextureOptions glOptions, TextureOptions textureOptions)
+{
+    // Cube maps are identified by their first face
+    GPUResource *resource = this->_find(GPUResourceCategory::CUBE_MAP_TEXTURE, textures[0]->getId());
+    if (!resource)
+    {
+        resource = &this->_insert(GPUResourceCategory::CUBE_MAP_TEXTURE, textures[0]->getId());
+        resource->texture = std::unique_ptr<TextureWrapper>(new TextureWrapper(textures, glOptions, textureOptions));
+        resource->size = resource->texture->getMemorySize();
+    }
+    resource->owners.insert(owner);
+    return *resource->texture;
+}
+
+const TextureWrapper &GPUResourceCache::acquireTextureArray(const TextureArray &textureArray, t_id owner, GLTextureOptions glOptions)
+{
+    GPUResource *resource = this->_find(GPUResourceCategory::TEXTURE_ARRAY, textureArray.getId());
+    if (!resource)
+    {
+        resource = &this->_insert(GPUResourceCategory::TEXTURE_ARRAY, textureArray.getId());
+        resource->texture = std::unique_ptr<TextureWrapper>(new TextureWrapper(textureArray, glOptions));
+        resource->size = resource->texture->getMemorySize();
+    }
+    resource->owners.insert(owner);
+    return *resource->texture;
+}
+
+const BufferCollection &GPUResourceCache::acquireBufferCollection(const Volume &volume, t_id owner)
+{
+    GPUResource *resource = this->_find(GPUResourceCategory::GEOMETRY, volume.getId());
+    if (!resource)
+    {
+        resource = &this->_insert(GPUResourceCategory::GEOMETRY, volume.getId());
+        this->_context.generateBufferCollection(resource->bufferCollection, volume);
+        resource->size = getBufferCollectionSize(volume);
+    }
+    resource->owners.insert(owner);
+    return resource->bufferCollection;
+}
+
+const BufferCollection &GPUResourceCache::acquireInstancedBufferCollection(const Volume &volume, GLuint transformationsVBO, t_id owner)
+{
+    // Instancing attributes replace some of the regular ones, so instanced volumes get their own VAO
+    GPUResource *resource = this->_find(GPUResourceCategory::INSTANCED_GEOMETRY, volume.getId());
+    if (!resource)
+    {
+        resource = &this->_insert(GPUResourceCategory::INSTANCED_GEOMETRY, volume.getId());
+        this->_context.generateBufferCollectionInstanced(resource->bufferCollection, volume, transformationsVBO);
+        resource->size = getBufferCollectionSize(volume);
+    }
+    resource->owners.insert(owner);
+    return resource->bufferCollection;
+}
+
+const TextureWrapper *GPUResourceCache::findTexture(GPUResourceCategory category, t_id sourceId)
+{
+    GPUResource *resource = this->_find(category, sourceId);
+    return resource ? resource->texture.get() : nullptr;
+}
+
+const BufferCollection *GPUResourceCache::findBufferCollection(GPUResourceCategory category, t_id sourceId)
+{
+    GPUResource *resource = this->_find(category, sourceId);
+    return resource ? &resource->bufferCollection : nullptr;
+}
+
+void GPUResourceCache::release(t_id owner)
+{
+    // Unreferenced resources are kept until the budget forces an eviction
+    for (auto &p : this->_resources)
+        p.second.owners.erase(owner);
+}
+
+void GPUResourceCache::beginFrame()
+{
+    this->_collectGarbage();
+}
+
+void GPUResourceCache::endFrame()
+{
+    // Resources of the frame are protected until it is submitted
+    this->_evict();
+    this->release(FRAME_OWNER);
+    this->_frameFences.push_back({this->_frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+    this->_frame++;
+}
+
+void GPUResourceCache::setBudget(size_t bytes)
+{
+    this->_budget = bytes;
+}
+
+size_t GPUResourceCache::getMemoryUsage(GPUResourceCategory category) const
+{
+    size_t size = 0;
+    for (const auto &p : this->_resources)
+        if (p.first.first == category)
+            size += p.second.size;
+    return size;
+}
+
+size_t GPUResourceCache::getMemoryUsage() const
+{
+    size_t size = 0;
+    for (const auto &p : this->_resources)
+        size += p.second.size;
+    return size;
+}
+
+void GPUResourceCache::printReport(std::ostream &os) const
+{
+    size_t sizes[NB_GPU_RESOURCE_CATEGORIES] = {0};
+    size_t unreferencedSizes[NB_GPU_RESOURCE_CATEGORIES] = {0};
+    unsigned int counts[NB_GPU_RESOURCE_CATEGORIES] = {0};
+    for (const auto &p : this->_resources)
+    {
+        sizes[p.first.first] += p.second.size;
+        counts[p.first.first]++;
+        if (p.second.owners.empty())
+            unreferencedSizes[p.first.first] += p.second.size;
+    }
+    size_t pendingSize = 0;
+    for (const PendingDeletion &pending : this->_pendingDeletions)
+        pendingSize += pending.resource.size;
+
+    os << "GPUResourceCache: " << this->getMemoryUsage() / 1024 << " KiB resident, budget "
+       << this->_budget / 1024 << " KiB, " << pendingSize / 1024 << " KiB pending deletion" << std::endl;
+    for (int i = 0; i < NB_GPU_RESOURCE_CATEGORIES; ++i)
+    {
+        os << "  " << categoryNames[i] << ": " << counts[i] << " resources, " << sizes[i] / 1024 << " KiB ("
+           << unreferencedSizes[i] / 1024 << " KiB unreferenced)" << std::endl;
+    }
+}
+
+GPUResource *GPUResourceCache::_find(GPUResourceCategory category, t_id sourceId)
+{
+    auto it = this->_resources.find(t_key(category, sourceId));
+    if (it == this->_resources.end())
+        return nullptr;
+    it->second.lastUsedFrame = this->_frame;
+    return &it->second;
+}
+
+GPUResource &GPUResourceCache::_insert(GPUResourceCategory category, t_id sourceId)
+{
+    GPUResource &resource = this->_resources[t_key(category, sourceId)];
+    resource.category = category;
+    resource.lastUsedFrame = this->_frame;
+    return resource;
+}
+
+void GPUResourceCache::_evict()
+{
+    size_t usage = this->getMemoryUsage();
+    if (usage <= this->_budget)
+        return;
+
+    std::vector<std::map<t_key, GPUResource>::iterator> candidates;
+    for (auto it = this->_resources.begin(); it != this->_resources.end(); ++it)
+        if (it->second.owners.empty())
+            candidates.push_back(it);
+    std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+        return a->second.lastUsedFrame < b->second.lastUsedFrame;
+    });
+
+    for (auto it : candidates)
+    {
+        if (usage <= this->_budget)
+            break;
+        usage -= it->second.size;
+        // The resource may still be referenced by commands of this frame
+        this->_pendingDeletions.push_back({this->_frame, std::move(it->second)});
+        this->_resources.erase(it);
+    }
+}
+
+void GPUResourceCache::_destroy(GPUResource &resource)
+{
+    if (resource.texture)
+    {
+        resource.texture->destroy();
+    }
+    else
+    {
+        BufferCollection &bc = resource.bufferCollection;
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, bc.VBO);
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, bc.EBO);
+        this->_context.getState().forgetVertexArray(bc.VAO);
+        glDeleteVertexArrays(1, &bc.VAO);
+        glDeleteBuffers(1, &bc.VBO);
+        glDeleteBuffers(1, &bc.EBO);
+        bc = BufferCollection();
+    }
+}
+
+void GPUResourceCache::_collectGarbage()
+{
+    // Poll without blocking for the frames the GPU is done with
+    while (!this->_frameFences.empty())
+    {
+        FrameFence &fence = this->_frameFences.front();
+        GLenum status = glClientWaitSync(fence.sync, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        this->_completedFrame = fence.frame;
+        glDeleteSync(fence.sync);
+        this->_frameFences.pop_front();
+    }
+
+    auto it = std::remove_if(this->_pendingDeletions.begin(), this->_pendingDeletions.end(), [this](PendingDeletion &pending) {
+        if (pending.frame > this->_completedFrame)
+            return false;
+        this->_destroy(pending.resource);
+        return true;
+    });
+    this->_pendingDeletions.erase(it, this->_pendingDeletions.end());
+}
+
+} // namespace leo
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <renderer/buffer-collection.hpp>
+#include <renderer/texture-wrapper.hpp>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace leo
+{
+
+class OpenGLContext;
+class Texture;
+class TextureArray;
+class Volume;
+
+enum GPUResourceCategory
+{
+  MATERIAL_TEXTURE,
+  CUBE_MAP_TEXTURE,
+  TEXTURE_ARRAY,
+  GEOMETRY,
+  INSTANCED_GEOMETRY,
+  NB_GPU_RESOURCE_CATEGORIES
+};
+
+typedef struct GPUResource
+{
+  GPUResourceCategory category;
+  std::unique_ptr<TextureWrapper> texture;
+  BufferCollection bufferCollection;
+  size_t size = 0;
+  std::set<unsigned int> owners; // Ids of the registered components using the resource
+  unsigned long long lastUsedFrame = 0;
+} GPUResource;
+
+/* Owns every GPU object created from a scene object (textures, cube maps, vertex/index buffers).
+   * Resources are keyed by category and source object id and referenced by the components that use them.
+   * Unreferenced resources stay resident until the budget is exceeded, then the least recently used
+   * ones are evicted. GL objects are only deleted once the frames that may still use them are done.
+   * Every resource used to draw a frame is also held by FRAME_OWNER, so that none is evicted before endFrame.
+   */
+class GPUResourceCache
+{
+
+  using t_id = unsigned int;
+  using t_key = std::pair<GPUResourceCategory, t_id>;
+
+public:
+  static const t_id FRAME_OWNER = (t_id)-1; // Resources acquired while drawing, released at the end of the frame
+
+public:
+  GPUResourceCache(OpenGLContext &context);
+  ~GPUResourceCache();
+  GPUResourceCache(const GPUResourceCache &other) = delete;
+  GPUResourceCache &operator=(const GPUResourceCache &other) = delete;
+
+public:
+  const TextureWrapper &acquireTexture(const Texture &texture, t_id owner, GLTextureOptions glOptions, TextureOptions textureOptions = {});
+  const TextureWrapper &acquireCubeMap(const std::vector<std::shared_ptr<Texture>> &textures, t_id owner, GLTextureOptions glOptions, TextureOptions textureOptions = {});
+  const TextureWrapper &acquireTextureArray(const TextureArray &textureArray, t_id owner, GLTextureOptions glOptions);
+  const BufferCollection &acquireBufferCollection(const Volume &volume, t_id owner);
+  const BufferCollection &acquireInstancedBufferCollection(const Volume &volume, GLuint transformationsVBO, t_id owner);
+  const TextureWrapper *findTexture(GPUResourceCategory category, t_id sourceId);
+  const BufferCollection *findBufferCollection(GPUResourceCategory category, t_id sourceId);
+  void release(t_id owner);
+
+public:
+  void beginFrame();
+  void endFrame();
+  void setBudget(size_t bytes);
+  size_t getBudget() const { return this->_budget; }
+  size_t getMemoryUsage(GPUResourceCategory category) const;
+  size_t getMemoryUsage() const;
+  void printReport(std::ostream &os) const;
+
+private:
+  GPUResource *_find(GPUResourceCategory category, t_id sourceId);
+  GPUResource &_insert(GPUResourceCategory category, t_id sourceId);
+  void _evict();
+  void _destroy(GPUResource &resource);
+  void _collectGarbage();
+
+private:
+  typedef struct PendingDeletion
+  {
+    unsigned long long frame;
+    GPUResource resource;
+  } PendingDeletion;
+
+  typedef struct FrameFence
+  {
+    unsigned long long frame;
+    GLsync sync;
+  } FrameFence;
+
+private:
+  OpenGLContext &_context;
+  std::map<t_key, GPUResource> _resources;
+  std::vector<PendingDeletion> _pendingDeletions;
+  std::deque<FrameFence> _frameFences;
+  size_t _budget = 512 * 1024 * 1024;
+  unsigned long long _frame = 1;
+  unsigned long long _completedFrame = 0;
+};
+
+} // namespace leo
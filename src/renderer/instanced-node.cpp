@@ -12,12 +12,35 @@ InstancedNode::InstancedNode(OpenGLContext &context, SceneContext &sceneContext,
     : MainNode(context, sceneContext, sceneGraph, shader, camera, options), _transformations(transformations)
 {
     this->_VBO = this->_sceneContext.instancingVBO;
+    this->_occlusionCulling = false; // See _getCullingFrustum
+}
+
+void InstancedNode::_submitQueue()
+{
+    // Instances are not in the geometry pool, every item is drawn with its instanced buffers
+    const Material *material = nullptr;
+    for (const DrawItem &item : this->_queue.getItems())
+    {
+        if (item.material != material)
+        {
+            material = item.material;
+            this->_setCurrentMaterial(material);
+        }
+        this->_setModelMatrix(&item.matrix);
+        this->_drawVolume(item.volume);
+    }
+}
+
+Frustum InstancedNode::_getCullingFrustum() const
+{
+    // The bounds of the entities do not cover the instances spread by the transformations
+    return Frustum();
 }
 
 void InstancedNode::_drawVolume(const Volume *volume)
 {
     this->_context.drawVolumeInstanced(*volume,
-                                       this->_sceneContext.bufferCollectionsInstanced.find(volume->getId())->second,
+                                       this->_sceneContext.getInstancedBufferCollection(*volume),
                                        this->_transformations.size());
 }
 
@@ -16,6 +16,8 @@ class InstancedNode : public MainNode
 
   private:
     virtual void _drawVolume(const Volume *volume) override;
+    virtual void _submitQueue() override;
+    virtual Frustum _getCullingFrustum() const override;
 
   private:
     std::vector<glm::mat4> _transformations;
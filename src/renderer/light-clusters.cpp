@@ -0,0 +1,189 @@
+#include "light-clusters.hpp"
+
+#include <renderer/opengl-context.hpp>
+
+#include <utils/bounds.hpp>
+#include <utils/thread-pool.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LEO_CLUSTERS_SSE
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace leo
+{
+
+LightClusters::LightClusters()
+    : _minX(NB_CLUSTERS), _minY(NB_CLUSTERS), _minZ(NB_CLUSTERS), _maxX(NB_CLUSTERS), _maxY(NB_CLUSTERS), _maxZ(NB_CLUSTERS),
+      _sliceNear(CLUSTERS_Z), _sliceFar(CLUSTERS_Z), _tileLights(CLUSTERS_Z, std::vector<std::vector<GLuint>>(NB_TILES)),
+      _clusters(NB_CLUSTERS)
+{
+}
+
+void LightClusters::update(OpenGLContext &context, const glm::mat4 &view, const glm::mat4 &projection, float near, float far,
+                           const std::vector<PointLightUniform> &lights)
+{
+    if (projection != this->_projection || near != this->_near || far != this->_far)
+        this->_computeClusterBounds(projection, near, far);
+
+    size_t nbLights = std::min<size_t>(lights.size(), MAX_POINT_LIGHTS);
+    if (nbLights < lights.size())
+        std::cerr << "LightClusters: " << lights.size() << " point lights, only the first " << MAX_POINT_LIGHTS << " are shaded" << std::endl;
+    this->_spheres.resize(nbLights);
+    for (size_t i = 0; i < nbLights; ++i)
+    {
+        // Lights without an end to their range reach the whole frustum
+        glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lights[i].position), 1.f));
+        this->_spheres[i] = glm::vec4(center, std::min(getRange(lights[i]), 2.f * far));
+    }
+
+    ThreadPool::getInstance()->parallelFor(CLUSTERS_Z, [this](size_t slice) { this->_assignSlice((unsigned int)slice); });
+
+    this->_indices.clear();
+    for (unsigned int slice = 0; slice < CLUSTERS_Z; ++slice)
+    {
+        for (unsigned int tile = 0; tile < NB_TILES; ++tile)
+        {
+            const std::vector<GLuint> &tileLights = this->_tileLights[slice][tile];
+            LightCluster &cluster = this->_clusters[slice * NB_TILES + tile];
+            cluster.offset = (GLuint)this->_indices.size();
+            cluster.count = (GLuint)tileLights.size();
+            this->_indices.insert(this->_indices.end(), tileLights.begin(), tileLights.end());
+        }
+    }
+
+    // Empty ranges cannot be bound, the buffers keep at least one element
+    FrameRingBuffer &frameData = context.getFrameData();
+    FrameAllocation lightRange = frameData.allocate(std::max<size_t>(nbLights, 1) * sizeof(PointLightUniform));
+    FrameAllocation clusterRange = frameData.allocate(sizeof(LightClusterHeader) + NB_CLUSTERS * sizeof(LightCluster));
+    FrameAllocation indexRange = frameData.allocate(std::max<size_t>(this->_indices.size(), 1) * sizeof(GLuint));
+    if (!lightRange.data || !clusterRange.data || !indexRange.data)
+        return;
+    if (nbLights)
+        std::memcpy(lightRange.data, (const void *)lights.data(), nbLights * sizeof(PointLightUniform));
+    LightClusterHeader header;
+    header.size = glm::uvec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, (GLuint)nbLights);
+    header.slices = glm::vec4(near, CLUSTERS_Z / std::log(far / near), 0.f, 0.f);
+    std::memcpy(clusterRange.data, &header, sizeof(LightClusterHeader));
+    std::memcpy(static_cast<unsigned char *>(clusterRange.data) + sizeof(LightClusterHeader), this->_clusters.data(),
+                NB_CLUSTERS * sizeof(LightCluster));
+    if (this->_indices.size())
+        std::memcpy(indexRange.data, this->_indices.data(), this->_indices.size() * sizeof(GLuint));
+    frameData.bindRange(GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING, lightRange);
+    frameData.bindRange(GL_SHADER_STORAGE_BUFFER, CLUSTERS_BINDING, clusterRange);
+    frameData.bindRange(GL_SHADER_STORAGE_BUFFER, LIGHT_INDICES_BINDING, indexRange);
+}
+
+float LightClusters::getRange(const LightUniform &light)
+{
+    // Distance where intensity / (constant + linear * d + quadratic * d^2) falls to the threshold
+    float intensity = std::max(glm::max(light.diffuse.x, glm::max(light.diffuse.y, light.diffuse.z)),
+                               glm::max(light.specular.x, glm::max(light.specular.y, light.specular.z)));
+    float target = intensity / LIGHT_THRESHOLD - light.constant;
+    if (intensity <= 0.f || target <= 0.f)
+        return 0.f;
+    if (light.quadratic > 0.f)
+        return (-light.linear + std::sqrt(light.linear * light.linear + 4.f * light.quadratic * target)) / (2.f * light.quadratic);
+    if (light.linear > 0.f)
+        return target / light.linear;
+    return std::numeric_limits<float>::max();
+}
+
+void LightClusters::_computeClusterBounds(const glm::mat4 &projection, float near, float far)
+{
+    this->_projection = projection;
+    this->_near = near;
+    this->_far = far;
+
+    // Directions through the tile corners, scaled to the distances of the slice planes
+    glm::mat4 inverse = glm::inverse(projection);
+    for (unsigned int slice = 0; slice < CLUSTERS_Z; ++slice)
+    {
+        this->_sliceNear[slice] = near * std::pow(far / near, (float)slice / CLUSTERS_Z);
+        this->_sliceFar[slice] = near * std::pow(far / near, (float)(slice + 1) / CLUSTERS_Z);
+    }
+    for (unsigned int y = 0; y < CLUSTERS_Y; ++y)
+    {
+        for (unsigned int x = 0; x < CLUSTERS_X; ++x)
+        {
+            glm::vec3 directions[4];
+            for (int corner = 0; corner < 4; ++corner)
+            {
+                glm::vec2 ndc(-1.f + 2.f * (x + (corner & 1)) / CLUSTERS_X, -1.f + 2.f * (y + (corner >> 1)) / CLUSTERS_Y);
+                glm::vec4 point = inverse * glm::vec4(ndc, -1.f, 1.f);
+                glm::vec3 position = glm::vec3(point) / point.w;
+                directions[corner] = position / -position.z;
+            }
+            for (unsigned int slice = 0; slice < CLUSTERS_Z; ++slice)
+            {
+                AABB box;
+                for (const glm::vec3 &direction : directions)
+                {
+                    box.add(direction * this->_sliceNear[slice]);
+                    box.add(direction * this->_sliceFar[slice]);
+                }
+                size_t cluster = slice * NB_TILES + y * CLUSTERS_X + x;
+                this->_minX[cluster] = box.min.x;
+                this->_minY[cluster] = box.min.y;
+                this->_minZ[cluster] = box.min.z;
+                this->_maxX[cluster] = box.max.x;
+                this->_maxY[cluster] = box.max.y;
+                this->_maxZ[cluster] = box.max.z;
+            }
+        }
+    }
+}
+
+void LightClusters::_assignSlice(unsigned int slice)
+{
+    std::vector<std::vector<GLuint>> &tileLights = this->_tileLights[slice];
+    for (std::vector<GLuint> &lights : tileLights)
+        lights.clear();
+    size_t base = slice * NB_TILES;
+    for (GLuint light = 0; light < (GLuint)this->_spheres.size(); ++light)
+    {
+        const glm::vec4 &sphere = this->_spheres[light];
+        float distance = -sphere.z;
+        if (sphere.w <= 0.f || distance + sphere.w < this->_sliceNear[slice] || distance - sphere.w > this->_sliceFar[slice])
+            continue;
+        // Squared distance from the center to each box, against the squared range
+#ifdef LEO_CLUSTERS_SSE
+        const __m128 cx = _mm_set1_ps(sphere.x), cy = _mm_set1_ps(sphere.y), cz = _mm_set1_ps(sphere.z);
+        const __m128 range2 = _mm_set1_ps(sphere.w * sphere.w);
+        const __m128 zero = _mm_setzero_ps();
+        for (unsigned int tile = 0; tile < NB_TILES; tile += 4)
+        {
+            size_t i = base + tile;
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&this->_minX[i]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&this->_maxX[i]))), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&this->_minY[i]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&this->_maxY[i]))), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&this->_minZ[i]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&this->_maxZ[i]))), zero);
+            __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int inside = _mm_movemask_ps(_mm_cmple_ps(distance2, range2));
+            for (int j = 0; inside; ++j, inside >>= 1)
+            {
+                if (inside & 1)
+                    tileLights[tile + j].push_back(light);
+            }
+        }
+#else
+        float range2 = sphere.w * sphere.w;
+        for (unsigned int tile = 0; tile < NB_TILES; ++tile)
+        {
+            size_t i = base + tile;
+            float dx = std::max(std::max(this->_minX[i] - sphere.x, sphere.x - this->_maxX[i]), 0.f);
+            float dy = std::max(std::max(this->_minY[i] - sphere.y, sphere.y - this->_maxY[i]), 0.f);
+            float dz = std::max(std::max(this->_minZ[i] - sphere.z, sphere.z - this->_maxZ[i]), 0.f);
+            if (dx * dx + dy * dy + dz * dz <= range2)
+                tileLights[tile].push_back(light);
+        }
+#endif
+    }
+}
+
+} // namespace leo
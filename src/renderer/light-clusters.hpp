@@ -0,0 +1,74 @@
+#pragma once
+
+#include <renderer/global.hpp>
+#include <renderer/light-uniforms.hpp>
+
+#include <vector>
+
+namespace leo
+{
+
+class OpenGLContext;
+
+typedef struct LightCluster
+{
+  GLuint offset = 0; // In the light index list
+  GLuint count = 0;
+} LightCluster;
+
+typedef struct LightClusterHeader
+{
+  glm::uvec4 size;  // Clusters along x, y and z, number of point lights
+  glm::vec4 slices; // x: near plane, y: depth slices per unit of log depth
+} LightClusterHeader;
+
+/* Point lights sorted into a grid of clusters over the view frustum, so that shading only loops over the
+   * lights reaching the pixel's cluster. The grid has CLUSTERS_X by CLUSTERS_Y screen tiles and CLUSTERS_Z
+   * depth slices, spaced exponentially between the near and far planes. A light reaches as far as its
+   * attenuated color stays above LIGHT_THRESHOLD. Slices are filled in parallel on the ThreadPool, each
+   * testing the light spheres against four view space cluster boxes at a time with SSE.
+   * The lights, the grid and the index lists are bound for the whole frame as std430 buffers.
+   */
+class LightClusters
+{
+public:
+  LightClusters();
+
+public:
+  void update(OpenGLContext &context, const glm::mat4 &view, const glm::mat4 &projection, float near, float far,
+              const std::vector<PointLightUniform> &lights);
+  size_t getNbLights() const { return this->_spheres.size(); }
+  size_t getNbIndices() const { return this->_indices.size(); }
+  static float getRange(const LightUniform &light);
+
+public:
+  static const unsigned int CLUSTERS_X = 16;
+  static const unsigned int CLUSTERS_Y = 9;
+  static const unsigned int CLUSTERS_Z = 24;
+  static const unsigned int NB_TILES = CLUSTERS_X * CLUSTERS_Y; // Multiple of 4
+  static const unsigned int NB_CLUSTERS = NB_TILES * CLUSTERS_Z;
+  static const unsigned int MAX_POINT_LIGHTS = 4096;
+  static const GLuint LIGHTS_BINDING = 7; // After the draws, the materials and the GPU culling buffers
+  static const GLuint CLUSTERS_BINDING = 8;
+  static const GLuint LIGHT_INDICES_BINDING = 9;
+  static constexpr float LIGHT_THRESHOLD = 1.f / 256.f;
+
+private:
+  void _computeClusterBounds(const glm::mat4 &projection, float near, float far);
+  void _assignSlice(unsigned int slice);
+
+private:
+  glm::mat4 _projection; // Of the cluster bounds
+  float _near = 0.f;
+  float _far = 0.f;
+  // View space boxes of the clusters, slice by slice
+  std::vector<float> _minX, _minY, _minZ, _maxX, _maxY, _maxZ;
+  std::vector<float> _sliceNear; // Distances to the camera
+  std::vector<float> _sliceFar;
+  std::vector<glm::vec4> _spheres; // View space center and range of the lights
+  std::vector<std::vector<std::vector<GLuint>>> _tileLights; // Per slice and tile
+  std::vector<LightCluster> _clusters;
+  std::vector<GLuint> _indices;
+};
+
+} // namespace leo
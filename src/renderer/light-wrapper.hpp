@@ -13,10 +13,10 @@ typedef struct PointLightWrapper
 {
     static const float near;
     static const float far;
-    Framebuffer &map;
     std::vector<glm::mat4> shadowTransforms;
     PointLightUniform uniform;
     CubeShadowMapNode renderNode;
+    unsigned int shadowSlot = 0; // Light of the shadow atlas, six tiles in the order of shadowTransforms
 
     PointLightWrapper(PointLightUniform uniform, CubeShadowMapNode renderNode);
 
@@ -24,13 +24,13 @@ typedef struct PointLightWrapper
 
 typedef struct DirectionLightWrapper
 {
-    Framebuffer map;
     glm::mat4x4 projection;
     DirectionLightUniform uniform;
     ShadowMappingNode renderNode;
+    unsigned int shadowSlot = 0; // Light of the shadow atlas, one tile
 
     DirectionLightWrapper(
-        Framebuffer map, glm::mat4x4 projection, DirectionLightUniform uniform, ShadowMappingNode renderNode);
+        glm::mat4x4 projection, DirectionLightUniform uniform, ShadowMappingNode renderNode);
 
 } DirectionLightWrapper;
 
@@ -1,11 +1,14 @@
 #include <renderer/main-node.hpp>
 
 #include <renderer/shader.hpp>
+#include <renderer/shader-features.hpp>
 #include <renderer/framebuffer.hpp>
+#include <renderer/gl-extensions.hpp>
 #include <renderer/camera.hpp>
 #include <renderer/opengl-context.hpp>
 #include <renderer/scene-context.hpp>
 #include <renderer/light-wrapper.hpp>
+#include <renderer/uniform-table.hpp>
 
 #include <model/components/transformation.hpp>
 #include <model/entity.hpp>
@@ -18,215 +21,325 @@
 
 #include <utils/texture.hpp>
 
-#include <sstream>
+#include <algorithm>
 
 namespace leo
 {
 
+namespace
+{
+
+const UniformNameTable lightSpaceMatrixNames("lightSpaceMatrix", MAX_NUM_LIGHTS);
+const UniformNameTable textureArrayNames("texture_arrays[", SceneContext::MAX_TEXTURE_ARRAYS, "]");
+const char *materialMapNames[MainNode::NB_MATERIAL_MAPS] = {"material.diffuse_texture", "material.specular_texture",
+                                                          "material.reflection_map", "material.normal_map", "material.parallax_map"};
+const char *materialLayerNames[MainNode::NB_MATERIAL_MAPS] = {"material.diffuse_layer", "material.specular_layer",
+                                                            "material.reflection_layer", "material.normal_layer", "material.parallax_layer"};
+
+} // namespace
+
 MainNode::MainNode(OpenGLContext &context, SceneContext &sceneContext, SceneGraph &sceneGraph, Shader &shader, const Camera &camera, RenderNodeOptions options)
     : RenderNode(context, sceneContext, shader, options), _sceneGraph(sceneGraph), _camera(camera)
 {
-    { // Lights
-        glGenBuffers(1, &this->_lightsUBO);
-        glBindBuffer(GL_UNIFORM_BUFFER, this->_lightsUBO);
-        auto size = sizeof(PointLightUniform);
-        glBufferData(GL_UNIFORM_BUFFER,
-                     MAX_NUM_LIGHTS * (sizeof(PointLightUniform) + sizeof(DirectionLightUniform)),
-                     NULL, GL_STATIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    }
 }
 
 void MainNode::render()
 {
-    glClearColor(0.07, 0.07, 0.07, 1);
+    this->_context.getState().clearColor(0.07, 0.07, 0.07, 1);
 
     // Setup some OpenGL options
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL); // Set to always pass the depth test (same effect as glDisable(GL_DEPTH_TEST))
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glEnable(GL_MULTISAMPLE);
+    this->_context.getState().enable(GL_DEPTH_TEST);
+    this->_context.getState().depthFunc(GL_LEQUAL); // Set to always pass the depth test (same effect as glDisable(GL_DEPTH_TEST))
+    this->_context.getState().enable(GL_BLEND);
+    this->_context.getState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    this->_context.getState().enable(GL_CULL_FACE);
+    this->_context.getState().cullFace(GL_BACK);
+    this->_context.getState().enable(GL_MULTISAMPLE);
 
     this->_loadShader();
 
-    this->_loadInputFramebuffers();
+    // Entities without a material in their hierarchy are drawn with the default one
+    this->_useVariant(&this->_defaultMaterial);
 
     this->_loadOutputFramebuffer();
 
     glClear(this->_options.clearBufferFlags);
-    glEnable(GL_DEPTH_TEST);
-
-    glm::mat4x4 m;
-    Material defaultMat;
-    this->_shader.setVector3("viewPos", this->_camera.getPosition());
-    this->_shader.setVector3("ambientLight", glm::vec3(0.4, 0.4, 0.4));
-    this->_renderRec(this->_sceneGraph.getRoot(), &defaultMat, &m);
+    this->_context.getState().enable(GL_DEPTH_TEST);
+
+    this->_queue.clear();
+    this->_cullStats = CullStats();
+    this->_frustum = this->_getCullingFrustum();
+    this->_renderRec(this->_sceneGraph.getRoot(), &this->_defaultMaterial, nullptr, true);
+    this->_queue.sort();
+    this->_submitQueue();
 }
 
 void MainNode::_loadInputFramebuffers()
 {
     RenderNode::_loadInputFramebuffers();
     int inputNumber = this->_materialTextureOffset;
-    for (auto &p : this->_sceneContext.dLights)
-    {
-        Framebuffer &input = p.second.map;
-        std::stringstream ss;
-        ss << inputNumber - this->_materialTextureOffset;
-        const TextureWrapper &tw = input.getDepthBuffer();
-        glUniform1i(glGetUniformLocation(this->_shader.getProgram(), ("shadowMap" + ss.str()).c_str()), inputNumber);
-        glActiveTexture(GL_TEXTURE0 + inputNumber);
-        glBindTexture(GL_TEXTURE_2D, tw.getId());
-        inputNumber++;
-    }
-    int cubeMapNb = 0;
-    for (auto &p : this->_sceneContext.pLights)
+    // The shadows of every light are tiles of the atlas, indexed by the shader
+    this->_getShader().setTexture("shadowAtlas", this->_sceneContext.shadowAtlas.getTextureId(), inputNumber);
+    inputNumber++;
+    // Arrays of the packed material textures, bound once for the whole pass
+    for (unsigned int slot = 0; slot < SceneContext::MAX_TEXTURE_ARRAYS; ++slot)
     {
-        Framebuffer &input = p.second.map;
-        std::stringstream ss;
-        ss << cubeMapNb;
-        int i = 0;
-        const TextureWrapper &tw = input.getDepthBuffer();
-        GLuint ul = glGetUniformLocation(this->_shader.getProgram(), ("shadowCubeMap" + ss.str()).c_str());
-        glUniform1i(ul, inputNumber);
-        glActiveTexture(GL_TEXTURE0 + inputNumber);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, tw.getId());
-        this->_shader.setVector3(("lightPos" + std::to_string(i)).c_str(), p.second.uniform.position);
+        this->_getShader().setTexture(textureArrayNames[slot], this->_sceneContext.getTextureArrayId(slot), inputNumber, GL_TEXTURE_2D_ARRAY);
         inputNumber++;
-        cubeMapNb++;
-        i++;
     }
     this->_materialTextureOffset = inputNumber;
 }
 
-void MainNode::_renderRec(const Entity *root, const Material *material, const glm::mat4x4 *matrix)
+void MainNode::_renderRec(const Entity *root, const Material *material, const Transformation *transformation, bool testBounds)
 {
+    unsigned int nbVolumes = root->getSubtreeVolumeCount();
+    if (!nbVolumes)
+        return;
+    // Subtrees fully inside the frustum are not tested any further
+    if (testBounds)
+    {
+        this->_cullStats.tested++;
+        FrustumTest result = this->_frustum.test(root->getSubtreeBounds());
+        if (result == OUTSIDE_FRUSTUM)
+        {
+            this->_cullStats.culled += nbVolumes;
+            return;
+        }
+        testBounds = result == INTERSECTS_FRUSTUM;
+    }
+    if (this->_occlusionCulling && !this->_sceneContext.occlusion.isVisible(root->getSubtreeBounds()))
+    {
+        this->_cullStats.occluded += nbVolumes;
+        return;
+    }
+
     const Material *newMaterial = material;
-    const glm::mat4x4 *newMatrix = matrix;
+    const Transformation *newTransformation = transformation;
     const IComponent *p_component;
     p_component = root->getComponent(ComponentType::MATERIAL);
     if (p_component)
     {
         newMaterial = static_cast<const Material *>(p_component);
-        this->_setCurrentMaterial(newMaterial);
     }
     p_component = root->getComponent(ComponentType::TRANSFORMATION);
     if (p_component)
     {
-        newMatrix = &(static_cast<const Transformation *>(p_component))->getTransformationMatrix();
-        this->_setModelMatrix(newMatrix);
+        newTransformation = static_cast<const Transformation *>(p_component);
     }
     // NOTE: Keep volume at the end as it is affected by the transform and material
     p_component = root->getComponent(ComponentType::VOLUME);
     if (p_component)
     {
-        this->_context.drawVolume(*static_cast<const Volume *>(p_component),
-                                  this->_sceneContext.bufferCollections.find(p_component->getId())->second);
+        // Without children the subtree bounds are the volume's, already tested
+        bool visible = true;
+        if (testBounds && root->getChildren().size())
+        {
+            this->_cullStats.tested++;
+            visible = this->_frustum.test(root->getWorldBounds()) != OUTSIDE_FRUSTUM;
+        }
+        if (!visible)
+            this->_cullStats.culled++;
+        else if (this->_occlusionCulling && root->getChildren().size() && !this->_sceneContext.occlusion.isVisible(root->getWorldBounds()))
+            this->_cullStats.occluded++;
+        else
+        {
+            this->_cullStats.visible++;
+            this->_pushDrawItem(static_cast<const Volume *>(p_component), newMaterial, newTransformation);
+        }
     }
 
     for (auto &child : root->getChildren())
     {
-        this->_renderRec(child.second, newMaterial, newMatrix);
+        this->_renderRec(child.second, newMaterial, newTransformation, testBounds);
+    }
+}
+
+void MainNode::_pushDrawItem(const Volume *volume, const Material *material, const Transformation *transformation)
+{
+    DrawItem item;
+    item.volume = volume;
+    item.material = material;
+    if (transformation) // Identity otherwise
+    {
+        item.matrix = transformation->getTransformationMatrix();
+        item.normalMatrix = transformation->getNormalMatrix();
     }
-    if (newMatrix != matrix)
+    // Distance along the view direction, normalized by the far plane of the projection
+    glm::vec3 position = glm::vec3(item.matrix[3]);
+    float depth = glm::dot(position - this->_camera.getPosition(), this->_camera.getFront()) / SceneContext::FAR_PLANE;
+    item.key = RenderQueue::makeKey(0, ShaderFeatures::fromMaterial(*material), material->getId(),
+                                    this->_context.getGeometryPool().allocate(*volume).page, depth);
+    this->_queue.push(item);
+}
+
+void MainNode::_submitQueue()
+{
+    // One multi-draw per run of items sharing a material, the queue order makes the runs as long as possible.
+    // Bindless variants read everything from the material buffer, a run then only ends with its variant
+    const std::vector<DrawItem> &items = this->_queue.getItems();
+    bool bindless = this->_passFeatures & ShaderFeature::USE_BINDLESS_TEXTURES;
+    auto sameRun = [bindless](const DrawItem &a, const DrawItem &b) {
+        return bindless ? ShaderFeatures::fromMaterial(*a.material) == ShaderFeatures::fromMaterial(*b.material)
+                        : a.material == b.material;
+    };
+    this->_draws.clear();
+    for (size_t i = 0; i < items.size(); ++i)
     {
-        this->_setModelMatrix(matrix);
+        if (i && !sameRun(items[i], items[i - 1]))
+            this->_draws.split(); // Culled commands are compacted per run
+        this->_draws.add(this->_context.getGeometryPool().allocate(*items[i].volume), items[i].matrix, items[i].normalMatrix,
+                         this->_sceneContext.materials.getIndex(*items[i].material));
     }
-    if (newMaterial != material)
+    this->_draws.upload(this->_context);
+    this->_draws.cull(this->_context, this->_sceneContext.getFrameGlobals().viewProjection, this->_occlusionCulling);
+    this->_sceneContext.materials.bind();
+
+    size_t first = 0;
+    for (size_t i = 1; i <= items.size(); ++i)
     {
-        this->_setCurrentMaterial(material);
+        if (i < items.size() && sameRun(items[i], items[first]))
+            continue;
+        this->_setCurrentMaterial(items[first].material);
+        this->_draws.draw(this->_context, first, i - first);
+        first = i;
     }
 }
 
+Frustum MainNode::_getCullingFrustum() const
+{
+    return Frustum(this->_sceneContext.getFrameGlobals().viewProjection);
+}
+
 void MainNode::_drawVolume(const Volume *volume)
 {
-    this->_context.drawVolume(*volume, this->_sceneContext.bufferCollections.find(volume->getId())->second);
+    this->_context.drawVolume(*volume, this->_sceneContext.getBufferCollection(*volume));
 }
 
 void MainNode::_loadLightsToShader()
 {
-    unsigned int ubiLights = glGetUniformBlockIndex(this->_shader.getProgram(), "s1");
-    if (ubiLights != GL_INVALID_INDEX)
-    {
-        glUniformBlockBinding(this->_shader.getProgram(), ubiLights, 1);
-    }
-
-    glBindBufferBase(GL_UNIFORM_BUFFER, 1, this->_lightsUBO);
-    glBindBuffer(GL_UNIFORM_BUFFER, this->_lightsUBO);
-    int i = 0;
-    for (auto &p : this->_sceneContext.pLights)
-    {
-        PointLightUniform &plu = p.second.uniform;
-        glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(PointLightUniform), sizeof(PointLightUniform), &plu);
-        i++;
-    }
-    i = 0;
-    unsigned int offset = MAX_NUM_LIGHTS * sizeof(PointLightUniform);
-    for (auto &p : this->_sceneContext.dLights)
-    {
-        DirectionLightUniform &dlu = p.second.uniform;
-        glBufferSubData(GL_UNIFORM_BUFFER, offset + i * sizeof(DirectionLightUniform), sizeof(DirectionLightUniform), &dlu);
-        i++;
-    }
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    this->_context.getFrameData().bindRange(GL_UNIFORM_BUFFER, 1, this->_sceneContext.getLights());
 }
 
 void MainNode::_setModelMatrix(const Transformation *transformation)
 {
-    this->_shader.setMat4("model", transformation->getTransformationMatrix());
+    this->_setModelMatrix(&transformation->getTransformationMatrix());
 }
 
 void MainNode::_setModelMatrix()
 {
     glm::mat4 m;
-    this->_shader.setMat4("model", m);
+    this->_setModelMatrix(&m);
 }
 
 void MainNode::_setModelMatrix(const glm::mat4x4 *transformation)
 {
-    this->_shader.setMat4("model", *transformation);
+    // Kept to restore it when another variant gets used
+    this->_modelMatrix = *transformation;
+    this->_getShader().setMat4(this->_modelUniform, this->_modelMatrix);
 }
 
 void MainNode::_setCurrentMaterial(const Material *material)
 {
-    this->_shader.setVector3("material.diffuse_value", material->diffuse_value);
-    this->_loadTextureToShader("material.diffuse_texture", this->_materialTextureOffset + 0,
-                               material->diffuse_texture ? *material->diffuse_texture : *TextureManager::white.get());
-
-    this->_shader.setVector3("material.specular_value", material->specular_value);
-    this->_shader.setFloat("material.shininess", material->shininess);
-    this->_loadTextureToShader("material.specular_texture", this->_materialTextureOffset + 1,
-                               material->specular_texture ? *material->specular_texture : *TextureManager::white.get());
-
-    this->_loadTextureToShader("material.reflection_map", this->_materialTextureOffset + 2,
-                               material->reflection_map ? *material->reflection_map : *TextureManager::black.get());
-    this->_loadTextureToShader("material.normal_map", this->_materialTextureOffset + 3,
-                               material->normal_map ? *material->normal_map : *TextureManager::blue.get());
-    this->_loadTextureToShader("material.parallax_map", this->_materialTextureOffset + 4,
-                               material->parallax_map ? *material->parallax_map : *TextureManager::black.get());
+    this->_useVariant(material);
+
+    // Material values are read from the material buffer, only shaders without draw data need the index
+    const MaterialUniforms &uniforms = this->_materialUniforms;
+    if (uniforms.index >= 0)
+    {
+        this->_sceneContext.materials.bind();
+        this->_getShader().setInt(uniforms.index, (GLint)this->_sceneContext.materials.getIndex(*material));
+    }
+
+    // Bindless variants sample the handles of the material buffer, their map and layer uniforms are inactive
+    const Texture *maps[NB_MATERIAL_MAPS] = {material->diffuse_texture, material->specular_texture, material->reflection_map,
+                                             material->normal_map, material->parallax_map};
+    const Texture *defaultMaps[NB_MATERIAL_MAPS] = {TextureManager::white.get(), TextureManager::white.get(), TextureManager::black.get(),
+                                                    TextureManager::blue.get(), TextureManager::black.get()};
+    const TextureArrayLayer *layers[NB_MATERIAL_MAPS] = {&material->diffuse_layer, &material->specular_layer, &material->reflection_layer,
+                                                         &material->normal_layer, &material->parallax_layer};
+    for (int i = 0; i < NB_MATERIAL_MAPS; ++i)
+    {
+        this->_loadMaterialTexture(uniforms.maps[i], uniforms.layers[i], this->_materialTextureOffset + i,
+                                   maps[i], *defaultMaps[i], *layers[i]);
+    }
+}
+
+void MainNode::_loadMaterialTexture(int mapUniform, int layerUniform, GLuint textureSlot,
+                                    const Texture *texture, const Texture &defaultTexture, const TextureArrayLayer &layer)
+{
+    // Packed maps only need the array slot and layer, the array itself is already bound
+    int slot = layer.array ? this->_sceneContext.getTextureArraySlot(layer.array) : -1;
+    this->_getShader().setIVec2(layerUniform, glm::ivec2(slot, layer.layer));
+    if (slot < 0 && mapUniform >= 0) // Maps the variant does not sample are not bound
+        this->_loadTextureToShader(mapUniform, textureSlot, texture ? *texture : defaultTexture);
+}
+
+void MainNode::_resolveUniforms()
+{
+    // Handles stay valid as long as the program does, resolving them is a hash lookup
+    Shader &shader = this->_getShader();
+    this->_modelUniform = shader.getUniform("model");
+    this->_materialUniforms.index = shader.getUniform("materialIndex");
+    for (int i = 0; i < NB_MATERIAL_MAPS; ++i)
+    {
+        this->_materialUniforms.maps[i] = shader.getUniform(materialMapNames[i]);
+        this->_materialUniforms.layers[i] = shader.getUniform(materialLayerNames[i]);
+    }
 }
 
 void MainNode::_loadShader()
 {
     RenderNode::_loadShader();
 
-    this->_shader.use();
-    this->_shader.setMat4("view", this->_camera.getViewMatrix());
-    this->_shader.setMat4("projection", glm::perspective(this->_camera.getZoom(), (float)1620 / (float)1080, 0.1f, 100.0f));
-    this->_shader.setFloat("far_plane", PointLightWrapper::far);
+    this->_passFeatures = this->getPassFeatures();
+    this->_loadLightsToShader();
+    this->_modelMatrix = glm::mat4();
+    // Variants keep their uniforms between frames, the pass uniforms are uploaded again when one gets used
+    this->_activeShader = nullptr;
+}
+
+Shader::t_features MainNode::getPassFeatures() const
+{
+    Shader::t_features features = ShaderFeatures::fromLightCounts(
+        (unsigned int)std::min<size_t>(this->_sceneContext.pLights.size(), MAX_NUM_LIGHTS),
+        (unsigned int)std::min<size_t>(this->_sceneContext.dLights.size(), MAX_NUM_LIGHTS));
+    if (GLExtensions::bindlessTexture)
+        features |= ShaderFeature::USE_BINDLESS_TEXTURES;
+    return features;
+}
+
+Shader &MainNode::_getShader()
+{
+    return this->_activeShader ? *this->_activeShader : this->_shader;
+}
+
+void MainNode::_useVariant(const Material *material)
+{
+    Shader &variant = this->_shader.getVariant(this->_passFeatures | ShaderFeatures::fromMaterial(*material));
+    if (&variant == this->_activeShader)
+        return;
+    this->_activeShader = &variant;
+    variant.use();
+    this->_resolveUniforms();
+    this->_loadPassUniforms();
+}
+
+void MainNode::_loadPassUniforms()
+{
+    // Redundant values are filtered by the program's uniform cache, switching back to a variant is cheap
+    Shader &shader = this->_getShader();
+    shader.setFloat("far_plane", PointLightWrapper::far);
 
     int matNb = 0;
     for (auto &p : this->_sceneContext.dLights)
     {
-        std::stringstream ss;
-        ss << matNb;
-        this->_shader.setMat4(("lightSpaceMatrix" + ss.str()).c_str(), p.second.projection);
+        shader.setMat4(lightSpaceMatrixNames[matNb], p.second.projection);
     }
 
-    this->_loadLightsToShader();
-    this->_setModelMatrix();
+    shader.bindUniformBlock("s1", 1);
+    shader.setVector3("ambientLight", glm::vec3(0.4, 0.4, 0.4));
+    this->_loadInputFramebuffers();
+    shader.setMat4(this->_modelUniform, this->_modelMatrix);
 }
 
 void MainNode::notified(Subject *subject, Event event)
@@ -1,10 +1,14 @@
 #pragma once
 
 #include <renderer/render-node.hpp>
+#include <renderer/shader.hpp>
 #include <renderer/light-uniforms.hpp>
+#include <renderer/render-queue.hpp>
+#include <renderer/multi-draw-buffer.hpp>
 #include <renderer/buffer-collection.hpp>
 #include <renderer/texture-wrapper.hpp>
-#include <renderer/light-uniforms.hpp>
+
+#include <model/components/material.hpp>
 
 namespace leo
 {
@@ -18,6 +22,7 @@ class Texture;
 class DirectionLight;
 class PointLight;
 class SceneContext;
+struct TextureArrayLayer;
 
 class MainNode : public RenderNode
 {
@@ -35,23 +40,55 @@ public:
 
 public:
   void setHdr(bool value);
+  Shader::t_features getPassFeatures() const;
+
+public:
+  static const int NB_MATERIAL_MAPS = 5;
 
 protected:
   virtual void _loadShader() override;
+  virtual Shader &_getShader() override;
 
 protected:
   void _loadLightsToShader();
+  void _useVariant(const Material *material);
+  void _loadPassUniforms();
   void _setModelMatrix(const Transformation *transformation);
   void _setModelMatrix(const glm::mat4x4 *transformation);
   void _setModelMatrix();
   void _setCurrentMaterial(const Material *material);
-  void _renderRec(const Entity *root, const Material *material, const glm::mat4x4 *matrix);
+  void _loadMaterialTexture(int mapUniform, int layerUniform, GLuint textureSlot,
+                            const Texture *texture, const Texture &defaultTexture, const TextureArrayLayer &layer);
+  void _resolveUniforms();
+  void _renderRec(const Entity *root, const Material *material, const Transformation *transformation, bool testBounds);
+  void _pushDrawItem(const Volume *volume, const Material *material, const Transformation *transformation);
+  virtual void _submitQueue();
+  virtual Frustum _getCullingFrustum() const;
 
 protected:
   virtual void _drawVolume(const Volume *volume);
 
+protected:
+  RenderQueue _queue;
+  Frustum _frustum;
+  bool _occlusionCulling = true;
+
+private:
+  typedef struct MaterialUniforms
+  {
+    int index = -1;
+    int maps[NB_MATERIAL_MAPS] = {-1, -1, -1, -1, -1};
+    int layers[NB_MATERIAL_MAPS] = {-1, -1, -1, -1, -1};
+  } MaterialUniforms;
+
 private:
-  GLuint _lightsUBO = 0;
+  Shader *_activeShader = nullptr; // Variant of _shader for the current material
+  Shader::t_features _passFeatures = 0;
+  glm::mat4 _modelMatrix;
+  int _modelUniform = -1;
+  MaterialUniforms _materialUniforms;
+  MultiDrawBuffer _draws;
+  Material _defaultMaterial;
   const SceneGraph &_sceneGraph;
   const Camera &_camera;
   bool _hdr = true;
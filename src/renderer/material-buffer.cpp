@@ -0,0 +1,125 @@
+#include "material-buffer.hpp"
+
+#include <renderer/gpu-memory-tracker.hpp>
+
+#include <model/components/material.hpp>
+
+#include <algorithm>
+
+namespace leo
+{
+
+MaterialBuffer::MaterialBuffer()
+{
+}
+
+MaterialBuffer::~MaterialBuffer()
+{
+    GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_buffer);
+    glDeleteBuffers(1, &this->_buffer);
+}
+
+unsigned int MaterialBuffer::update(const Material &material)
+{
+    unsigned int slot;
+    auto it = this->_slots.find(material.getId());
+    if (it != this->_slots.end())
+    {
+        slot = it->second;
+    }
+    else if (this->_freeSlots.size())
+    {
+        slot = this->_freeSlots.back();
+        this->_freeSlots.pop_back();
+        this->_slots.insert(std::pair<t_id, unsigned int>(material.getId(), slot));
+    }
+    else
+    {
+        slot = (unsigned int)this->_data.size();
+        this->_data.push_back(MaterialData());
+        this->_slots.insert(std::pair<t_id, unsigned int>(material.getId(), slot));
+    }
+
+    MaterialData &data = this->_data[slot];
+    data.diffuse = glm::vec4(material.diffuse_value, material.shininess);
+    data.specular = glm::vec4(material.specular_value, 0.f);
+    for (int i = 0; i < NB_MATERIAL_BUFFER_MAPS; ++i)
+    {
+        data.maps[i] = glm::uvec2(0, 0);
+        data.layers[i] = glm::ivec2(-1, 0);
+    }
+    this->_markDirty(slot);
+    return slot;
+}
+
+void MaterialBuffer::setMaps(const Material &material, const GLuint64 handles[NB_MATERIAL_BUFFER_MAPS], const glm::ivec2 layers[NB_MATERIAL_BUFFER_MAPS])
+{
+    MaterialData &data = this->_data[this->getIndex(material)];
+    for (int i = 0; i < NB_MATERIAL_BUFFER_MAPS; ++i)
+    {
+        // Read back as a uvec2 and turned into a sampler in the shaders
+        data.maps[i] = glm::uvec2((GLuint)(handles[i] & 0xffffffff), (GLuint)(handles[i] >> 32));
+        data.layers[i] = layers[i];
+    }
+    this->_markDirty(this->getIndex(material));
+}
+
+unsigned int MaterialBuffer::getIndex(const Material &material)
+{
+    auto it = this->_slots.find(material.getId());
+    if (it != this->_slots.end())
+        return it->second;
+    // Materials that are not part of the scene graph, such as the default one of a node
+    return this->update(material);
+}
+
+void MaterialBuffer::release(t_id materialId)
+{
+    auto it = this->_slots.find(materialId);
+    if (it == this->_slots.end())
+        return;
+    this->_freeSlots.push_back(it->second);
+    this->_slots.erase(it);
+}
+
+void MaterialBuffer::bind()
+{
+    if (this->_dirtyBegin != this->_dirtyEnd)
+        this->_upload();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIALS_BINDING, this->_buffer);
+}
+
+void MaterialBuffer::_markDirty(unsigned int slot)
+{
+    if (this->_dirtyBegin == this->_dirtyEnd)
+    {
+        this->_dirtyBegin = slot;
+        this->_dirtyEnd = slot + 1;
+        return;
+    }
+    this->_dirtyBegin = std::min(this->_dirtyBegin, (size_t)slot);
+    this->_dirtyEnd = std::max(this->_dirtyEnd, (size_t)slot + 1);
+}
+
+void MaterialBuffer::_upload()
+{
+    if (this->_data.size() > this->_capacity)
+    {
+        // Grown by doubling, every slot is uploaded to the new buffer
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_buffer);
+        glDeleteBuffers(1, &this->_buffer);
+        this->_capacity = std::max(this->_data.size(), 2 * this->_capacity);
+        glCreateBuffers(1, &this->_buffer);
+        glNamedBufferData(this->_buffer, this->_capacity * sizeof(MaterialData), nullptr, GL_DYNAMIC_DRAW);
+        GPUMemoryTracker::getInstance()->track(GL_BUFFER, this->_buffer, GPUMemoryCategory::UNIFORM_BUFFERS,
+                                               this->_capacity * sizeof(MaterialData), "material data");
+        this->_dirtyBegin = 0;
+        this->_dirtyEnd = this->_data.size();
+    }
+    glNamedBufferSubData(this->_buffer, this->_dirtyBegin * sizeof(MaterialData),
+                         (this->_dirtyEnd - this->_dirtyBegin) * sizeof(MaterialData), this->_data.data() + this->_dirtyBegin);
+    this->_dirtyBegin = 0;
+    this->_dirtyEnd = 0;
+}
+
+} // namespace leo
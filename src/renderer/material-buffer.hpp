@@ -0,0 +1,65 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <map>
+#include <vector>
+
+namespace leo
+{
+
+class Material;
+
+static const int NB_MATERIAL_BUFFER_MAPS = 5; // Diffuse, specular, reflection, normal, parallax
+
+typedef struct MaterialData
+{
+  glm::vec4 diffuse;  // w: shininess
+  glm::vec4 specular; // w: unused
+  glm::uvec2 maps[NB_MATERIAL_BUFFER_MAPS];   // Bindless handles split in two words, 0 when the map is not resident
+  glm::ivec2 layers[NB_MATERIAL_BUFFER_MAPS]; // Texture array slot and layer, slot -1 when the map is not packed
+} MaterialData;
+
+/* Values of every registered Material, packed in one std430 array bound at MATERIALS_BINDING.
+   * Each material keeps its slot until it is released, freed slots are reused. update() only rewrites
+   * the slot on the CPU side, the dirty slots are uploaded in a single range the next time the buffer
+   * gets bound. Shaders index the array with the material index of the draw data. With bindless
+   * textures, setMaps also stores the handles of the maps so that draws never bind material textures.
+   */
+class MaterialBuffer
+{
+
+  using t_id = unsigned int;
+
+public:
+  MaterialBuffer();
+  ~MaterialBuffer();
+  MaterialBuffer(const MaterialBuffer &other) = delete;
+  MaterialBuffer &operator=(const MaterialBuffer &other) = delete;
+
+public:
+  unsigned int update(const Material &material);
+  unsigned int getIndex(const Material &material);
+  void setMaps(const Material &material, const GLuint64 handles[NB_MATERIAL_BUFFER_MAPS], const glm::ivec2 layers[NB_MATERIAL_BUFFER_MAPS]);
+  void release(t_id materialId);
+  void bind();
+  size_t size() const { return this->_data.size(); }
+
+public:
+  static const GLuint MATERIALS_BINDING = 1;
+
+private:
+  void _markDirty(unsigned int slot);
+  void _upload();
+
+private:
+  std::map<t_id, unsigned int> _slots; // Material id to index in _data
+  std::vector<unsigned int> _freeSlots;
+  std::vector<MaterialData> _data;
+  size_t _dirtyBegin = 0; // Slots in [_dirtyBegin, _dirtyEnd) differ from the GPU copy
+  size_t _dirtyEnd = 0;
+  GLuint _buffer = 0;
+  size_t _capacity = 0; // In materials
+};
+
+} // namespace leo
@@ -0,0 +1,201 @@
+#include "multi-draw-buffer.hpp"
+
+#include <renderer/geometry-pool.hpp>
+#include <renderer/gl-extensions.hpp>
+#include <renderer/gpu-memory-tracker.hpp>
+#include <renderer/opengl-context.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+namespace leo
+{
+
+MultiDrawBuffer::MultiDrawBuffer()
+{
+}
+
+MultiDrawBuffer::MultiDrawBuffer(const MultiDrawBuffer &other)
+{
+    UNUSED(other);
+}
+
+MultiDrawBuffer &MultiDrawBuffer::operator=(const MultiDrawBuffer &other)
+{
+    UNUSED(other);
+    this->clear();
+    return *this;
+}
+
+MultiDrawBuffer::~MultiDrawBuffer()
+{
+    GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_commandBuffer);
+    GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_drawBuffer);
+    glDeleteBuffers(1, &this->_commandBuffer);
+    glDeleteBuffers(1, &this->_drawBuffer);
+}
+
+void MultiDrawBuffer::clear()
+{
+    this->_commands.clear();
+    this->_draws.clear();
+    this->_pages.clear();
+    this->_bounds.clear();
+    this->_segmentStarts.clear();
+    this->_segments.clear();
+    this->_splitNext = false;
+    this->_culled = GPUCullResult();
+    this->_commandRange = FrameAllocation();
+    this->_drawRange = FrameAllocation();
+}
+
+size_t MultiDrawBuffer::add(const GeometryRange &range, const glm::mat4 &model, const glm::mat3 &normalMatrix, unsigned int materialIndex,
+                            unsigned int layerMask)
+{
+    DrawElementsIndirectCommand command;
+    command.count = range.indexCount;
+    command.firstIndex = range.firstIndex;
+    command.baseVertex = range.baseVertex;
+    command.baseInstance = (GLuint)this->_draws.size();
+    this->_commands.push_back(command);
+    this->_pages.push_back(range.page);
+    this->_bounds.push_back(range.bounds);
+    this->_segmentStarts.push_back(this->_splitNext);
+    this->_splitNext = false;
+
+    DrawData data;
+    data.model = model;
+    data.normalMatrix = glm::mat3x4(normalMatrix);
+    data.indices = glm::uvec4(materialIndex, layerMask, 0, 0);
+    this->_draws.push_back(data);
+    return this->_commands.size() - 1;
+}
+
+void MultiDrawBuffer::split()
+{
+    this->_splitNext = true;
+}
+
+void MultiDrawBuffer::upload(OpenGLContext &context)
+{
+    size_t nbDraws = this->_commands.size();
+    if (!nbDraws)
+        return;
+    if (nbDraws > GeometryPool::MAX_DRAWS)
+    {
+        std::cerr << "MultiDrawBuffer: " << nbDraws << " draws, only the first " << GeometryPool::MAX_DRAWS << " get a draw id" << std::endl;
+        nbDraws = GeometryPool::MAX_DRAWS;
+        this->_commands.resize(nbDraws);
+        this->_draws.resize(nbDraws);
+        this->_pages.resize(nbDraws);
+        this->_bounds.resize(nbDraws);
+        this->_segmentStarts.resize(nbDraws);
+    }
+    this->_segments.clear();
+    for (size_t i = 0; i < nbDraws; ++i)
+    {
+        if (!i || this->_segmentStarts[i] || this->_pages[i] != this->_pages[i - 1])
+            this->_segments.push_back((GLuint)i);
+    }
+
+    FrameRingBuffer &frameData = context.getFrameData();
+    this->_commandRange = frameData.upload(this->_commands.data(), nbDraws * sizeof(DrawElementsIndirectCommand));
+    this->_drawRange = frameData.upload(this->_draws.data(), nbDraws * sizeof(DrawData));
+    if (this->_commandRange.data && this->_drawRange.data)
+        return;
+
+    // The ring buffer is full for this frame, fall back to buffers of our own
+    if (nbDraws > this->_capacity)
+    {
+        // Grown by doubling, the old buffers may still be read by the previous frame so they are replaced
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_commandBuffer);
+        GPUMemoryTracker::getInstance()->untrack(GL_BUFFER, this->_drawBuffer);
+        glDeleteBuffers(1, &this->_commandBuffer);
+        glDeleteBuffers(1, &this->_drawBuffer);
+        this->_capacity = std::max(nbDraws, 2 * this->_capacity);
+        glCreateBuffers(1, &this->_commandBuffer);
+        glNamedBufferData(this->_commandBuffer, this->_capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        glCreateBuffers(1, &this->_drawBuffer);
+        glNamedBufferData(this->_drawBuffer, this->_capacity * sizeof(DrawData), nullptr, GL_STREAM_DRAW);
+        GPUMemoryTracker::getInstance()->track(GL_BUFFER, this->_commandBuffer, GPUMemoryCategory::UNIFORM_BUFFERS,
+                                               this->_capacity * sizeof(DrawElementsIndirectCommand), "indirect commands");
+        GPUMemoryTracker::getInstance()->track(GL_BUFFER, this->_drawBuffer, GPUMemoryCategory::UNIFORM_BUFFERS,
+                                               this->_capacity * sizeof(DrawData), "draw data");
+    }
+    glNamedBufferSubData(this->_commandBuffer, 0, nbDraws * sizeof(DrawElementsIndirectCommand), this->_commands.data());
+    glNamedBufferSubData(this->_drawBuffer, 0, nbDraws * sizeof(DrawData), this->_draws.data());
+    this->_commandRange = {this->_commandBuffer, 0, (GLsizeiptr)(nbDraws * sizeof(DrawElementsIndirectCommand)), nullptr};
+    this->_drawRange = {this->_drawBuffer, 0, (GLsizeiptr)(nbDraws * sizeof(DrawData)), nullptr};
+}
+
+void MultiDrawBuffer::cull(OpenGLContext &context, const glm::mat4 &viewProjection, bool occlusion)
+{
+    this->_culled = GPUCullResult();
+    GPUCuller &culler = context.getGPUCuller();
+    if (!culler.isEnabled() || this->_segments.empty())
+        return;
+    size_t nbDraws = this->_commands.size();
+    this->_cullData.resize(nbDraws);
+    size_t segment = 0;
+    for (size_t i = 0; i < nbDraws; ++i)
+    {
+        if (segment + 1 < this->_segments.size() && this->_segments[segment + 1] == i)
+            segment++;
+        CullData &data = this->_cullData[i];
+        AABB bounds = this->_bounds[i].transform(this->_draws[i].model);
+        data.boundsMin = bounds.min;
+        data.boundsMax = bounds.max;
+        data.segment = (GLuint)segment;
+        data.segmentStart = this->_segments[segment];
+    }
+    this->_culled = culler.cull(context, this->_commandRange, this->_cullData, this->_segments.size(), viewProjection, occlusion);
+}
+
+void MultiDrawBuffer::draw(OpenGLContext &context, size_t first, size_t count) const
+{
+    size_t end = std::min(first + count, this->_commands.size());
+    if (first >= end)
+        return;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAWS_BINDING, this->_drawRange.buffer, this->_drawRange.offset, this->_drawRange.size);
+    const GeometryPool &pool = context.getGeometryPool();
+
+    // Culled commands are packed at the front of their segment, ranges cutting a segment draw everything
+    auto segment = std::lower_bound(this->_segments.begin(), this->_segments.end(), (GLuint)first);
+    auto lastSegment = std::lower_bound(segment, this->_segments.end(), (GLuint)end);
+    bool aligned = segment != this->_segments.end() && *segment == first &&
+                   (lastSegment == this->_segments.end() ? end == this->_commands.size() : *lastSegment == end);
+    if (this->_culled.commandBuffer && aligned)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->_culled.commandBuffer);
+        if (GLExtensions::indirectParameters)
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, this->_culled.countBuffer);
+        for (; segment != lastSegment; ++segment)
+        {
+            size_t index = segment - this->_segments.begin();
+            size_t segmentEnd = segment + 1 == this->_segments.end() ? this->_commands.size() : *(segment + 1);
+            const void *commands = (const void *)(this->_culled.commandOffset + *segment * sizeof(DrawElementsIndirectCommand));
+            context.getState().bindVertexArray(pool.getVAO(this->_pages[*segment]));
+            if (GLExtensions::indirectParameters)
+                GLExtensions::glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, commands, this->_culled.countOffset + index * sizeof(GLuint),
+                                                                  (GLsizei)(segmentEnd - *segment), 0);
+            else
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, (GLsizei)(segmentEnd - *segment), 0);
+        }
+        return;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->_commandRange.buffer);
+    while (first < end)
+    {
+        size_t last = first + 1;
+        while (last < end && this->_pages[last] == this->_pages[first])
+            last++;
+        context.getState().bindVertexArray(pool.getVAO(this->_pages[first]));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                    (const void *)(this->_commandRange.offset + first * sizeof(DrawElementsIndirectCommand)),
+                                    (GLsizei)(last - first), 0);
+        first = last;
+    }
+}
+
+} // namespace leo
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <renderer/global.hpp>
+#include <renderer/frame-ring-buffer.hpp>
+#include <renderer/gpu-culler.hpp>
+
+#include <utils/bounds.hpp>
+
+#include <vector>
+
+namespace leo
+{
+
+class OpenGLContext;
+struct GeometryRange;
+
+typedef struct DrawElementsIndirectCommand
+{
+  GLuint count = 0;
+  GLuint instanceCount = 1;
+  GLuint firstIndex = 0;
+  GLint baseVertex = 0;
+  GLuint baseInstance = 0; // Index of the draw data, read back through the draw id attribute
+} DrawElementsIndirectCommand;
+
+typedef struct DrawData
+{
+  glm::mat4 model;
+  glm::mat3x4 normalMatrix; // Columns padded to vec4 like a std430 mat3
+  glm::uvec4 indices;       // x: material index, y: mask of the layers to render to (cube map faces)
+} DrawData;
+
+/* Per-draw data and indirect commands of one pass, drawn from the GeometryPool with glMultiDrawElementsIndirect.
+   * Draws are added in submission order then written once to the frame ring buffer, draw(first, count) issues
+   * one multi-draw per run of consecutive commands sharing a geometry page. Shaders read the draw data as the
+   * std430 array bound at DRAWS_BINDING, indexed by the draw id attribute. Buffers of its own are only created
+   * when the ring buffer is full.
+   * With the GPUCuller enabled, cull replaces the commands by the visible ones, compacted per segment. Segments
+   * are the runs of a page, also ended by split: the ranges given to draw must start and end on segments.
+   */
+class MultiDrawBuffer
+{
+public:
+  MultiDrawBuffer();
+  ~MultiDrawBuffer();
+  MultiDrawBuffer(const MultiDrawBuffer &other); // Copies start empty, GL buffers are never shared
+  MultiDrawBuffer &operator=(const MultiDrawBuffer &other);
+
+public:
+  void clear();
+  size_t add(const GeometryRange &range, const glm::mat4 &model, const glm::mat3 &normalMatrix = glm::mat3(), unsigned int materialIndex = 0,
+             unsigned int layerMask = 0);
+  void split(); // The next draw starts a new segment
+  void upload(OpenGLContext &context);
+  void cull(OpenGLContext &context, const glm::mat4 &viewProjection, bool occlusion);
+  void draw(OpenGLContext &context, size_t first, size_t count) const;
+  void draw(OpenGLContext &context) const { this->draw(context, 0, this->_commands.size()); }
+  size_t size() const { return this->_commands.size(); }
+
+public:
+  static const GLuint DRAWS_BINDING = 0;
+
+private:
+  std::vector<DrawElementsIndirectCommand> _commands;
+  std::vector<DrawData> _draws;
+  std::vector<unsigned int> _pages;
+  std::vector<AABB> _bounds;        // Of the geometry, in model space
+  std::vector<bool> _segmentStarts; // Draws following a split
+  std::vector<GLuint> _segments;    // First draw of each segment, built by upload
+  std::vector<CullData> _cullData;
+  bool _splitNext = false;
+  GPUCullResult _culled;
+  FrameAllocation _commandRange;
+  FrameAllocation _drawRange;
+  GLuint _commandBuffer = 0;
+  GLuint _drawBuffer = 0;
+  size_t _capacity = 0; // In draws, of both fallback buffers
+};
+
+} // namespace leo
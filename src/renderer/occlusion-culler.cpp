@@ -0,0 +1,279 @@
+#include <renderer/occlusion-culler.hpp>
+
+#include <model/entity.hpp>
+#include <model/components/volume.hpp>
+#include <model/components/transformation.hpp>
+
+#include <utils/thread-pool.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LEO_OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+namespace leo
+{
+
+namespace
+{
+
+glm::vec3 toScreen(const glm::vec4 &clip)
+{
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    return glm::vec3((ndc.x * 0.5f + 0.5f) * OcclusionCuller::WIDTH, (ndc.y * 0.5f + 0.5f) * OcclusionCuller::HEIGHT, ndc.z * 0.5f + 0.5f);
+}
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller() : _depth(WIDTH * HEIGHT, 1.f)
+{
+}
+
+void OcclusionCuller::update(const Entity &root, const glm::mat4 &viewProjection)
+{
+    this->clear(viewProjection);
+
+    // The biggest volumes hide the most
+    std::vector<const Entity *> occluders;
+    this->_collectOccluders(root, occluders);
+    auto size = [](const Entity *e) {
+        const AABB &bounds = e->getWorldBounds();
+        return glm::length(bounds.max - bounds.min);
+    };
+    std::sort(occluders.begin(), occluders.end(), [&size](const Entity *a, const Entity *b) { return size(a) > size(b); });
+    if (occluders.size() > MAX_OCCLUDERS)
+        occluders.resize(MAX_OCCLUDERS);
+
+    for (const Entity *e : occluders)
+    {
+        const Transformation *transformation = e->getEffectiveTransformation();
+        this->addOccluder(*static_cast<const Volume *>(e->getComponent(ComponentType::VOLUME)),
+                          transformation ? transformation->getTransformationMatrix() : glm::mat4());
+    }
+    this->rasterize();
+}
+
+void OcclusionCuller::clear(const glm::mat4 &viewProjection)
+{
+    this->_viewProjection = viewProjection;
+    this->_frustum = Frustum(viewProjection);
+    this->_triangles.clear();
+    this->_nbOccluders = 0;
+    std::fill(this->_depth.begin(), this->_depth.end(), 1.f);
+}
+
+void OcclusionCuller::addOccluder(const Volume &volume, const glm::mat4 &model)
+{
+    glm::mat4 matrix = this->_viewProjection * model;
+    const std::vector<Vertex> &vertices = volume.getVertices();
+    const std::vector<unsigned int> &indices = volume.getIndices();
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        glm::vec4 clip[3];
+        for (int j = 0; j < 3; ++j)
+            clip[j] = matrix * glm::vec4(vertices[indices[i + j]].position, 1.f);
+        // Triangles entirely outside one of the clip planes are dropped
+        bool outside = false;
+        for (int axis = 0; axis < 3 && !outside; ++axis)
+        {
+            outside = (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w) ||
+                      (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w);
+        }
+        if (!outside)
+            this->_addClippedTriangle(clip);
+    }
+    this->_nbOccluders++;
+}
+
+void OcclusionCuller::rasterize()
+{
+    // Bands of rows are independent, no synchronization is needed between them
+    ThreadPool::getInstance()->parallelFor(NB_BANDS, [this](size_t band) { this->_rasterizeBand((int)band); });
+}
+
+bool OcclusionCuller::isVisible(const AABB &box) const
+{
+    if (!this->_nbOccluders || box.isEmpty())
+        return true;
+
+    glm::vec2 minScreen(std::numeric_limits<float>::max());
+    glm::vec2 maxScreen(-std::numeric_limits<float>::max());
+    float minDepth = 1.f;
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+        glm::vec4 clip = this->_viewProjection * glm::vec4(corner, 1.f);
+        if (clip.z < -clip.w || clip.w <= 0.f)
+            return true; // Crosses the near plane
+        glm::vec3 screen = toScreen(clip);
+        minScreen = glm::min(minScreen, glm::vec2(screen));
+        maxScreen = glm::max(maxScreen, glm::vec2(screen));
+        minDepth = std::min(minDepth, screen.z);
+    }
+    minDepth -= DEPTH_BIAS;
+
+    int x0 = std::max(0, (int)std::floor(minScreen.x));
+    int x1 = std::min(WIDTH - 1, (int)std::floor(maxScreen.x));
+    int y0 = std::max(0, (int)std::floor(minScreen.y));
+    int y1 = std::min(HEIGHT - 1, (int)std::floor(maxScreen.y));
+    if (x0 > x1 || y0 > y1)
+        return true; // Off screen, left to the frustum test
+
+    // Visible as soon as one covered pixel has no occluder in front of the nearest point of the box
+    for (int y = y0; y <= y1; ++y)
+    {
+        const float *row = this->_depth.data() + y * WIDTH;
+#ifdef LEO_OCCLUSION_SSE
+        const __m128 depth = _mm_set1_ps(minDepth);
+        const __m128 first = _mm_set1_ps((float)x0);
+        const __m128 last = _mm_set1_ps((float)x1);
+        for (int x = x0 & ~3; x <= x1; x += 4)
+        {
+            __m128 xs = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.f, 2.f, 1.f, 0.f));
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(xs, first), _mm_cmple_ps(xs, last));
+            if (_mm_movemask_ps(_mm_and_ps(inside, _mm_cmpge_ps(_mm_loadu_ps(row + x), depth))))
+                return true;
+        }
+#else
+        for (int x = x0; x <= x1; ++x)
+        {
+            if (row[x] >= minDepth)
+                return true;
+        }
+#endif
+    }
+    return false;
+}
+
+void OcclusionCuller::_collectOccluders(const Entity &entity, std::vector<const Entity *> &occluders) const
+{
+    if (!entity.getSubtreeVolumeCount() || this->_frustum.test(entity.getSubtreeBounds()) == OUTSIDE_FRUSTUM)
+        return;
+    const IComponent *volume = entity.getComponent(ComponentType::VOLUME);
+    if (volume)
+    {
+        const AABB &bounds = entity.getWorldBounds();
+        if (glm::length(bounds.max - bounds.min) >= MIN_OCCLUDER_SIZE &&
+            static_cast<const Volume *>(volume)->getIndices().size() / 3 <= MAX_OCCLUDER_TRIANGLES &&
+            this->_frustum.test(bounds) != OUTSIDE_FRUSTUM)
+            occluders.push_back(&entity);
+    }
+    for (auto &child : entity.getChildren())
+        this->_collectOccluders(*child.second, occluders);
+}
+
+void OcclusionCuller::_addClippedTriangle(const glm::vec4 clip[3])
+{
+    // Against the near plane (z >= -w) only, the rasterizer clamps to the screen itself
+    glm::vec4 polygon[4];
+    int nbVertices = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const glm::vec4 &a = clip[i];
+        const glm::vec4 &b = clip[(i + 1) % 3];
+        float da = a.z + a.w;
+        float db = b.z + b.w;
+        if (da >= 0.f)
+            polygon[nbVertices++] = a;
+        if ((da >= 0.f) != (db >= 0.f))
+            polygon[nbVertices++] = a + (b - a) * (da / (da - db));
+    }
+    if (nbVertices < 3)
+        return;
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < nbVertices; ++i)
+        screen[i] = toScreen(polygon[i]);
+    for (int i = 1; i + 1 < nbVertices; ++i)
+    {
+        ScreenTriangle triangle;
+        triangle.vertices[0] = screen[0];
+        triangle.vertices[1] = screen[i];
+        triangle.vertices[2] = screen[i + 1];
+        this->_triangles.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::_rasterizeBand(int band)
+{
+    const int bandY0 = band * HEIGHT / NB_BANDS;
+    const int bandY1 = (band + 1) * HEIGHT / NB_BANDS - 1;
+    for (const ScreenTriangle &triangle : this->_triangles)
+    {
+        const glm::vec3 &v0 = triangle.vertices[0];
+        const glm::vec3 &v1 = triangle.vertices[1];
+        const glm::vec3 &v2 = triangle.vertices[2];
+        int x0 = std::max(0, (int)std::floor(std::min(v0.x, std::min(v1.x, v2.x))));
+        int x1 = std::min(WIDTH - 1, (int)std::floor(std::max(v0.x, std::max(v1.x, v2.x))));
+        int y0 = std::max(bandY0, (int)std::floor(std::min(v0.y, std::min(v1.y, v2.y))));
+        int y1 = std::min(bandY1, (int)std::floor(std::max(v0.y, std::max(v1.y, v2.y))));
+        if (x0 > x1 || y0 > y1)
+            continue;
+
+        // Edge functions a * x + b * y + c, each positive on the side of the opposite vertex
+        const glm::vec3 *v[3] = {&v0, &v1, &v2};
+        float a[3], b[3], c[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            const glm::vec3 &p = *v[(i + 1) % 3];
+            const glm::vec3 &q = *v[(i + 2) % 3];
+            a[i] = p.y - q.y;
+            b[i] = q.x - p.x;
+            c[i] = -(a[i] * p.x + b[i] * p.y);
+        }
+        float area = a[0] * v0.x + b[0] * v0.y + c[0];
+        if (std::fabs(area) < 1e-6f)
+            continue;
+        if (area < 0.f) // Both faces are rasterized
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                a[i] = -a[i];
+                b[i] = -b[i];
+                c[i] = -c[i];
+            }
+            area = -area;
+        }
+        // Depth is affine in screen space, as a plane built from the barycentric weights
+        float za = (v0.z * a[0] + v1.z * a[1] + v2.z * a[2]) / area;
+        float zb = (v0.z * b[0] + v1.z * b[1] + v2.z * b[2]) / area;
+        float zc = (v0.z * c[0] + v1.z * c[1] + v2.z * c[2]) / area;
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            float *row = this->_depth.data() + y * WIDTH;
+            float py = y + 0.5f;
+#ifdef LEO_OCCLUSION_SSE
+            const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            const __m128 zero = _mm_setzero_ps();
+            for (int x = x0 & ~3; x <= x1; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), px), _mm_set1_ps(b[0] * py + c[0]));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), px), _mm_set1_ps(b[1] * py + c[1]));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), px), _mm_set1_ps(b[2] * py + c[2]));
+                __m128 covered = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                if (!_mm_movemask_ps(covered))
+                    continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), _mm_set1_ps(zb * py + zc));
+                __m128 depth = _mm_loadu_ps(row + x);
+                __m128 closer = _mm_min_ps(depth, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(covered, closer), _mm_andnot_ps(covered, depth)));
+            }
+#else
+            for (int x = x0; x <= x1; ++x)
+            {
+                float px = x + 0.5f;
+                if (a[0] * px + b[0] * py + c[0] < 0.f || a[1] * px + b[1] * py + c[1] < 0.f || a[2] * px + b[2] * py + c[2] < 0.f)
+                    continue;
+                row[x] = std::min(row[x], za * px + zb * py + zc);
+            }
+#endif
+        }
+    }
+}
+
+} // namespace leo
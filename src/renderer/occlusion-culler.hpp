@@ -0,0 +1,64 @@
+#pragma once
+
+#include <utils/bounds.hpp>
+#include <utils/frustum.hpp>
+
+#include <renderer/global.hpp>
+
+#include <vector>
+
+namespace leo
+{
+
+class Entity;
+class Volume;
+
+typedef struct ScreenTriangle
+{
+  glm::vec3 vertices[3]; // Pixel coordinates and depth in [0, 1]
+} ScreenTriangle;
+
+/* Low resolution CPU depth buffer of the largest volumes of the scene, used to reject the objects
+   * they hide before they are drawn. Occluders are projected on the calling thread, then rasterized
+   * by bands of rows on the ThreadPool, four pixels at a time with SSE. Boxes are tested against the
+   * buffer with their nearest depth over the rectangle they cover.
+   * Coverage is sampled at the pixel centers, an object seen through a gap thinner than a pixel of
+   * the buffer may be rejected.
+   */
+class OcclusionCuller
+{
+public:
+  OcclusionCuller();
+
+public:
+  void update(const Entity &root, const glm::mat4 &viewProjection); // Picks the occluders and rasterizes them
+  void clear(const glm::mat4 &viewProjection);
+  void addOccluder(const Volume &volume, const glm::mat4 &model);
+  void rasterize();
+  bool isVisible(const AABB &box) const;
+  const std::vector<float> &getDepth() const { return this->_depth; }
+  unsigned int getNbOccluders() const { return this->_nbOccluders; }
+
+public:
+  static const int WIDTH = 240; // Multiple of 4, same aspect as the window
+  static const int HEIGHT = 160;
+  static const int NB_BANDS = 8;
+  static const unsigned int MAX_OCCLUDERS = 32;
+  static const unsigned int MAX_OCCLUDER_TRIANGLES = 1024;
+  static constexpr float MIN_OCCLUDER_SIZE = 2.f; // Smallest world space diagonal of an occluder
+  static constexpr float DEPTH_BIAS = 1e-5f;      // Keeps occluders from hiding themselves
+
+private:
+  void _collectOccluders(const Entity &entity, std::vector<const Entity *> &occluders) const;
+  void _addClippedTriangle(const glm::vec4 clip[3]);
+  void _rasterizeBand(int band);
+
+private:
+  glm::mat4 _viewProjection;
+  Frustum _frustum;
+  std::vector<ScreenTriangle> _triangles;
+  std::vector<float> _depth; // Row major, bottom row first
+  unsigned int _nbOccluders = 0;
+};
+
+} // namespace leo
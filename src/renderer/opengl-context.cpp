@@ -1,20 +1,36 @@
 #include <renderer/opengl-context.hpp>
 
 #include <renderer/debug.hpp>
+#include <renderer/gl-extensions.hpp>
 #include <renderer/input-manager.hpp>
 #include <renderer/framebuffer.hpp>
+#include <renderer/gpu-memory-tracker.hpp>
 
 #include <model/components/volume.hpp>
 #include <model/cube-map.hpp>
 
 #include <utils/texture.hpp>
 
+#include <cstddef>
 #include <iostream>
 
 namespace leo
 {
 
-OpenGLContext::OpenGLContext()
+namespace
+{
+
+typedef struct InstanceData
+{
+    glm::mat4 model;
+    glm::mat3x4 normalMatrix; // Inverse transpose of model, computed once instead of per vertex
+} InstanceData;
+
+const GLuint INSTANCE_NORMAL_MATRIX_LOCATION = 9; // Past the draw id of the geometry pool
+
+} // namespace
+
+OpenGLContext::OpenGLContext() : _resourceCache(*this), _geometryPool(*this)
 {
 }
 
@@ -31,17 +47,19 @@ void OpenGLContext::init(const OpenGLContextOptions &options)
         return;
     }
     std::cerr << "GLAD initialized succesfully" << std::endl;
+    GLExtensions::load();
+    this->getState().reset();
 
     // Define the viewport dimensions
-    glClearColor(0.07, 0.07, 0.07, 1);
+    this->getState().clearColor(0.07, 0.07, 0.07, 1);
 
     // Setup some OpenGL options
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL); // Set to always pass the depth test (same effect as glDisable(GL_DEPTH_TEST))
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    this->getState().enable(GL_DEPTH_TEST);
+    this->getState().depthFunc(GL_LEQUAL); // Set to always pass the depth test (same effect as glDisable(GL_DEPTH_TEST))
+    this->getState().enable(GL_BLEND);
+    this->getState().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    this->getState().enable(GL_CULL_FACE);
+    this->getState().cullFace(GL_BACK);
 
     // Set up debugging
     GLint flags;
@@ -73,7 +91,7 @@ void OpenGLContext::generateBufferCollection(BufferCollection &bc, const Volume
     const std::vector<Vertex> &vertices = volume.getVertices();
     const std::vector<GLuint> &indices = volume.getIndices();
 
-    glBindVertexArray(bc.VAO);
+    this->getState().bindVertexArray(bc.VAO);
     glBindBuffer(GL_ARRAY_BUFFER, bc.VBO);
 
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
@@ -103,6 +121,10 @@ void OpenGLContext::generateBufferCollection(BufferCollection &bc, const Volume
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bc.EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
                  &indices[0], GL_STATIC_DRAW);
+
+    std::string label = "volume " + std::to_string(volume.getId());
+    GPUMemoryTracker::getInstance()->track(GL_BUFFER, bc.VBO, GPUMemoryCategory::VERTEX_BUFFERS, vertices.size() * sizeof(Vertex), label);
+    GPUMemoryTracker::getInstance()->track(GL_BUFFER, bc.EBO, GPUMemoryCategory::INDEX_BUFFERS, indices.size() * sizeof(GLuint), label);
 }
 
 void OpenGLContext::generateBufferCollectionInstanced(BufferCollection &bc, const Volume &volume, GLuint transformationsVBO)
@@ -112,51 +134,54 @@ void OpenGLContext::generateBufferCollectionInstanced(BufferCollection &bc, cons
 
     unsigned int VAO = bc.VAO;
 
-    glBindVertexArray(VAO);
+    this->getState().bindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, transformationsVBO);
     // vertex Attributes
     GLsizei vec4Size = sizeof(glm::vec4);
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void *)0);
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void *)(vec4Size));
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void *)(2 * vec4Size));
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void *)(3 * vec4Size));
-
-    glVertexAttribDivisor(3, 1);
-    glVertexAttribDivisor(4, 1);
-    glVertexAttribDivisor(5, 1);
-    glVertexAttribDivisor(6, 1);
+    for (GLuint i = 0; i < 4; ++i)
+    {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(offsetof(InstanceData, model) + i * vec4Size));
+        glVertexAttribDivisor(3 + i, 1);
+    }
+    for (GLuint i = 0; i < 3; ++i)
+    {
+        GLuint location = INSTANCE_NORMAL_MATRIX_LOCATION + i;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(offsetof(InstanceData, normalMatrix) + i * vec4Size));
+        glVertexAttribDivisor(location, 1);
+    }
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    this->getState().bindVertexArray(0);
 }
 
 GLuint OpenGLContext::generateInstancingVBO(const std::vector<glm::mat4> &transformations)
 {
+    std::vector<InstanceData> instances(transformations.size());
+    for (size_t i = 0; i < transformations.size(); ++i)
+    {
+        instances[i].model = transformations[i];
+        instances[i].normalMatrix = glm::mat3x4(glm::transpose(glm::inverse(glm::mat3(transformations[i]))));
+    }
     GLuint VBO = 0;
     glGenBuffers(1, &VBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, transformations.size() * sizeof(glm::mat4), &transformations[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GPUMemoryTracker::getInstance()->track(GL_BUFFER, VBO, GPUMemoryCategory::VERTEX_BUFFERS,
+                                           instances.size() * sizeof(InstanceData), "instancing transformations");
     return VBO;
 }
 
 void OpenGLContext::_loadBuffers(const BufferCollection &bc)
 {
-    glBindVertexArray(bc.VAO);
+    this->getState().bindVertexArray(bc.VAO);
 }
 
 t_id OpenGLContext::getTextureWrapperId(const Texture &texture)
 {
-    auto it = this->_textures.find(texture.getId());
-    if (it == this->_textures.end())
-    {
-        it = this->_textures.insert(std::pair<t_id, TextureWrapper>(texture.getId(), texture)).first;
-    }
-    return it->second.getId();
+    return this->_resourceCache.acquireTexture(texture, GPUResourceCache::FRAME_OWNER, TextureWrapper::getDefaultOptions(texture)).getId();
 }
 
 void OpenGLContext::loadFramebuffer(const Framebuffer *fb, GLuint bindingType)
@@ -167,24 +192,13 @@ void OpenGLContext::loadFramebuffer(const Framebuffer *fb, GLuint bindingType)
     }
     else
     {
-        glBindFramebuffer(bindingType, 0);
+        this->getState().bindFramebuffer(bindingType, 0);
     }
 }
 
 GLuint OpenGLContext::loadCubeMap(const CubeMap &cubeMap)
 {
-    const Texture &texture = *cubeMap.getTextures()[0];
-    auto it = this->_textures.find(cubeMap.getTextures()[0]->getId());
-    if (it == this->_textures.end())
-    {
-        TextureOptions options;
-        GLTextureOptions glOptions;
-        glOptions.textureType = GL_TEXTURE_CUBE_MAP;
-        glOptions.wrapping = GL_CLAMP_TO_EDGE;
-        TextureWrapper &tw = this->_textures.insert(
-                                                std::pair<t_id, TextureWrapper>(texture.getId(), TextureWrapper(cubeMap.getTextures(), glOptions, options)))
-                                 .first->second;
-    }
+    this->getCubeMapTextureId(cubeMap);
 
     BufferCollection &bc = this->_cubeMapBuffer;
     if (bc.VAO == 0)
@@ -193,18 +207,27 @@ GLuint OpenGLContext::loadCubeMap(const CubeMap &cubeMap)
         glGenVertexArrays(1, &bc.VAO);
         glGenBuffers(1, &bc.VBO);
 
-        glBindVertexArray(bc.VAO);
+        this->getState().bindVertexArray(bc.VAO);
         glBindBuffer(GL_ARRAY_BUFFER, bc.VBO);
 
         const std::vector<float> &vertices = cubeMap.getVertices();
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
+        GPUMemoryTracker::getInstance()->track(GL_BUFFER, bc.VBO, GPUMemoryCategory::VERTEX_BUFFERS, vertices.size() * sizeof(float), "skybox");
     }
 
     return bc.VAO;
 }
 
+GLuint OpenGLContext::getCubeMapTextureId(const CubeMap &cubeMap)
+{
+    GLTextureOptions glOptions;
+    glOptions.textureType = GL_TEXTURE_CUBE_MAP;
+    glOptions.wrapping = GL_CLAMP_TO_EDGE;
+    return this->_resourceCache.acquireCubeMap(cubeMap.getTextures(), GPUResourceCache::FRAME_OWNER, glOptions).getId();
+}
+
 void OpenGLContext::drawVolume(const Volume &volume, const BufferCollection &bc)
 {
     this->_loadBuffers(bc);
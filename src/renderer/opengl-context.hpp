@@ -3,6 +3,11 @@
 #include <renderer/global.hpp>
 
 #include <renderer/buffer-collection.hpp>
+#include <renderer/frame-ring-buffer.hpp>
+#include <renderer/geometry-pool.hpp>
+#include <renderer/gl-state-cache.hpp>
+#include <renderer/gpu-culler.hpp>
+#include <renderer/gpu-resource-cache.hpp>
 #include <renderer/texture-wrapper.hpp>
 
 #include <map>
@@ -36,11 +41,18 @@ public:
   t_id getTextureWrapperId(const Texture &texture);
   void loadFramebuffer(const Framebuffer *fb = nullptr, GLuint bindingType = GL_FRAMEBUFFER);
   GLuint loadCubeMap(const CubeMap &cubeMap);
+  GLuint getCubeMapTextureId(const CubeMap &cubeMap);
   void drawVolume(const Volume &volume, const BufferCollection &bc);
   void drawVolumeInstanced(const Volume &volume, const BufferCollection &bc, int amount);
   void generateBufferCollection(BufferCollection &bc, const Volume &volume);
   void generateBufferCollectionInstanced(BufferCollection &bc, const Volume &volume, GLuint transformationsVBO);
   GLuint generateInstancingVBO(const std::vector<glm::mat4> &transformations);
+  GPUResourceCache &getResourceCache() { return this->_resourceCache; }
+  GeometryPool &getGeometryPool() { return this->_geometryPool; }
+  FrameRingBuffer &getFrameData() { return this->_frameData; }
+  GPUCuller &getGPUCuller() { return this->_gpuCuller; }
+  const GPUCuller &getGPUCuller() const { return this->_gpuCuller; }
+  GLStateCache &getState() { return *GLStateCache::getInstance(); } // Shared with Shader, Framebuffer and TextureWrapper
 
 public:
   OpenGLContext(OpenGLContext const &) = delete;
@@ -50,9 +62,10 @@ private:
   void _loadBuffers(const BufferCollection &bc);
 
 private:
-  std::map<t_id, BufferCollection> _bufferCollections;
-  std::map<t_id, BufferCollection> _bufferCollectionsInstanced;
-  std::map<t_id, TextureWrapper> _textures;
+  GPUResourceCache _resourceCache;
+  GeometryPool _geometryPool; // Static scene geometry, drawn with multi-draw indirect
+  FrameRingBuffer _frameData;
+  GPUCuller _gpuCuller;
   BufferCollection _cubeMapBuffer;
 };
 
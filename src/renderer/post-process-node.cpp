@@ -29,10 +29,10 @@ void PostProcessNode::render()
     this->_loadInputFramebuffers();
     this->_loadOutputFramebuffer();
     glClear(GL_COLOR_BUFFER_BIT);
-    glDisable(GL_DEPTH_TEST);
+    this->_context.getState().disable(GL_DEPTH_TEST);
 
     this->_context.drawVolume(*this->_postProcessGeometry,
-                              this->_sceneContext.bufferCollections.find(this->_postProcessGeometry->getId())->second);
+                              this->_sceneContext.getBufferCollection(*this->_postProcessGeometry));
 }
 
 void PostProcessNode::notified(Subject *subject, Event event)
@@ -0,0 +1,315 @@
+#include "program-cache.hpp"
+
+#include <renderer/gl-extensions.hpp>
+#include <renderer/gl-state-cache.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace leo
+{
+
+namespace
+{
+
+typedef struct ProgramBinaryHeader
+{
+  char magic[4] = {'L', 'P', 'G', 'B'};
+  uint64_t driverHash = 0;
+  uint32_t format = 0;
+  uint32_t size = 0;
+} ProgramBinaryHeader;
+
+} // namespace
+
+const char *ProgramCache::CACHE_DIRECTORY = "resources/shader-cache";
+
+std::shared_ptr<ProgramCache> ProgramCache::_instance = std::shared_ptr<ProgramCache>(nullptr);
+
+ProgramCache::ProgramCache()
+{
+}
+
+ProgramCache *ProgramCache::getInstance()
+{
+  if (!_instance)
+    _instance = std::shared_ptr<ProgramCache>(new ProgramCache());
+  return _instance.get();
+}
+
+GLuint ProgramCache::getProgram(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+{
+  return this->finishProgram(this->requestProgram(vertexCode, fragmentCode, geometryCode));
+}
+
+GLuint ProgramCache::requestProgram(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+{
+  // NUL never appears in the sources, it keeps "ab" + "c" and "a" + "bc" apart
+  const std::string separator(1, '\0');
+  t_hash key = hash(geometryCode, hash(separator, hash(fragmentCode, hash(separator, hash(vertexCode)))));
+  auto it = this->_programs.find(key);
+  if (it != this->_programs.end())
+    return it->second;
+
+  GLuint program = this->_loadBinary(key);
+  if (!program)
+    program = this->_submitProgram(key, vertexCode, fragmentCode, geometryCode);
+  this->_programs.insert(std::pair<t_hash, GLuint>(key, program));
+  return program;
+}
+
+GLuint ProgramCache::getComputeProgram(const std::string &computeCode)
+{
+  // Seeded apart from the graphics programs, a compute source is never mistaken for a vertex one
+  t_hash key = hash(computeCode, hash("compute"));
+  auto it = this->_programs.find(key);
+  if (it != this->_programs.end())
+    return it->second;
+
+  GLuint program = this->_loadBinary(key);
+  if (!program)
+  {
+    PendingProgram pending;
+    pending.key = key;
+    pending.shaders[0] = _submitShader(computeCode, GL_COMPUTE_SHADER);
+    program = glCreateProgram();
+    glAttachShader(program, pending.shaders[0]);
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    this->_pending.insert(std::pair<GLuint, PendingProgram>(program, pending));
+  }
+  this->_programs.insert(std::pair<t_hash, GLuint>(key, program));
+  return this->finishProgram(program);
+}
+
+bool ProgramCache::isProgramReady(GLuint program) const
+{
+  if (!program || this->_pending.find(program) == this->_pending.end())
+    return true;
+  if (!GLExtensions::parallelShaderCompile)
+    return true; // Querying would block anyway
+  GLint done = GL_FALSE;
+  glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+  return done == GL_TRUE;
+}
+
+GLuint ProgramCache::finishProgram(GLuint program)
+{
+  auto it = this->_pending.find(program);
+  if (it == this->_pending.end())
+    return program;
+  PendingProgram pending = it->second;
+  this->_pending.erase(it);
+
+  // Blocks until the driver is done with the program
+  GLint success;
+  GLchar infoLog[512];
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success)
+  {
+    for (GLuint shader : pending.shaders)
+    {
+      if (shader)
+        _logShaderErrors(shader);
+    }
+    glGetProgramInfoLog(program, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
+              << infoLog << std::endl;
+  }
+
+  for (GLuint shader : pending.shaders)
+  {
+    if (!shader)
+      continue;
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+  }
+
+  if (!success)
+  {
+    glDeleteProgram(program);
+    this->_programs[pending.key] = 0;
+    return 0;
+  }
+  this->_saveBinary(pending.key, program);
+  return program;
+}
+
+UniformTable *ProgramCache::getUniformTable(GLuint program)
+{
+  if (!program)
+    return nullptr;
+  auto it = this->_uniformTables.find(program);
+  if (it == this->_uniformTables.end())
+    it = this->_uniformTables.insert(std::pair<GLuint, std::unique_ptr<UniformTable>>(program, std::unique_ptr<UniformTable>(new UniformTable(program)))).first;
+  return it->second.get();
+}
+
+void ProgramCache::clear()
+{
+  this->_uniformTables.clear();
+  for (auto &p : this->_pending)
+  {
+    for (GLuint shader : p.second.shaders)
+      glDeleteShader(shader);
+  }
+  this->_pending.clear();
+  for (auto &p : this->_programs)
+  {
+    GLStateCache::getInstance()->forgetProgram(p.second);
+    glDeleteProgram(p.second);
+  }
+  this->_programs.clear();
+}
+
+ProgramCache::t_hash ProgramCache::hash(const std::string &data, t_hash seed)
+{
+  // FNV-1a
+  t_hash h = seed;
+  for (unsigned char c : data)
+  {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+GLuint ProgramCache::_submitProgram(t_hash key, const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+{
+  // No status query here, it would wait for the compilation to end
+  PendingProgram pending;
+  pending.key = key;
+  pending.shaders[0] = _submitShader(vertexCode, GL_VERTEX_SHADER);
+  pending.shaders[1] = _submitShader(fragmentCode, GL_FRAGMENT_SHADER);
+  pending.shaders[2] = geometryCode.size() ? _submitShader(geometryCode, GL_GEOMETRY_SHADER) : 0;
+
+  GLuint program = glCreateProgram();
+  for (GLuint shader : pending.shaders)
+  {
+    if (shader)
+      glAttachShader(program, shader);
+  }
+  glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(program);
+  this->_pending.insert(std::pair<GLuint, PendingProgram>(program, pending));
+  return program;
+}
+
+GLuint ProgramCache::_loadBinary(t_hash key)
+{
+  t_hash driverHash = this->_getDriverHash();
+  if (!this->_binariesSupported)
+    return 0;
+
+  std::ifstream ifs(this->_getBinaryPath(key), std::ios::binary);
+  if (!ifs.is_open())
+    return 0;
+
+  ProgramBinaryHeader header;
+  ProgramBinaryHeader expected;
+  ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!ifs || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) || header.driverHash != driverHash)
+    return 0;
+
+  std::vector<char> binary(header.size);
+  ifs.read(binary.data(), header.size);
+  if (!ifs)
+    return 0;
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success)
+  { // The driver may reject binaries for reasons we cannot detect beforehand
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void ProgramCache::_saveBinary(t_hash key, GLuint program)
+{
+  ProgramBinaryHeader header;
+  header.driverHash = this->_getDriverHash();
+  if (!this->_binariesSupported)
+    return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, nullptr, &format, binary.data());
+  header.format = format;
+  header.size = (uint32_t)length;
+
+  std::error_code error;
+  std::filesystem::create_directories(CACHE_DIRECTORY, error);
+  std::ofstream ofs(this->_getBinaryPath(key), std::ios::binary);
+  if (!ofs.is_open())
+  {
+    std::cerr << "ProgramCache: Cannot write program binary " << this->_getBinaryPath(key) << std::endl;
+    return;
+  }
+  ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  ofs.write(binary.data(), binary.size());
+}
+
+std::string ProgramCache::_getBinaryPath(t_hash key) const
+{
+  std::stringstream ss;
+  ss << CACHE_DIRECTORY << "/" << std::hex << key << ".bin";
+  return ss.str();
+}
+
+ProgramCache::t_hash ProgramCache::_getDriverHash()
+{
+  if (this->_driverQueried)
+    return this->_driverHash;
+  this->_driverQueried = true;
+
+  GLint nbFormats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbFormats);
+  this->_binariesSupported = nbFormats > 0;
+
+  // Binaries are only valid for the exact driver that produced them
+  t_hash h = hash("");
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION})
+  {
+    const GLubyte *value = glGetString(name);
+    h = hash(value ? reinterpret_cast<const char *>(value) : "", h);
+    h = hash("|", h);
+  }
+  this->_driverHash = h;
+  return h;
+}
+
+GLuint ProgramCache::_submitShader(const std::string &code, GLenum shaderType)
+{
+  const GLchar *shaderCode = code.c_str();
+  GLuint shader = glCreateShader(shaderType);
+  glShaderSource(shader, 1, &shaderCode, NULL);
+  glCompileShader(shader);
+  return shader;
+}
+
+void ProgramCache::_logShaderErrors(GLuint shader)
+{
+  GLint success;
+  GLchar infolog[512];
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success)
+  {
+    glGetShaderInfoLog(shader, 512, NULL, infolog);
+    std::cout << "ERROR::PROGRAM::COMPILE::COMPILATION_FAILED\n"
+              << infolog << std::endl;
+  }
+}
+
+} // namespace leo
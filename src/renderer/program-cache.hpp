@@ -0,0 +1,73 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <renderer/uniform-table.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace leo
+{
+
+/* Links each distinct set of shader sources once per run and shares the resulting program.
+   * Linked programs are also saved as driver binaries under CACHE_DIRECTORY. A binary is only reused
+   * when it was produced by the same driver, otherwise the program is compiled from source again.
+   * requestProgram only submits the compilation: with parallel shader compilation the driver builds
+   * the programs in the background, isProgramReady polls them and finishProgram waits for one.
+   */
+class ProgramCache
+{
+
+  using t_hash = uint64_t;
+
+public:
+  static ProgramCache *getInstance();
+
+public:
+  GLuint getProgram(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode);
+  GLuint requestProgram(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode);
+  bool isProgramReady(GLuint program) const;
+  GLuint finishProgram(GLuint program);
+  GLuint getComputeProgram(const std::string &computeCode);
+  UniformTable *getUniformTable(GLuint program);
+  void clear();
+
+public:
+  static t_hash hash(const std::string &data, t_hash seed = 14695981039346656037ULL);
+
+public:
+  static const char *CACHE_DIRECTORY;
+
+private:
+  ProgramCache();
+  GLuint _submitProgram(t_hash key, const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode);
+  GLuint _loadBinary(t_hash key);
+  void _saveBinary(t_hash key, GLuint program);
+  std::string _getBinaryPath(t_hash key) const;
+  t_hash _getDriverHash();
+  static GLuint _submitShader(const std::string &code, GLenum shaderType);
+  static void _logShaderErrors(GLuint shader);
+
+private:
+  typedef struct PendingProgram
+  {
+    t_hash key = 0;
+    GLuint shaders[3] = {0, 0, 0};
+  } PendingProgram;
+
+private:
+  static std::shared_ptr<ProgramCache> _instance;
+
+private:
+  std::map<t_hash, GLuint> _programs;
+  std::map<GLuint, PendingProgram> _pending; // Submitted, link status not checked yet
+  std::map<GLuint, std::unique_ptr<UniformTable>> _uniformTables; // Shared by the shaders using the program
+  t_hash _driverHash = 0;
+  bool _binariesSupported = false;
+  bool _driverQueried = false;
+};
+
+} // namespace leo
@@ -21,15 +21,18 @@ void RenderNode::_loadShader()
 {
 }
 
+Shader &RenderNode::_getShader()
+{
+    return this->_shader;
+}
+
 void RenderNode::_loadInputFramebuffers()
 {
     int inputNumber = 0;
     for (const auto &p : this->_inputs)
     {
         const TextureWrapper &input = p.second;
-        glUniform1i(glGetUniformLocation(this->_shader.getProgram(), p.first.c_str()), inputNumber);
-        glActiveTexture(GL_TEXTURE0 + inputNumber);
-        glBindTexture(GL_TEXTURE_2D, input.getId());
+        this->_getShader().setTexture(p.first.c_str(), input.getId(), inputNumber);
         inputNumber++;
     }
     this->_materialTextureOffset = inputNumber;
@@ -42,7 +45,12 @@ void RenderNode::_loadOutputFramebuffer()
 
 void RenderNode::_loadTextureToShader(const char *uniformName, GLuint textureSlot, const Texture &texture)
 {
-    this->_shader.setTexture(uniformName, this->_sceneContext.textures.find(texture.getId())->second.getId(), textureSlot);
+    this->_loadTextureToShader(this->_getShader().getUniform(uniformName), textureSlot, texture);
+}
+
+void RenderNode::_loadTextureToShader(int uniform, GLuint textureSlot, const Texture &texture)
+{
+    this->_getShader().setTexture(uniform, this->_context.getTextureWrapperId(texture), textureSlot);
 }
 
 void RenderNode::setOptions(RenderNodeOptions options)
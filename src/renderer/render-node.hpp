@@ -4,6 +4,8 @@
 #include <controller/observer.hpp>
 #include <renderer/render-node-options.hpp>
 
+#include <utils/frustum.hpp>
+
 #include <map>
 
 #include <renderer/global.hpp>
@@ -30,19 +32,23 @@ public:
 
 protected:
   virtual void _loadShader();
+  virtual Shader &_getShader(); // Program the uniforms are uploaded to
   void _loadTextureToShader(const char *uniformName, GLuint textureSlot, const Texture &texture);
+  void _loadTextureToShader(int uniform, GLuint textureSlot, const Texture &texture);
   virtual void _loadOutputFramebuffer();
   virtual void _loadInputFramebuffers();
 
 public:
   void setOptions(RenderNodeOptions options);
   const RenderNodeOptions &getOptions() const;
+  const CullStats &getCullStats() const { return this->_cullStats; } // Of the last render
 
 protected:
   Shader &_shader;
   GLuint _materialTextureOffset = 0;
   RenderNodeOptions _options;
   SceneContext &_sceneContext;
+  CullStats _cullStats;
 
 };
 
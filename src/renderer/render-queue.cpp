@@ -0,0 +1,67 @@
+#include "render-queue.hpp"
+
+#include <algorithm>
+
+namespace leo
+{
+
+void RenderQueue::clear()
+{
+  this->_items.clear();
+}
+
+void RenderQueue::push(const DrawItem &item)
+{
+  this->_items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+  size_t nbItems = this->_items.size();
+  if (nbItems < 2)
+    return;
+
+  this->_entries.resize(nbItems);
+  this->_swap.resize(nbItems);
+  for (size_t i = 0; i < nbItems; ++i)
+    this->_entries[i] = {this->_items[i].key, (uint32_t)i};
+
+  // LSD radix sort on bytes, stable so equal keys keep their traversal order
+  SortEntry *src = this->_entries.data();
+  SortEntry *dst = this->_swap.data();
+  for (unsigned int shift = 0; shift < 64; shift += 8)
+  {
+    size_t counts[256] = {0};
+    for (size_t i = 0; i < nbItems; ++i)
+      counts[(src[i].key >> shift) & 0xff]++;
+    if (counts[(src[0].key >> shift) & 0xff] == nbItems)
+      continue; // Every key has the same byte, nothing to reorder
+    size_t offset = 0;
+    for (size_t &count : counts)
+    {
+      size_t c = count;
+      count = offset;
+      offset += c;
+    }
+    for (size_t i = 0; i < nbItems; ++i)
+      dst[counts[(src[i].key >> shift) & 0xff]++] = src[i];
+    std::swap(src, dst);
+  }
+
+  this->_sortedItems.resize(nbItems);
+  for (size_t i = 0; i < nbItems; ++i)
+    this->_sortedItems[i] = this->_items[src[i].index];
+  std::swap(this->_items, this->_sortedItems);
+}
+
+uint64_t RenderQueue::makeKey(unsigned int pass, unsigned int variant, unsigned int material, unsigned int vao, float depth)
+{
+  uint64_t quantizedDepth = (uint64_t)(std::min(std::max(depth, 0.f), 1.f) * 0xffff);
+  return ((uint64_t)(pass & 0xf) << 60) |
+         ((uint64_t)(variant & 0xfff) << 48) |
+         ((uint64_t)(material & 0xffff) << 32) |
+         ((uint64_t)(vao & 0xffff) << 16) |
+         quantizedDepth;
+}
+
+} // namespace leo
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace leo
+{
+
+class Volume;
+class Material;
+
+typedef struct DrawItem
+{
+  uint64_t key = 0;
+  const Volume *volume = nullptr;
+  const Material *material = nullptr;
+  glm::mat4 matrix;       // World transformation
+  glm::mat3 normalMatrix; // Inverse transpose of the world transformation
+} DrawItem;
+
+/* Draws collected by a render node during its traversal, submitted once sorted by key.
+   * From the most to the least significant bits, a key holds the pass (4 bits), the shader variant (12),
+   * the material (16), the VAO (16) and the quantized depth (16), so that program, material and VAO
+   * switches are minimized and draws sharing all of them go front to back for early depth rejection.
+   */
+class RenderQueue
+{
+public:
+  void clear();
+  void push(const DrawItem &item);
+  void sort();
+  const std::vector<DrawItem> &getItems() const { return this->_items; }
+  size_t size() const { return this->_items.size(); }
+
+public:
+  static uint64_t makeKey(unsigned int pass, unsigned int variant, unsigned int material, unsigned int vao, float depth);
+
+private:
+  typedef struct SortEntry
+  {
+    uint64_t key;
+    uint32_t index;
+  } SortEntry;
+
+private:
+  std::vector<DrawItem> _items;
+  std::vector<DrawItem> _sortedItems;
+  // Kept between frames so that sorting does not allocate once the queue reached its usual size
+  std::vector<SortEntry> _entries;
+  std::vector<SortEntry> _swap;
+};
+
+} // namespace leo
@@ -13,6 +13,8 @@
 #include <renderer/instanced-node.hpp>
 #include <renderer/shadow-mapping-node.hpp>
 #include <renderer/light-wrapper.hpp>
+#include <renderer/gpu-memory-tracker.hpp>
+#include <renderer/shader-features.hpp>
 
 #include <model/scene-graph.hpp>
 #include <model/cube-map.hpp>
@@ -46,7 +48,8 @@ Renderer::Renderer(GLFWwindow *window,
                                              _sceneContext(this->_context),
                                              _extractCapedBrightnessShader("resources/shaders/post-process.vs.glsl", "resources/shaders/extract-caped-brightness.frag.glsl"),
                                              _hdrCorrectionShader("resources/shaders/post-process.vs.glsl", "resources/shaders/hdr-correction.frag.glsl"),
-                                             _bloomEffectShader("resources/shaders/post-process.vs.glsl", "resources/shaders/bloom-effect.frag.glsl")
+                                             _bloomEffectShader("resources/shaders/post-process.vs.glsl", "resources/shaders/bloom-effect.frag.glsl"),
+                                             _blurShader("resources/shaders/post-process.vs.glsl", "resources/shaders/blur.frag.glsl")
 
 {
   this->_sceneGraph.watch(this);
@@ -70,6 +73,15 @@ void Renderer::_init()
 
 void Renderer::_initFramebuffers()
 {
+  this->_main.setName("main");
+  this->_gBuffer.setName("gBuffer");
+  this->_multisampled.setName("multisampled");
+  this->_postProcess.setName("postProcess");
+  this->_extractCapedBrightnessFB.setName("extractCapedBrightness");
+  this->_hdrCorrectionFB.setName("hdrCorrection");
+  this->_blurFB.setName("blur");
+  this->_bloomEffectFB.setName("bloomEffect");
+
   this->_main.addColorBuffer({true});
   this->_main.useRenderBuffer();
 
@@ -101,6 +113,8 @@ void Renderer::_initFramebuffers()
 
   this->_bloomEffectFB.addColorBuffer({true});
   this->_bloomEffectFB.useRenderBuffer();
+
+  this->_sceneContext.shadowAtlas.init(SceneContext::SHADOW_ATLAS_BUDGET);
 }
 
 void Renderer::_setWindowContext(GLFWwindow *window, InputManager *inputManager)
@@ -149,12 +163,14 @@ void Renderer::_registerComponent(const IComponent &component)
   {
   case ComponentType::DIRECTION_LIGHT:
   {
+    this->_prepareShader(this->_shadowMappingShader);
     this->_sceneContext.registerDirectionLight(*static_cast<const DirectionLight *>(&component),
                                                this->_sceneGraph, this->_shadowMappingShader);
   }
   break;
   case ComponentType::POINT_LIGHT:
   {
+    this->_prepareShader(this->_cubeShadowMapShader);
     this->_sceneContext.registerPointLight(*static_cast<const PointLight *>(&component),
                                            this->_sceneGraph, this->_cubeShadowMapShader);
   }
@@ -166,10 +182,13 @@ void Renderer::_registerComponent(const IComponent &component)
   case ComponentType::MATERIAL:
   {
     this->_sceneContext.registerMaterial(*static_cast<const Material *>(&component));
+    this->_materialFeatures.insert(ShaderFeatures::fromMaterial(*static_cast<const Material *>(&component)));
   }
   break;
   case ComponentType::TRANSFORMATION:
   {
+    if (component.getEntity())
+      this->_sceneContext.trackShadowCaster(*component.getEntity());
   }
   break;
   case ComponentType::VOLUME:
@@ -182,8 +201,80 @@ void Renderer::_registerComponent(const IComponent &component)
   }
 }
 
+void Renderer::_unregisterComponent(const IComponent &component)
+{
+  switch (component.getTypeId())
+  {
+  case ComponentType::MATERIAL:
+  {
+    this->_sceneContext.unregisterMaterial(*static_cast<const Material *>(&component));
+  }
+  break;
+  case ComponentType::VOLUME:
+  {
+    this->_sceneContext.unregisterVolume(*static_cast<const Volume *>(&component));
+  }
+  break;
+  default:
+    break;
+  }
+}
+
+void Renderer::_prepareShader(Shader &shader)
+{
+  if (shader.isReady())
+    return;
+  this->_pendingShaders.push_back(&shader);
+  this->_shadersReady = false;
+}
+
+void Renderer::_prepareVariants(const MainNode &node, Shader &shader)
+{
+  // One variant per kind of material of the scene, plus the default material
+  Material defaultMat;
+  this->_materialFeatures.insert(ShaderFeatures::fromMaterial(defaultMat));
+  for (Shader::t_features features : this->_materialFeatures)
+    this->_prepareShader(shader.getVariant(node.getPassFeatures() | features));
+}
+
+bool Renderer::_pollShaders()
+{
+  auto it = this->_pendingShaders.begin();
+  while (it != this->_pendingShaders.end())
+  {
+    if ((*it)->isReady())
+      it = this->_pendingShaders.erase(it);
+    else
+      ++it;
+  }
+  return this->_pendingShaders.empty();
+}
+
 void Renderer::render(const SceneGraph *sceneGraph)
 {
+  if (!this->_shadersReady)
+    this->_shadersReady = this->_pollShaders();
+  if (!this->_shadersReady)
+  {
+    // The driver is still compiling in the background, present empty frames rather than waiting
+    this->_context.getState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    this->_context.getState().clearColor(0.07, 0.07, 0.07, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glfwSwapBuffers(this->_window);
+    return;
+  }
+
+  this->_context.getResourceCache().beginFrame();
+  this->_context.getFrameData().beginFrame();
+  this->_context.getGPUCuller().beginFrame();
+  this->_sceneContext.updateFrameGlobals(*this->_camera);
+  this->_sceneContext.updateLightClusters();
+  this->_sceneContext.updateShadowAtlas();
+  const glm::mat4 &viewProjection = this->_sceneContext.getFrameGlobals().viewProjection;
+  if (this->_context.getGPUCuller().isEnabled())
+    this->_sceneContext.occlusion.clear(viewProjection); // Occlusion is tested against the depth pyramid instead
+  else if (this->_sceneGraph.getRoot())
+    this->_sceneContext.occlusion.update(*this->_sceneGraph.getRoot(), viewProjection);
 
   for (auto &p : this->_sceneContext.dLights)
   {
@@ -196,6 +287,7 @@ void Renderer::render(const SceneGraph *sceneGraph)
   }
 
   this->_gBufferNode->render();
+  this->_context.getGPUCuller().captureDepth(this->_gBuffer.getId(), SceneContext::WIDTH, SceneContext::HEIGHT, viewProjection);
   this->_deferredLightingNode->render();
 
   this->_mainNode->render();
@@ -221,9 +313,49 @@ void Renderer::render(const SceneGraph *sceneGraph)
 
   this->_gammaCorrectionNode->render();
 
+  this->_context.getResourceCache().endFrame();
+  this->_context.getFrameData().endFrame();
+  GPUMemoryTracker::getInstance()->endFrame();
+  this->_context.getState().endFrame();
+
   glfwSwapBuffers(this->_window);
 }
 
+void Renderer::printCullReport(std::ostream &os) const
+{
+  auto printPass = [&os](const std::string &name, const CullStats &stats) {
+    os << "  " << name << ": " << stats.visible << " visible, " << stats.culled << " culled, "
+       << stats.occluded << " occluded, " << stats.tested << " bounds tested" << std::endl;
+  };
+  os << "Culling last frame (" << this->_sceneContext.occlusion.getNbOccluders() << " occluders):" << std::endl;
+  for (auto &p : this->_sceneContext.dLights)
+    printPass("direction light " + std::to_string(p.first) + " shadow", p.second.renderNode.getCullStats());
+  for (auto &p : this->_sceneContext.pLights)
+    printPass("point light " + std::to_string(p.first) + " shadow", p.second.renderNode.getCullStats());
+  if (this->_gBufferNode)
+    printPass("g-buffer", this->_gBufferNode->getCullStats());
+  if (this->_mainNode)
+    printPass("forward", this->_mainNode->getCullStats());
+  os << "  light clusters: " << this->_sceneContext.lightClusters.getNbLights() << " point lights, "
+     << this->_sceneContext.lightClusters.getNbIndices() << " cluster entries" << std::endl;
+  const ShadowAtlas &atlas = this->_sceneContext.shadowAtlas;
+  size_t atlasTexels = (size_t)atlas.getSize() * atlas.getSize();
+  os << "  shadow atlas: " << atlas.getNbShadowedLights() << " of " << atlas.getNbLights() << " lights, "
+     << (atlasTexels ? 100 * atlas.getUsedTexels() / atlasTexels : 0) << "% of " << atlas.getSize() << "x" << atlas.getSize() << " used" << std::endl;
+  const GPUCuller &gpuCuller = this->_context.getGPUCuller();
+  if (gpuCuller.isEnabled())
+  {
+    const GPUCullStats &stats = gpuCuller.getStats();
+    os << "  GPU, " << GPUCuller::NB_FRAMES << " frames ago: " << stats.visible << " visible, " << stats.frustumCulled << " culled, "
+       << stats.occluded << " occluded, " << stats.tested << " bounds tested" << std::endl;
+  }
+}
+
+void Renderer::setGPUCulling(bool enabled)
+{
+  this->_context.getGPUCuller().setEnabled(enabled);
+}
+
 void Renderer::createMainNode(SceneGraph *sceneGraph)
 {
   if (this->_mainNode == nullptr)
@@ -232,6 +364,8 @@ void Renderer::createMainNode(SceneGraph *sceneGraph)
     this->_mainNode->getOutput() = &this->_multisampled;
     this->_gBufferNode = new MainNode(this->_context, this->_sceneContext, *sceneGraph, this->_gBufferShader, *this->_camera);
     this->_gBufferNode->getOutput() = &this->_gBuffer;
+    this->_prepareVariants(*this->_mainNode, this->_shader);
+    this->_prepareVariants(*this->_gBufferNode, this->_gBufferShader);
   }
 }
 
@@ -256,6 +390,7 @@ void Renderer::createInstancedNode(SceneGraph *sceneGraph, const std::vector<glm
     this->_sceneContext.setInstancingVBO(transformations);
     this->_instancedNode = new InstancedNode(this->_context, this->_sceneContext, *sceneGraph, this->_instancingShader, *this->_camera, transformations);
     this->_instancedNode->getOutput() = &this->_multisampled;
+    this->_prepareVariants(*this->_instancedNode, this->_instancingShader);
   }
 }
 
@@ -265,6 +400,7 @@ void Renderer::createCubeMapNode(SceneGraph *sceneGraph)
   {
     this->_cubeMapNode = new CubeMapNode(this->_context, this->_sceneContext, *sceneGraph, this->_cubeMapShader, *this->_camera);
     this->_cubeMapNode->getOutput() = &this->_multisampled;
+    this->_prepareShader(this->_cubeMapShader);
   }
 }
 
@@ -276,7 +412,7 @@ void Renderer::createPostProcessNode(SceneGraph *sceneGraph)
     this->_extractCapedBrightnessNode->getInputs().insert(std::pair<std::string, const TextureWrapper &>("fb", this->_main.getColorBuffers()[0]));
     this->_extractCapedBrightnessNode->getOutput() = &this->_extractCapedBrightnessFB;
 
-    this->_blurNode = new GaussianBlurNode(this->_context, this->_sceneContext, *sceneGraph);
+    this->_blurNode = new GaussianBlurNode(this->_context, this->_sceneContext, *sceneGraph, this->_blurShader);
     this->_blurNode->getInputs().insert(std::pair<std::string, const TextureWrapper &>("fb", this->_extractCapedBrightnessFB.getColorBuffers()[1]));
     this->_blurNode->getOutput() = &this->_blurFB;
 
@@ -298,6 +434,10 @@ void Renderer::createPostProcessNode(SceneGraph *sceneGraph)
     this->_deferredLightingNode->getInputs().insert(std::pair<std::string, const TextureWrapper &>("fb1", this->_gBuffer.getColorBuffers()[1]));
     this->_deferredLightingNode->getInputs().insert(std::pair<std::string, const TextureWrapper &>("fb2", this->_gBuffer.getColorBuffers()[2]));
     this->_deferredLightingNode->getInputs().insert(std::pair<std::string, const TextureWrapper &>("fb3", this->_gBuffer.getColorBuffers()[3]));
+
+    for (Shader *shader : {&this->_extractCapedBrightnessShader, &this->_blurShader, &this->_hdrCorrectionShader,
+                           &this->_bloomEffectShader, &this->_postProcessShader, &this->_deferredLightingShader})
+      this->_prepareShader(*shader);
   }
 }
 
@@ -307,6 +447,7 @@ void Renderer::createGammaCorrectionNode(SceneGraph *sceneGraph)
   {
     this->_gammaCorrectionNode = new PostProcessNode(this->_context, this->_sceneContext, *sceneGraph, this->_gammaCorrectionShader);
     this->_gammaCorrectionNode->getInputs().insert(std::pair<std::string, const TextureWrapper &>("fb", this->_postProcess.getColorBuffers()[0]));
+    this->_prepareShader(this->_gammaCorrectionShader);
   }
 }
 
@@ -315,15 +456,23 @@ void Renderer::notified(Subject *subject, Event event)
   IComponent *c = dynamic_cast<IComponent *>(subject);
   if (c)
   {
-    // TODO: Separate events crated, updated, deleted etc. But for now lets focus on batch mode
-    this->_registerComponent(*c);
+    // Shadows cached with the previous state of a caster are invalidated before it is registered again
+    this->_sceneContext.invalidateShadows(*c, event);
+    if (event == Event::COMPONENT_DELETED || event == Event::COMPONENT_REMOVED)
+      this->_unregisterComponent(*c);
+    else
+      this->_registerComponent(*c);
     return;
   }
   Entity *e = dynamic_cast<Entity *>(subject);
   if (e)
   {
+    if (event == Event::BASE_REMOVED || event == Event::BASE_DELETED)
+      this->_sceneContext.untrackShadowCaster(*e);
     // TODO: Separate events crated, updated, deleted etc. But for now lets focus on batch mode
     this->_visitSceneGraphRec(*e);
+    if (event == Event::BASE_ADDED)
+      this->_sceneContext.updateShadowCaster(*e);
     return;
   }
 }
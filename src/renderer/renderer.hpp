@@ -14,6 +14,10 @@
 
 #include <renderer/global.hpp>
 
+#include <ostream>
+#include <set>
+#include <vector>
+
 #define MAX_NUM_LIGHTS 10
 
 namespace leo
@@ -57,6 +61,8 @@ public:
 
 public:
   void render(const SceneGraph *sceneGraph);
+  void printCullReport(std::ostream &os) const; // Frustum culling of the last frame, per pass
+  void setGPUCulling(bool enabled);             // Culls the multi-draws in compute shaders instead of the occlusion buffer
 
 public:
   void createMainNode(SceneGraph *sceneGraph);
@@ -74,7 +80,11 @@ private:
   void _visitSceneGraph();
   void _visitSceneGraphRec(const Entity &root);
   void _registerComponent(const IComponent &component);
+  void _unregisterComponent(const IComponent &component);
   void _registerDirectionLight(const DirectionLight &dl);
+  void _prepareShader(Shader &shader);
+  void _prepareVariants(const MainNode &node, Shader &shader);
+  bool _pollShaders();
 
 private:
   void _init();
@@ -112,6 +122,11 @@ private:
   Shader _extractCapedBrightnessShader;
   Shader _hdrCorrectionShader;
   Shader _bloomEffectShader;
+  Shader _blurShader;
+
+  std::vector<Shader *> _pendingShaders; // Submitted for compilation, not linked yet
+  std::set<Shader::t_features> _materialFeatures;
+  bool _shadersReady = false;
 
   OpenGLContext _context;
   SceneContext _sceneContext;
@@ -5,6 +5,8 @@
 #include <renderer/buffer-collection.hpp>
 #include <renderer/texture-wrapper.hpp>
 #include <renderer/opengl-context.hpp>
+#include <renderer/gpu-resource-cache.hpp>
+#include <renderer/camera.hpp>
 
 #include <model/components/direction-light.hpp>
 #include <model/components/point-light.hpp>
@@ -12,10 +14,16 @@
 #include <model/components/material.hpp>
 #include <model/components/volume.hpp>
 #include <model/entity.hpp>
+#include <model/icomponent.hpp>
+#include <model/type-id.hpp>
 #include <model/texture-manager.hpp>
 
+#include <utils/frustum.hpp>
 #include <utils/texture.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 namespace leo
 {
 
@@ -48,19 +56,13 @@ void SceneContext::registerDirectionLight(const DirectionLight &dl, const SceneG
                                       up);
     glm::mat4 lightSpaceMatrix = lightProjection * lightView;
 
-    DepthBufferOptions options;
-    options.width = 1620 * 2;
-    options.height = 1080 * 2;
-    options.type = DepthBufferType::DEPTH_MAP;
-
     DirectionLightWrapper &wrapper = this->dLights.insert(std::pair<t_id, DirectionLightWrapper>(
                                                               dl.getId(),
-                                                              DirectionLightWrapper(Framebuffer(), lightSpaceMatrix, DirectionLightUniform(dl),
+                                                              DirectionLightWrapper(lightSpaceMatrix, DirectionLightUniform(dl),
                                                                                     ShadowMappingNode(this->_context, *this, sceneGraph, shadowShader, dl))))
                                          .first->second;
 
-    wrapper.map.setDepthBuffer(options);
-    wrapper.renderNode.getOutput() = &wrapper.map;
+    wrapper.renderNode.getOutput() = &this->shadowAtlas.getFramebuffer();
     wrapper.renderNode.setLightSpaceMatrix(wrapper.projection);
 }
 
@@ -81,67 +83,366 @@ void SceneContext::registerPointLight(const PointLight &pl, const SceneGraph &sc
 
 void SceneContext::registerMaterial(const Material &m)
 {
-    GLTextureOptions options;
-    for (const Texture *t : {m.diffuse_texture, m.specular_texture, m.reflection_map, m.normal_map, m.parallax_map})
-        if (t)
+    this->materials.update(m);
+    GPUResourceCache &cache = this->_context.getResourceCache();
+    // The material textures may have changed since the last registration
+    cache.release(m.getId());
+    std::pair<const Texture *, const TextureArrayLayer *> maps[] = {
+        {m.diffuse_texture, &m.diffuse_layer},
+        {m.specular_texture, &m.specular_layer},
+        {m.reflection_map, &m.reflection_layer},
+        {m.normal_map, &m.normal_layer},
+        {m.parallax_map, &m.parallax_layer}};
+    GLuint64 handles[NB_MATERIAL_BUFFER_MAPS] = {0, 0, 0, 0, 0};
+    glm::ivec2 layers[NB_MATERIAL_BUFFER_MAPS];
+    for (int i = 0; i < NB_MATERIAL_BUFFER_MAPS; ++i)
+    {
+        auto &map = maps[i];
+        const TextureArray *array = map.second->array;
+        if (array && this->getTextureArraySlot(array) < 0 && this->textureArrays.size() < MAX_TEXTURE_ARRAYS)
+            this->textureArrays.push_back(array);
+        layers[i] = glm::ivec2(array ? this->getTextureArraySlot(array) : -1, map.second->layer);
+        if (layers[i].x >= 0)
         {
-            if (t->mode == RGBA || t->mode == SRGBA)
-            {
-                options.format = options.internalFormat = GL_RGBA;
-            }
-            else
-            {
-                options.format = options.internalFormat = GL_RGB;
-            }
-            options.type = GL_UNSIGNED_BYTE;
-            this->registerTexture(*t, options, {});
+            cache.acquireTextureArray(*array, m.getId(), TextureWrapper::getDefaultOptions(*array->layers[0]));
         }
+        else if (map.first)
+        {
+            // 0 without bindless textures, the maps are then bound per material
+            handles[i] = cache.acquireTexture(*map.first, m.getId(), TextureWrapper::getDefaultOptions(*map.first)).getBindlessHandle();
+        }
+    }
+    this->materials.setMaps(m, handles, layers);
 }
 
-void SceneContext::registerTexture(const Texture &tex, GLTextureOptions glOptions = {}, TextureOptions textureOptions = {})
+void SceneContext::registerVolume(const Volume &volume)
 {
-    this->textures.insert(std::pair<t_id, TextureWrapper>(tex.getId(), TextureWrapper(tex, glOptions, textureOptions)));
+    this->_context.getGeometryPool().allocate(volume);
 }
 
-void SceneContext::registerVolume(const Volume &volume)
+void SceneContext::registerInstancedVolume(const Volume &volume)
+{
+    this->_context.getResourceCache().acquireInstancedBufferCollection(volume, this->instancingVBO, volume.getId());
+}
+
+void SceneContext::unregisterMaterial(const Material &m)
+{
+    this->materials.release(m.getId());
+    this->_context.getResourceCache().release(m.getId());
+}
+
+void SceneContext::unregisterVolume(const Volume &volume)
+{
+    this->_context.getGeometryPool().release(volume.getId());
+    this->_context.getResourceCache().release(volume.getId());
+}
+
+const BufferCollection &SceneContext::getBufferCollection(const Volume &volume)
 {
-    this->bufferCollectionsInstanced.erase(volume.getId());
+    // Held for the frame even when registered, so that it cannot be evicted while in use. Acquiring again
+    // brings it back when it was evicted or never registered, e.g. geometry owned by a render node
+    return this->_context.getResourceCache().acquireBufferCollection(volume, GPUResourceCache::FRAME_OWNER);
+}
 
-    auto it = this->bufferCollections.find(volume.getId());
+const BufferCollection &SceneContext::getInstancedBufferCollection(const Volume &volume)
+{
+    return this->_context.getResourceCache().acquireInstancedBufferCollection(volume, this->instancingVBO, GPUResourceCache::FRAME_OWNER);
+}
+
+int SceneContext::getTextureArraySlot(const TextureArray *textureArray) const
+{
+    for (size_t i = 0; i < this->textureArrays.size(); ++i)
+        if (this->textureArrays[i] == textureArray)
+            return (int)i;
+    return -1;
+}
 
-    if (it == this->bufferCollections.end())
+GLuint SceneContext::getTextureArrayId(unsigned int slot)
+{
+    if (slot >= this->textureArrays.size())
+        return 0;
+    const TextureArray &array = *this->textureArrays[slot];
+    return this->_context.getResourceCache().acquireTextureArray(array, GPUResourceCache::FRAME_OWNER, TextureWrapper::getDefaultOptions(*array.layers[0])).getId();
+}
+
+const FrameAllocation &SceneContext::getLights()
+{
+    FrameRingBuffer &frameData = this->_context.getFrameData();
+    if (this->_lightsFrame == frameData.getFrame() && this->_lights.data)
+        return this->_lights;
+    this->_lightsFrame = frameData.getFrame();
+
+    // Same layout as the "s1" block: every point light slot, then every direction light slot
+    size_t directionOffset = MAX_NUM_LIGHTS * sizeof(PointLightUniform);
+    this->_lights = frameData.allocate(directionOffset + MAX_NUM_LIGHTS * sizeof(DirectionLightUniform));
+    if (!this->_lights.data)
+        return this->_lights;
+    unsigned char *data = static_cast<unsigned char *>(this->_lights.data);
+    std::memset(data, 0, this->_lights.size);
+    int i = 0;
+    for (auto it = this->pLights.begin(); it != this->pLights.end() && i < MAX_NUM_LIGHTS; ++it, ++i)
+        std::memcpy(data + i * sizeof(PointLightUniform), (const void *)&it->second.uniform, sizeof(PointLightUniform));
+    i = 0;
+    for (auto it = this->dLights.begin(); it != this->dLights.end() && i < MAX_NUM_LIGHTS; ++it, ++i)
+        std::memcpy(data + directionOffset + i * sizeof(DirectionLightUniform), (const void *)&it->second.uniform, sizeof(DirectionLightUniform));
+    return this->_lights;
+}
+
+void SceneContext::updateFrameGlobals(const Camera &camera)
+{
+    FrameGlobals &globals = this->_frameGlobals;
+    globals.view = camera.getViewMatrix();
+    globals.projection = glm::perspective(camera.getZoom(), (float)WIDTH / (float)HEIGHT, NEAR_PLANE, FAR_PLANE);
+    globals.viewProjection = globals.projection * globals.view;
+    globals.inverseView = glm::inverse(globals.view);
+    globals.inverseProjection = glm::inverse(globals.projection);
+    globals.cameraPosition = glm::vec4(camera.getPosition(), 1.f);
+    double time = glfwGetTime();
+    globals.time = glm::vec4((float)time, this->_lastFrameTime < 0. ? 0.f : (float)(time - this->_lastFrameTime), 0.f, 0.f);
+    this->_lastFrameTime = time;
+    globals.resolution = glm::vec4((float)WIDTH, (float)HEIGHT, 1.f / WIDTH, 1.f / HEIGHT);
+
+    // Nothing else is bound there, the range stays bound for the whole frame
+    FrameRingBuffer &frameData = this->_context.getFrameData();
+    frameData.bindRange(GL_UNIFORM_BUFFER, FRAME_GLOBALS_BINDING, frameData.upload(&globals, sizeof(FrameGlobals)));
+}
+
+void SceneContext::updateLightClusters()
+{
+    this->_pointLights.clear();
+    for (auto &p : this->pLights)
+        this->_pointLights.push_back(p.second.uniform);
+    this->lightClusters.update(this->_context, this->_frameGlobals.view, this->_frameGlobals.projection, NEAR_PLANE, FAR_PLANE,
+                               this->_pointLights);
+}
+
+void SceneContext::updateShadowAtlas()
+{
+    this->_updateDynamicCasters();
+
+    // Direction lights cover the whole view, point lights as much as the projection of their range
+    ShadowAtlas &atlas = this->shadowAtlas;
+    atlas.clear();
+    for (auto &p : this->dLights)
+        p.second.shadowSlot = atlas.addLight(p.first, 1.f, 1, ShadowAtlas::MAX_TILE_SIZE);
+    Frustum frustum(this->_frameGlobals.viewProjection);
+    glm::vec3 cameraPosition(this->_frameGlobals.cameraPosition);
+    float focal = this->_frameGlobals.projection[1][1];
+    for (auto &p : this->pLights)
     {
-        this->bufferCollections.insert(std::pair<t_id, BufferCollection>(volume.getId(), BufferCollection())).first;
-        BufferCollection &bc = this->bufferCollections[volume.getId()];
+        const PointLightUniform &light = p.second.uniform;
+        glm::vec3 position(light.position);
+        float range = std::min(LightClusters::getRange(light), PointLightWrapper::far); // Faces end at the far plane
+        float distance = glm::length(position - cameraPosition);
+        float coverage = 0.f;
+        AABB bounds;
+        bounds.add(position - glm::vec3(range));
+        bounds.add(position + glm::vec3(range));
+        if (distance <= range)
+            coverage = 1.f;
+        else if (frustum.test(bounds) != OUTSIDE_FRUSTUM)
+            coverage = range * focal / distance; // Of the screen's height
+        float intensity = glm::max(light.diffuse.x, glm::max(light.diffuse.y, light.diffuse.z));
+        p.second.shadowSlot = atlas.addLight(p.first, coverage * std::min(intensity, 1.f), 6, ShadowAtlas::MAX_TILE_SIZE / 2);
+    }
+    atlas.pack();
 
-        this->_context.generateBufferCollection(bc, volume);
+    for (auto &p : this->dLights)
+        atlas.setMatrix(p.second.shadowSlot, 0, p.second.projection);
+    for (auto &p : this->pLights)
+    {
+        for (unsigned int face = 0; face < 6; ++face)
+            atlas.setMatrix(p.second.shadowSlot, face, p.second.shadowTransforms[face]);
     }
+    // Tiles are in the order of the lights: one per direction light, then six per point light
+    atlas.upload(this->_context, glm::uvec4(0, (GLuint)this->dLights.size(), 0, 0));
 }
 
-void SceneContext::registerInstancedVolume(const Volume &volume)
+void SceneContext::trackShadowCaster(const Entity &entity)
 {
-    auto it = this->bufferCollectionsInstanced.find(volume.getId());
+    if (!this->_casterBounds.count(entity.getId()) && !this->_dynamicCasters.count(entity.getId()))
+        this->_casterBounds[entity.getId()] = entity.getSubtreeBounds();
+}
 
-    if (it == this->bufferCollectionsInstanced.end())
-    {
+void SceneContext::untrackShadowCaster(const Entity &entity)
+{
+    // Casters under the entity without a transformation of their own were cached within its bounds
+    this->_invalidateShadows(entity.getSubtreeBounds());
+    this->_untrackShadowCasters(entity);
+}
+
+void SceneContext::updateShadowCaster(const Entity &entity)
+{
+    this->_invalidateShadows(entity.getSubtreeBounds());
+    this->_recordCasterBounds(entity, true);
+}
 
-        auto it2 = this->bufferCollections.find(volume.getId());
-        if (it2 != this->bufferCollections.end())
+void SceneContext::invalidateShadows(const IComponent &component, Event event)
+{
+    const Entity *entity = component.getEntity();
+    switch (component.getTypeId())
+    {
+    case ComponentType::TRANSFORMATION:
+    {
+        if (!entity || event != Event::COMPONENT_UPDATED)
+            break;
+        unsigned long long frame = this->_context.getFrameData().getFrame();
+        auto it = this->_dynamicCasters.find(entity->getId());
+        if (it != this->_dynamicCasters.end())
         {
-            this->bufferCollectionsInstanced.insert(
-                std::pair<t_id, BufferCollection>(
-                    volume.getId(), it2->second));
-            this->bufferCollections.erase(volume.getId());
+            it->second.lastMoved = frame;
+            break;
+        }
+        // The caster leaves the cached shadows where it was, it is drawn over them until it stops
+        auto bounds = this->_casterBounds.find(entity->getId());
+        if (bounds != this->_casterBounds.end())
+        {
+            this->_invalidateShadows(bounds->second);
+            this->_casterBounds.erase(bounds);
         }
         else
+            this->_invalidateAllShadows();
+        DynamicCaster &caster = this->_dynamicCasters[entity->getId()];
+        caster.entity = entity;
+        caster.lastMoved = frame;
+    }
+    break;
+    case ComponentType::VOLUME:
+    {
+        if (!entity)
+            break;
+        // The closest static caster holding the volume cached it within its recorded bounds
+        for (const Entity *holder = entity; holder; holder = holder->getParent())
         {
-            this->bufferCollectionsInstanced.insert(
-                std::pair<t_id, BufferCollection>(
-                    volume.getId(), BufferCollection()));
+            auto bounds = this->_casterBounds.find(holder->getId());
+            if (bounds != this->_casterBounds.end())
+            {
+                this->_invalidateShadows(bounds->second);
+                break;
+            }
         }
-        BufferCollection &bc = this->bufferCollectionsInstanced[volume.getId()];
-        this->_context.generateBufferCollectionInstanced(bc, volume, this->instancingVBO);
+        this->updateShadowCaster(*entity);
+    }
+    break;
+    case ComponentType::DIRECTION_LIGHT:
+    {
+        auto it = this->dLights.find(component.getId());
+        if (it != this->dLights.end())
+            it->second.renderNode.invalidateCache();
+    }
+    break;
+    case ComponentType::POINT_LIGHT:
+    {
+        auto it = this->pLights.find(component.getId());
+        if (it != this->pLights.end())
+            it->second.renderNode.invalidateCache();
+    }
+    break;
+    default:
+        break;
+    }
+}
+
+void SceneContext::_updateDynamicCasters()
+{
+    // Casters that stopped moving are cached again with the static ones
+    unsigned long long frame = this->_context.getFrameData().getFrame();
+    for (auto it = this->_dynamicCasters.begin(); it != this->_dynamicCasters.end();)
+    {
+        if (frame - it->second.lastMoved < STATIC_FRAMES)
+        {
+            ++it;
+            continue;
+        }
+        const Entity &entity = *it->second.entity;
+        this->_invalidateShadows(entity.getSubtreeBounds());
+        this->_casterBounds[it->first] = entity.getSubtreeBounds();
+        this->_recordCasterBounds(entity, true); // The casters it carried moved with it
+        it = this->_dynamicCasters.erase(it);
+    }
+
+    // Only the lights reaching a dynamic caster draw over their cached shadows this frame
+    this->_dynamicBounds.clear();
+    for (auto &p : this->_dynamicCasters)
+    {
+        const AABB &bounds = p.second.entity->getSubtreeBounds();
+        if (!bounds.isEmpty())
+            this->_dynamicBounds.push_back(bounds);
+    }
+    for (auto &p : this->dLights)
+    {
+        Frustum frustum(p.second.projection);
+        p.second.renderNode.setDynamicCasters(std::any_of(this->_dynamicBounds.begin(), this->_dynamicBounds.end(),
+                                                          [&frustum](const AABB &bounds) { return frustum.test(bounds) != OUTSIDE_FRUSTUM; }));
+    }
+    for (auto &p : this->pLights)
+    {
+        BoundingSphere reach = _getReach(p.second);
+        p.second.renderNode.setDynamicCasters(std::any_of(this->_dynamicBounds.begin(), this->_dynamicBounds.end(),
+                                                          [&reach](const AABB &bounds) { return reach.intersects(bounds); }));
+    }
+}
+
+void SceneContext::_untrackShadowCasters(const Entity &entity)
+{
+    auto it = this->_casterBounds.find(entity.getId());
+    if (it != this->_casterBounds.end())
+    {
+        this->_invalidateShadows(it->second);
+        this->_casterBounds.erase(it);
     }
+    this->_dynamicCasters.erase(entity.getId());
+    for (auto &child : entity.getChildren())
+        this->_untrackShadowCasters(*child.second);
+}
+
+void SceneContext::_recordCasterBounds(const Entity &entity, bool ancestors)
+{
+    // The recorded bounds are where a caster is invalidated from when it starts moving
+    auto it = this->_casterBounds.find(entity.getId());
+    if (it != this->_casterBounds.end())
+        it->second = entity.getSubtreeBounds();
+    for (auto &child : entity.getChildren())
+        this->_recordCasterBounds(*child.second, false);
+    for (const Entity *parent = ancestors ? entity.getParent() : nullptr; parent; parent = parent->getParent())
+    {
+        it = this->_casterBounds.find(parent->getId());
+        if (it != this->_casterBounds.end())
+            it->second = parent->getSubtreeBounds();
+    }
+}
+
+void SceneContext::_invalidateShadows(const AABB &bounds)
+{
+    if (bounds.isEmpty())
+        return;
+    for (auto &p : this->dLights)
+    {
+        if (Frustum(p.second.projection).test(bounds) != OUTSIDE_FRUSTUM)
+            p.second.renderNode.invalidateCache();
+    }
+    for (auto &p : this->pLights)
+    {
+        if (_getReach(p.second).intersects(bounds))
+            p.second.renderNode.invalidateCache();
+    }
+}
+
+void SceneContext::_invalidateAllShadows()
+{
+    for (auto &p : this->dLights)
+        p.second.renderNode.invalidateCache();
+    for (auto &p : this->pLights)
+        p.second.renderNode.invalidateCache();
+}
+
+BoundingSphere SceneContext::_getReach(const PointLightWrapper &light)
+{
+    // The faces end at the far plane
+    BoundingSphere reach;
+    reach.center = glm::vec3(light.uniform.position);
+    reach.radius = PointLightWrapper::far;
+    return reach;
 }
 
 void SceneContext::setInstancingVBO(const std::vector<glm::mat4> &transformations)
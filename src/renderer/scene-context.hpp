@@ -2,8 +2,17 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include <renderer/global.hpp>
+#include <renderer/frame-globals.hpp>
+#include <renderer/frame-ring-buffer.hpp>
+#include <renderer/light-clusters.hpp>
+#include <renderer/material-buffer.hpp>
+#include <renderer/occlusion-culler.hpp>
+#include <renderer/shadow-atlas.hpp>
+
+#include <controller/event.hpp>
 
 namespace leo
 {
@@ -22,6 +31,10 @@ class Shader;
 class OpenGLContext;
 class Material;
 class Volume;
+class TextureArray;
+class Camera;
+class Entity;
+class IComponent;
 
 class SceneContext
 {
@@ -38,20 +51,69 @@ public:
     void registerVolume(const Volume &volume);
     void setInstancingVBO(const std::vector<glm::mat4> &transformations);  // TODO: Should use Instancing node when the time is right
     void registerInstancedVolume(const Volume &volume);
+    void unregisterMaterial(const Material &m);
+    void unregisterVolume(const Volume &volume);
+    const BufferCollection &getBufferCollection(const Volume &volume);
+    const BufferCollection &getInstancedBufferCollection(const Volume &volume);
+    int getTextureArraySlot(const TextureArray *textureArray) const;
+    GLuint getTextureArrayId(unsigned int slot);
+    const FrameAllocation &getLights();
+    void updateFrameGlobals(const Camera &camera);
+    void updateLightClusters(); // After updateFrameGlobals
+    void updateShadowAtlas();   // After updateFrameGlobals, before the shadow nodes render
+    void trackShadowCaster(const Entity &entity);
+    void untrackShadowCaster(const Entity &entity);
+    void updateShadowCaster(const Entity &entity); // A volume or a child was added under the entity
+    void invalidateShadows(const IComponent &component, Event event);
+    bool isDynamicCaster(t_id entity) const { return this->_dynamicCasters.count(entity) > 0; }
+    const FrameGlobals &getFrameGlobals() const { return this->_frameGlobals; }
 
-private:
-    void registerTexture(const Texture &tex, GLTextureOptions glOptionss, TextureOptions textureOptions);
+public:
+    static const unsigned int MAX_TEXTURE_ARRAYS = 8; // Size of the texture_arrays sampler array in the shaders
+    static const unsigned int WIDTH = 1620;
+    static const unsigned int HEIGHT = 1080;
+    static constexpr float NEAR_PLANE = 0.1f;
+    static constexpr float FAR_PLANE = 100.f;
+    static const unsigned int STATIC_FRAMES = 30; // Frames without moving before a caster joins the cached shadows
+    static const size_t SHADOW_ATLAS_BUDGET = 64 << 20; // Bytes of both layers of the shadow atlas, 4096 texels per side
 
 public:
-    // SceneGraph data
-    std::map<t_id, BufferCollection> bufferCollections;
-    std::map<t_id, BufferCollection> bufferCollectionsInstanced;
-    std::map<t_id, TextureWrapper> textures;
+    // SceneGraph data, GPU resources are owned by the context's resource cache
     std::map<t_id, DirectionLightWrapper> dLights;
     std::map<t_id, PointLightWrapper> pLights;
     GLuint instancingVBO = 0;
+    std::vector<const TextureArray *> textureArrays; // Bound once per frame, in slot order
+    MaterialBuffer materials;
+    OcclusionCuller occlusion; // Occluders of the camera, rasterized once per frame
+    LightClusters lightClusters;
+    ShadowAtlas shadowAtlas; // Shadow maps of every light, tiles reassigned every frame
 
     OpenGLContext &_context;
+
+private:
+    typedef struct DynamicCaster
+    {
+        const Entity *entity = nullptr;
+        unsigned long long lastMoved = 0; // Frame of the last update of its transformation
+    } DynamicCaster;
+
+private:
+    void _updateDynamicCasters(); // Settles the casters that stopped, flags the lights reaching the others
+    void _untrackShadowCasters(const Entity &entity);
+    void _recordCasterBounds(const Entity &entity, bool ancestors); // Of the static casters in the subtree and above it
+    void _invalidateShadows(const AABB &bounds); // Of the lights reaching the bounds
+    void _invalidateAllShadows();
+    static BoundingSphere _getReach(const PointLightWrapper &light);
+
+private:
+    FrameAllocation _lights; // Lights block of the frame, shared by the nodes lighting the scene
+    unsigned long long _lightsFrame = 0;
+    FrameGlobals _frameGlobals;
+    std::vector<PointLightUniform> _pointLights;
+    std::unordered_map<t_id, DynamicCaster> _dynamicCasters; // Drawn every frame over the cached shadows
+    std::unordered_map<t_id, AABB> _casterBounds;            // Subtree bounds of the static casters, as cached
+    std::vector<AABB> _dynamicBounds;                        // Of the dynamic casters, this frame
+    double _lastFrameTime = -1.;
 };
 
 } // namespace leo
\ No newline at end of file
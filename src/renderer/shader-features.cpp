@@ -0,0 +1,63 @@
+#include "shader-features.hpp"
+
+#include <model/components/material.hpp>
+#include <model/texture-manager.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+namespace leo
+{
+
+namespace
+{
+
+const char *featureNames[ShaderFeature::NB_SHADER_FEATURES] = {"HAS_DIFFUSE_MAP", "HAS_SPECULAR_MAP", "HAS_REFLECTION_MAP",
+                                                              "HAS_NORMAL_MAP", "HAS_PARALLAX_MAP", "USE_BINDLESS_TEXTURES",
+                                                              "HAS_POINT_LIGHTS"};
+
+// The placeholders only stand in for a missing map, sampling them is wasted work
+bool hasMap(const Texture *texture, const Texture *placeholder, const TextureArrayLayer &layer)
+{
+  return layer.array || (texture && texture != placeholder);
+}
+
+} // namespace
+
+Shader::t_features ShaderFeatures::fromMaterial(const Material &material)
+{
+  Shader::t_features features = 0;
+  if (hasMap(material.diffuse_texture, TextureManager::white.get(), material.diffuse_layer))
+    features |= ShaderFeature::HAS_DIFFUSE_MAP;
+  if (hasMap(material.specular_texture, TextureManager::white.get(), material.specular_layer))
+    features |= ShaderFeature::HAS_SPECULAR_MAP;
+  if (hasMap(material.reflection_map, TextureManager::black.get(), material.reflection_layer))
+    features |= ShaderFeature::HAS_REFLECTION_MAP;
+  if (hasMap(material.normal_map, TextureManager::blue.get(), material.normal_layer))
+    features |= ShaderFeature::HAS_NORMAL_MAP;
+  if (hasMap(material.parallax_map, TextureManager::black.get(), material.parallax_layer))
+    features |= ShaderFeature::HAS_PARALLAX_MAP;
+  return features;
+}
+
+Shader::t_features ShaderFeatures::fromLightCounts(unsigned int nbPointLights, unsigned int nbDirectionLights)
+{
+  Shader::t_features features = std::min(nbDirectionLights, LIGHT_COUNT_MASK) << DIRECTION_LIGHTS_SHIFT;
+  if (nbPointLights > 0)
+    features |= ShaderFeature::HAS_POINT_LIGHTS;
+  return features;
+}
+
+std::string ShaderFeatures::getDefines(Shader::t_features features)
+{
+  std::stringstream ss;
+  for (int i = 0; i < ShaderFeature::NB_SHADER_FEATURES; ++i)
+  {
+    if (features & (1 << i))
+      ss << "#define " << featureNames[i] << "\n";
+  }
+  ss << "#define NB_DIRECTION_LIGHTS " << ((features >> DIRECTION_LIGHTS_SHIFT) & LIGHT_COUNT_MASK) << "\n";
+  return ss.str();
+}
+
+} // namespace leo
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <renderer/shader.hpp>
+
+#include <string>
+
+namespace leo
+{
+
+class Material;
+
+/* Feature bits of a shader permutation. Each set bit becomes a "#define" of its name in the variant sources.
+   * Point lights are shaded from the cluster lists, so only their presence is a feature. The direction light count
+   * is stored above the feature bits and becomes "#define NB_DIRECTION_LIGHTS n" to bound its loop.
+   */
+enum ShaderFeature
+{
+  HAS_DIFFUSE_MAP = 1 << 0,
+  HAS_SPECULAR_MAP = 1 << 1,
+  HAS_REFLECTION_MAP = 1 << 2,
+  HAS_NORMAL_MAP = 1 << 3,
+  HAS_PARALLAX_MAP = 1 << 4,
+  USE_BINDLESS_TEXTURES = 1 << 5, // Pass feature, maps are sampled through the handles of the material buffer
+  HAS_POINT_LIGHTS = 1 << 6,      // Pass feature, the scene has point lights to look up in the clusters
+  NB_SHADER_FEATURES = 7
+};
+
+class ShaderFeatures
+{
+public:
+  static Shader::t_features fromMaterial(const Material &material);
+  static Shader::t_features fromLightCounts(unsigned int nbPointLights, unsigned int nbDirectionLights);
+  static std::string getDefines(Shader::t_features features);
+
+public:
+  static const unsigned int DIRECTION_LIGHTS_SHIFT = 16;
+  static const unsigned int LIGHT_COUNT_MASK = 0xff;
+};
+
+} // namespace leo
@@ -1,5 +1,10 @@
 #include "shader.hpp"
 
+#include <renderer/gl-state-cache.hpp>
+#include <renderer/program-cache.hpp>
+#include <renderer/shader-features.hpp>
+#include <renderer/uniform-table.hpp>
+
 #include <utils/file-reader.hpp>
 #include <utils/texture.hpp>
 
@@ -19,81 +24,112 @@ Shader::Shader(const GLchar *vertexSourcePath,
 {
 }
 
-Shader::Shader(const Shader &other) : _vertexCode(other._vertexCode),
+Shader::Shader(const Shader &other) : _vertexPath(other._vertexPath),
+                                      _fragmentPath(other._fragmentPath),
+                                      _geometryPath(other._geometryPath),
+                                      _vertexCode(other._vertexCode),
                                       _fragmentCode(other._fragmentCode),
-                                      _geometryCode(other._geometryCode)
+                                      _geometryCode(other._geometryCode),
+                                      _sourcesLoaded(other._sourcesLoaded)
 {
 }
 
+// Sources are read when the program is first needed, shaders of unused nodes never touch the disk
 Shader::Shader(const GLchar *vertexSourcePath, const GLchar *fragmentSourcePath,
-               const GLchar *geometrySourcePath) : _vertexCode(FileReader::readFile(vertexSourcePath)),
-                                                   _fragmentCode(FileReader::readFile(fragmentSourcePath))
+               const GLchar *geometrySourcePath) : _vertexPath(vertexSourcePath),
+                                                   _fragmentPath(fragmentSourcePath),
+                                                   _sourcesLoaded(false)
 {
   if (geometrySourcePath)
-    _geometryCode = FileReader::readFile(geometrySourcePath);
+    _geometryPath = geometrySourcePath;
 }
 
 Shader &Shader::operator=(const Shader &other)
 {
+  this->_vertexPath = other._vertexPath;
+  this->_fragmentPath = other._fragmentPath;
+  this->_geometryPath = other._geometryPath;
   this->_vertexCode = other._vertexCode;
   this->_fragmentCode = other._fragmentCode;
   this->_geometryCode = other._geometryCode;
+  this->_sourcesLoaded = other._sourcesLoaded;
   return *this;
 }
 
+void Shader::_loadSources()
+{
+  if (this->_sourcesLoaded)
+    return;
+  this->_vertexCode = FileReader::readFile(this->_vertexPath.c_str());
+  this->_fragmentCode = FileReader::readFile(this->_fragmentPath.c_str());
+  if (this->_geometryPath.size())
+    this->_geometryCode = FileReader::readFile(this->_geometryPath.c_str());
+  this->_sourcesLoaded = true;
+}
+
+void Shader::prepare()
+{
+  if (this->_prepared)
+    return;
+  this->_loadSources();
+  this->_program = ProgramCache::getInstance()->requestProgram(this->_vertexCode, this->_fragmentCode, this->_geometryCode);
+  this->_prepared = true;
+}
+
+bool Shader::isReady()
+{
+  if (this->_initialized)
+    return true;
+  this->prepare();
+  return ProgramCache::getInstance()->isProgramReady(this->_program);
+}
+
 void Shader::_initProgram()
 {
-  const GLchar *vShaderCode = this->_vertexCode.c_str();
-  const GLchar *fShaderCode = this->_fragmentCode.c_str();
-  GLuint vertex, fragment;
-  this->_compileShader(vertex, vShaderCode, GL_VERTEX_SHADER);
-  this->_compileShader(fragment, fShaderCode, GL_FRAGMENT_SHADER);
-  this->_program = glCreateProgram();
-  glAttachShader(this->_program, vertex);
-  glAttachShader(this->_program, fragment);
-  if (this->_geometryCode.size())
-  {
-    GLuint geometry;
-    const GLchar *gShaderCode = this->_geometryCode.c_str();
-    this->_compileShader(geometry, gShaderCode, GL_GEOMETRY_SHADER);
-    glAttachShader(this->_program, geometry);
-  }
-  glLinkProgram(this->_program);
-  GLint success;
-  GLchar infoLog[512];
-  glGetProgramiv(this->_program, GL_LINK_STATUS, &success);
-  if (!success)
-  {
-    glGetProgramInfoLog(this->_program, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
-              << infoLog << std::endl;
-  }
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
-}
-
-void Shader::_compileShader(GLuint &shader, const GLchar *shaderCode,
-                            GLint shaderType)
-{
-  GLint success;
-  GLchar infolog[512];
-  shader = glCreateShader(shaderType);
-  glShaderSource(shader, 1, &shaderCode, NULL);
-  glCompileShader(shader);
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-  if (!success)
-  {
-    glGetShaderInfoLog(shader, 512, NULL, infolog);
-    std::cout << "ERROR::PROGRAM::COMPILE::COMPILATION_FAILED\n"
-              << infolog << std::endl;
-  }
+  this->prepare();
+  this->_program = ProgramCache::getInstance()->finishProgram(this->_program);
+  this->_uniforms = ProgramCache::getInstance()->getUniformTable(this->_program);
+  this->_initialized = true;
 }
 
 void Shader::use()
 {
   if (!this->_initialized)
     this->_initProgram();
-  glUseProgram(this->_program);
+  GLStateCache::getInstance()->useProgram(this->_program);
+}
+
+Shader &Shader::getVariant(t_features features)
+{
+  auto it = this->_variants.find(features);
+  if (it != this->_variants.end())
+    return *it->second;
+
+  // Sources only, the program is fetched from the ProgramCache the first time the variant is used
+  this->_loadSources();
+  std::unique_ptr<Shader> variant(new Shader());
+  const std::string defines = ShaderFeatures::getDefines(features);
+  variant->_vertexCode = _injectDefines(this->_vertexCode, defines);
+  variant->_fragmentCode = _injectDefines(this->_fragmentCode, defines);
+  if (this->_geometryCode.size())
+    variant->_geometryCode = _injectDefines(this->_geometryCode, defines);
+  variant->_features = features;
+  variant->_textureOffset = this->_textureOffset;
+  Shader &result = *variant;
+  this->_variants.insert(std::pair<t_features, std::unique_ptr<Shader>>(features, std::move(variant)));
+  return result;
+}
+
+std::string Shader::_injectDefines(const std::string &code, const std::string &defines)
+{
+  // "#version" has to stay the first statement of the source
+  size_t versionPos = code.find("#version");
+  if (versionPos == std::string::npos)
+    return defines + code;
+  size_t lineEnd = code.find('\n', versionPos);
+  if (lineEnd == std::string::npos)
+    return code + "\n" + defines;
+  return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
 }
 
 const GLuint &Shader::getProgram() const
@@ -108,31 +144,87 @@ std::string Shader::generateParamName(std::string prefix, int nb, std::string su
   return ss.str();
 }
 
+Shader::t_uniform Shader::getUniform(const char *name)
+{
+  if (!this->_initialized)
+    this->_initProgram();
+  return this->_uniforms ? this->_uniforms->find(name) : -1;
+}
+
+void Shader::bindUniformBlock(const char *name, GLuint binding)
+{
+  if (!this->_initialized)
+    this->_initProgram();
+  if (this->_uniforms)
+    this->_uniforms->bindBlock(name, binding);
+}
+
 void Shader::setVector3(const char *name, glm::vec3 value)
 {
-  glUniform3f(glGetUniformLocation(this->_program, name), value.x, value.y, value.z);
+  this->setVector3(this->getUniform(name), value);
 }
 
 void Shader::setFloat(const char *name, GLfloat value)
 {
-  glUniform1f(glGetUniformLocation(this->_program, name), value);
+  this->setFloat(this->getUniform(name), value);
 }
 
 void Shader::setInt(const char *name, GLint value)
 {
-  glUniform1i(glGetUniformLocation(this->_program, name), value);
+  this->setInt(this->getUniform(name), value);
+}
+
+void Shader::setIVec2(const char *name, glm::ivec2 value)
+{
+  this->setIVec2(this->getUniform(name), value);
 }
 
 void Shader::setTexture(const char *name, GLuint textureId, GLuint slot, GLuint textureType)
 {
-  glUniform1i(glGetUniformLocation(this->_program, name), slot);
-  glActiveTexture(GL_TEXTURE0 + slot);
-  glBindTexture(textureType, textureId);
+  this->setTexture(this->getUniform(name), textureId, slot, textureType);
+}
+
+void Shader::setMat4(const char *name, const glm::mat4 &value)
+{
+  this->setMat4(this->getUniform(name), value);
+}
+
+// Values are only uploaded when they differ from the last upload to the program, which does not need to be bound
+
+void Shader::setVector3(t_uniform uniform, glm::vec3 value)
+{
+  if (this->_uniforms && this->_uniforms->updateValue(uniform, &value, sizeof(value)))
+    glProgramUniform3f(this->_program, this->_uniforms->getLocation(uniform), value.x, value.y, value.z);
+}
+
+void Shader::setFloat(t_uniform uniform, GLfloat value)
+{
+  if (this->_uniforms && this->_uniforms->updateValue(uniform, &value, sizeof(value)))
+    glProgramUniform1f(this->_program, this->_uniforms->getLocation(uniform), value);
+}
+
+void Shader::setInt(t_uniform uniform, GLint value)
+{
+  if (this->_uniforms && this->_uniforms->updateValue(uniform, &value, sizeof(value)))
+    glProgramUniform1i(this->_program, this->_uniforms->getLocation(uniform), value);
+}
+
+void Shader::setIVec2(t_uniform uniform, glm::ivec2 value)
+{
+  if (this->_uniforms && this->_uniforms->updateValue(uniform, &value, sizeof(value)))
+    glProgramUniform2i(this->_program, this->_uniforms->getLocation(uniform), value.x, value.y);
+}
+
+void Shader::setTexture(t_uniform uniform, GLuint textureId, GLuint slot, GLuint textureType)
+{
+  this->setInt(uniform, (GLint)slot);
+  GLStateCache::getInstance()->bindTexture(slot, textureType, textureId);
 }
 
-void Shader::setMat4(const char *name, glm::mat4 value)
+void Shader::setMat4(t_uniform uniform, const glm::mat4 &value)
 {
-  glUniformMatrix4fv(glGetUniformLocation(this->_program, name), 1, GL_FALSE, glm::value_ptr(value));
+  if (this->_uniforms && this->_uniforms->updateValue(uniform, glm::value_ptr(value), sizeof(value)))
+    glProgramUniformMatrix4fv(this->_program, this->_uniforms->getLocation(uniform), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 } // namespace leo
\ No newline at end of file
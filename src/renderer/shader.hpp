@@ -2,15 +2,22 @@
 
 #include <renderer/global.hpp>
 
+#include <map>
+#include <memory>
 #include <string>
 
 namespace leo
 {
 
 class Texture;
+class UniformTable;
 
 class Shader
 {
+public:
+  using t_uniform = int; // Handle in the program's UniformTable, -1 for inactive uniforms
+  using t_features = unsigned int; // Bits of ShaderFeature, see shader-features.hpp
+
 public:
   Shader();
   Shader(const GLchar *vertexSourcePath, const GLchar *fragmentSourcePath);
@@ -20,33 +27,57 @@ public:
   Shader &operator=(const Shader &other);
 
 protected:
+  void _loadSources();
   void _initProgram();
-  void _compileShader(GLuint &shader, const GLchar *shaderCode, GLint shaderType);
 
 public:
   const GLuint &getProgram() const;
   void compile();
+  void prepare();
+  bool isReady();
   void use();
   GLuint getTextureOffset() const { return this->_textureOffset; }
   void setTextureOffset(GLuint value) { this->_textureOffset = value; }
+  Shader &getVariant(t_features features);
+  t_features getFeatures() const { return this->_features; }
 
 public:
+  t_uniform getUniform(const char *name);
+  void bindUniformBlock(const char *name, GLuint binding);
   void setVector3(const char *name, glm::vec3 value);
   void setFloat(const char *name, GLfloat value);
   void setInt(const char *name, GLint value);
+  void setIVec2(const char *name, glm::ivec2 value);
   void setTexture(const char *name, GLuint textureId, GLuint slot, GLuint textureType = GL_TEXTURE_2D);
-  void setMat4(const char *name, glm::mat4 value);
+  void setMat4(const char *name, const glm::mat4 &value);
+  void setVector3(t_uniform uniform, glm::vec3 value);
+  void setFloat(t_uniform uniform, GLfloat value);
+  void setInt(t_uniform uniform, GLint value);
+  void setIVec2(t_uniform uniform, glm::ivec2 value);
+  void setTexture(t_uniform uniform, GLuint textureId, GLuint slot, GLuint textureType = GL_TEXTURE_2D);
+  void setMat4(t_uniform uniform, const glm::mat4 &value);
 
 public:
   static std::string generateParamName(std::string prefix, int nb, std::string suffix);
 
 protected:
+  static std::string _injectDefines(const std::string &code, const std::string &defines);
+
+protected:
+  std::string _vertexPath;
+  std::string _fragmentPath;
+  std::string _geometryPath;
   std::string _vertexCode;
   std::string _fragmentCode;
   std::string _geometryCode;
   GLuint _program = 0;
+  UniformTable *_uniforms = nullptr;
   GLuint _textureOffset = 0;
+  bool _sourcesLoaded = true; // Shaders built from paths read them on first use
+  bool _prepared = false;    // Compilation submitted to the ProgramCache
   bool _initialized = false;
+  t_features _features = 0;
+  std::map<t_features, std::unique_ptr<Shader>> _variants; // Compiled on first use
 };
 
 } // namespace leo
@@ -0,0 +1,207 @@
+#include "shadow-atlas.hpp"
+
+#include <renderer/opengl-context.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <queue>
+
+namespace leo
+{
+
+void ShadowAtlas::init(size_t memoryBudget)
+{
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    unsigned int size = MIN_TILE_SIZE;
+    while ((size_t)size * 2 * size * 2 * sizeof(GLushort) * NB_LAYERS <= memoryBudget && (GLint)size * 2 <= maxSize)
+        size *= 2;
+
+    DepthBufferOptions options;
+    options.width = size;
+    options.height = size;
+    options.internalFormat = GL_DEPTH_COMPONENT16;
+    options.dataType = GL_UNSIGNED_SHORT;
+    this->_framebuffer.setName("shadow atlas");
+    this->_framebuffer.setDepthBuffer(options);
+    this->_cacheFramebuffer.setName("shadow atlas static cache");
+    this->_cacheFramebuffer.setDepthBuffer(options);
+    this->_size = size;
+}
+
+void ShadowAtlas::clear()
+{
+    this->_lastSizes.swap(this->_sizes);
+    this->_sizes.clear();
+    this->_lights.clear();
+    this->_tiles.clear();
+    this->_shadowTiles.clear();
+    this->_usedTexels = 0;
+}
+
+unsigned int ShadowAtlas::addLight(unsigned int key, float importance, unsigned int nbTiles, unsigned int maxSize)
+{
+    Light light;
+    light.importance = glm::clamp(importance, 0.f, 1.f);
+    light.nbTiles = nbTiles;
+    light.firstTile = (unsigned int)this->_tiles.size();
+    light.maxSize = std::min(maxSize, this->_size);
+    // Smallest power of two covering the light's share of its maximum
+    if (light.importance > 0.f && light.maxSize >= MIN_TILE_SIZE)
+    {
+        light.size = MIN_TILE_SIZE;
+        while (light.size < light.maxSize && light.size < light.importance * light.maxSize)
+            light.size *= 2;
+        // Last frame's size is kept while the target stays near its size class
+        auto last = this->_lastSizes.find(key);
+        float target = light.importance * light.maxSize;
+        if (last != this->_lastSizes.end() && last->second && last->second <= light.maxSize &&
+            target > 0.5f * last->second * (1.f - SIZE_HYSTERESIS) && target <= last->second * (1.f + SIZE_HYSTERESIS))
+            light.size = last->second;
+    }
+    this->_sizes[key] = light.size;
+    this->_lights.push_back(light);
+    this->_tiles.resize(this->_tiles.size() + nbTiles);
+    this->_shadowTiles.resize(this->_tiles.size());
+    return (unsigned int)this->_lights.size() - 1;
+}
+
+void ShadowAtlas::pack()
+{
+    size_t capacity = (size_t)this->_size * this->_size;
+    size_t used = 0;
+    // Lights the most oversized for their importance are shrunk first, lights at MIN_TILE_SIZE are dropped
+    auto getExcess = [](const Light &light) { return light.size / (light.importance * light.maxSize); };
+    std::priority_queue<std::pair<float, unsigned int>> shrinkable;
+    for (unsigned int i = 0; i < this->_lights.size(); ++i)
+    {
+        const Light &light = this->_lights[i];
+        used += (size_t)light.nbTiles * light.size * light.size;
+        if (light.size)
+            shrinkable.push(std::make_pair(getExcess(light), i));
+    }
+    while (used > capacity && !shrinkable.empty())
+    {
+        unsigned int index = shrinkable.top().second;
+        Light &light = this->_lights[index];
+        shrinkable.pop();
+        size_t area = (size_t)light.nbTiles * light.size * light.size;
+        if (light.size > MIN_TILE_SIZE)
+        {
+            light.size /= 2;
+            used -= area - area / 4;
+            shrinkable.push(std::make_pair(getExcess(light), index));
+        }
+        else
+        {
+            light.size = 0;
+            used -= area;
+        }
+    }
+
+    // Every tile placed before is at least as large, the offset is a whole number of tiles of the current size
+    this->_order.resize(this->_lights.size());
+    std::iota(this->_order.begin(), this->_order.end(), 0u);
+    std::stable_sort(this->_order.begin(), this->_order.end(), [this](unsigned int a, unsigned int b) {
+        return this->_lights[a].size > this->_lights[b].size;
+    });
+    size_t offset = 0; // Texels placed along the Z-order curve
+    for (unsigned int index : this->_order)
+    {
+        const Light &light = this->_lights[index];
+        for (unsigned int i = 0; i < light.nbTiles; ++i)
+        {
+            AtlasTile &tile = this->_tiles[light.firstTile + i];
+            tile = AtlasTile();
+            this->_shadowTiles[light.firstTile + i] = ShadowTile();
+            if (!light.size)
+                continue;
+            size_t cell = offset / ((size_t)light.size * light.size);
+            unsigned int x = 0, y = 0;
+            for (unsigned int bit = 0; cell >> (2 * bit); ++bit)
+            {
+                x |= (unsigned int)((cell >> (2 * bit)) & 1) << bit;
+                y |= (unsigned int)((cell >> (2 * bit + 1)) & 1) << bit;
+            }
+            tile.x = x * light.size;
+            tile.y = y * light.size;
+            tile.size = light.size;
+            offset += (size_t)light.size * light.size;
+        }
+    }
+    this->_usedTexels = offset;
+}
+
+const AtlasTile &ShadowAtlas::getTile(unsigned int light, unsigned int tile) const
+{
+    return this->_tiles[this->_lights[light].firstTile + tile];
+}
+
+size_t ShadowAtlas::getNbShadowedLights() const
+{
+    return std::count_if(this->_lights.begin(), this->_lights.end(), [](const Light &light) { return light.size > 0; });
+}
+
+void ShadowAtlas::setMatrix(unsigned int light, unsigned int tile, const glm::mat4 &viewProjection)
+{
+    const AtlasTile &atlasTile = this->getTile(light, tile);
+    ShadowTile &shadowTile = this->_shadowTiles[this->_lights[light].firstTile + tile];
+    if (!atlasTile.size)
+    {
+        shadowTile = ShadowTile();
+        return;
+    }
+    // Clip space to the tile's texture coordinates, depth to [0, 1]
+    float scale = 0.5f * atlasTile.size / this->_size;
+    glm::vec2 center = (glm::vec2(atlasTile.x, atlasTile.y) + 0.5f * atlasTile.size) / (float)this->_size;
+    glm::mat4 bias(1.f);
+    bias[0][0] = scale;
+    bias[1][1] = scale;
+    bias[2][2] = 0.5f;
+    bias[3] = glm::vec4(center, 0.5f, 1.f);
+    shadowTile.matrix = bias * viewProjection;
+    shadowTile.rect = glm::vec4(atlasTile.x, atlasTile.y, atlasTile.x + atlasTile.size, atlasTile.y + atlasTile.size) / (float)this->_size;
+}
+
+void ShadowAtlas::upload(OpenGLContext &context, const glm::uvec4 &firstTiles)
+{
+    // Empty ranges cannot be bound, the buffer keeps at least one tile
+    FrameRingBuffer &frameData = context.getFrameData();
+    size_t nbTiles = this->_shadowTiles.size();
+    FrameAllocation range = frameData.allocate(sizeof(ShadowAtlasHeader) + std::max<size_t>(nbTiles, 1) * sizeof(ShadowTile));
+    if (!range.data)
+        return;
+    ShadowAtlasHeader header;
+    float size = (float)std::max(this->_size, 1u);
+    header.size = glm::vec4(size, size, 1.f / size, 1.f / size);
+    header.firstTiles = firstTiles;
+    unsigned char *data = static_cast<unsigned char *>(range.data);
+    std::memcpy(data, &header, sizeof(ShadowAtlasHeader));
+    if (nbTiles)
+        std::memcpy(data + sizeof(ShadowAtlasHeader), this->_shadowTiles.data(), nbTiles * sizeof(ShadowTile));
+    else
+    {
+        ShadowTile empty;
+        std::memcpy(data + sizeof(ShadowAtlasHeader), &empty, sizeof(ShadowTile));
+    }
+    frameData.bindRange(GL_SHADER_STORAGE_BUFFER, TILES_BINDING, range);
+}
+
+void ShadowAtlas::clearTile(OpenGLContext &context, const AtlasTile &tile)
+{
+    // The scissor is not tracked by the state cache, it is only enabled here
+    GLStateCache &state = context.getState();
+    state.enable(GL_SCISSOR_TEST);
+    glScissor(tile.x, tile.y, tile.size, tile.size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    state.disable(GL_SCISSOR_TEST);
+}
+
+void ShadowAtlas::copyCachedTile(const AtlasTile &tile)
+{
+    glCopyImageSubData(this->_cacheFramebuffer.getDepthBuffer().getId(), GL_TEXTURE_2D, 0, tile.x, tile.y, 0,
+                       this->_framebuffer.getDepthBuffer().getId(), GL_TEXTURE_2D, 0, tile.x, tile.y, 0, tile.size, tile.size, 1);
+}
+
+} // namespace leo
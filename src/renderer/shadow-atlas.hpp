@@ -0,0 +1,101 @@
+#pragma once
+
+#include <renderer/global.hpp>
+#include <renderer/framebuffer.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace leo
+{
+
+class OpenGLContext;
+
+typedef struct AtlasTile
+{
+  unsigned int x = 0; // Texels
+  unsigned int y = 0;
+  unsigned int size = 0; // No tile when 0
+
+  bool operator==(const AtlasTile &other) const { return this->x == other.x && this->y == other.y && this->size == other.size; }
+  bool operator!=(const AtlasTile &other) const { return !(*this == other); }
+} AtlasTile;
+
+typedef struct ShadowTile
+{
+  glm::mat4 matrix; // World space to atlas texture coordinates and depth
+  glm::vec4 rect;   // Atlas texture coordinates of the tile, min then max, empty without a shadow
+} ShadowTile;
+
+typedef struct ShadowAtlasHeader
+{
+  glm::vec4 size;        // xy: texels, zw: size of a texel
+  glm::uvec4 firstTiles; // Of each kind of light, see SceneContext::updateShadowAtlas
+} ShadowAtlasHeader;
+
+/* One 16 bit depth texture holding the shadow maps of every light, sized from a memory budget.
+   * Each frame the lights are added with an importance in [0, 1] and a number of square tiles, one per
+   * view of the light. A light's tiles get a power of two size scaling with its importance, from
+   * MIN_TILE_SIZE to the light's maximum. When they do not fit the atlas, the tiles largest for their light's
+   * importance are halved first, so that every light shrinks in proportion, and the least important lights
+   * are dropped once at MIN_TILE_SIZE. A light keeps last frame's size until its importance leaves that size
+   * class by SIZE_HYSTERESIS, so that small changes of importance do not move the tiles.
+   * Tiles are then placed from the largest along a Z-order curve, which packs powers of two without holes,
+   * so that unchanged lights keep the same tiles from one frame to the next.
+   * The tiles' matrices are bound for the frame as an std430 buffer, indexed by the lighting shaders.
+   * A second texture of the same size caches the depth of the static casters at the same tiles, copied
+   * under the dynamic casters of the frame. The memory budget covers both.
+   */
+class ShadowAtlas
+{
+public:
+  void init(size_t memoryBudget);
+  void clear();
+  unsigned int addLight(unsigned int key, float importance, unsigned int nbTiles, unsigned int maxSize); // Key of the light across frames
+  void pack();
+  const AtlasTile &getTile(unsigned int light, unsigned int tile) const;
+  void setMatrix(unsigned int light, unsigned int tile, const glm::mat4 &viewProjection);
+  void upload(OpenGLContext &context, const glm::uvec4 &firstTiles);
+  void clearTile(OpenGLContext &context, const AtlasTile &tile); // Atlas or cache bound as the draw framebuffer
+  void copyCachedTile(const AtlasTile &tile);                      // From the cache to the atlas
+
+public:
+  Framebuffer &getFramebuffer() { return this->_framebuffer; }
+  Framebuffer &getCacheFramebuffer() { return this->_cacheFramebuffer; }
+  GLuint getTextureId() const { return this->_size ? this->_framebuffer.getDepthBuffer().getId() : 0; }
+  unsigned int getSize() const { return this->_size; }
+  size_t getNbLights() const { return this->_lights.size(); }
+  size_t getNbShadowedLights() const;
+  size_t getUsedTexels() const { return this->_usedTexels; }
+
+public:
+  static const unsigned int MIN_TILE_SIZE = 64;
+  static const unsigned int MAX_TILE_SIZE = 2048;
+  static const GLuint TILES_BINDING = 10; // After the light clusters
+  static const unsigned int NB_LAYERS = 2;  // Atlas and static caster cache
+  static constexpr float SIZE_HYSTERESIS = 0.25f; // Share of a size class crossed before a tile changes size
+
+private:
+  typedef struct Light
+  {
+    float importance = 0.f;
+    unsigned int nbTiles = 0;
+    unsigned int firstTile = 0;
+    unsigned int maxSize = 0;
+    unsigned int size = 0;
+  } Light;
+
+private:
+  Framebuffer _framebuffer;
+  Framebuffer _cacheFramebuffer;
+  unsigned int _size = 0; // Texels per side, a power of two
+  std::vector<Light> _lights;
+  std::unordered_map<unsigned int, unsigned int> _sizes;     // Requested by each light this frame, by key
+  std::unordered_map<unsigned int, unsigned int> _lastSizes; // Of the last frame
+  std::vector<unsigned int> _order; // Of the lights, by tile size then addition
+  std::vector<AtlasTile> _tiles;
+  std::vector<ShadowTile> _shadowTiles;
+  size_t _usedTexels = 0;
+};
+
+} // namespace leo
@@ -4,6 +4,7 @@
 #include <renderer/opengl-context.hpp>
 #include <renderer/framebuffer.hpp>
 #include <renderer/scene-context.hpp>
+#include <renderer/light-wrapper.hpp>
 
 #include <model/scene-graph.hpp>
 #include <model/entity.hpp>
@@ -23,68 +24,127 @@ void ShadowMappingNode::render()
     if (!this->_output)
         return;
 
-    glClearColor(1.0, 1.0, 1.0, 1);
+    const DirectionLightWrapper &wrapper = this->_sceneContext.dLights.find(this->_light.getId())->second;
+    ShadowAtlas &atlas = this->_sceneContext.shadowAtlas;
+    const AtlasTile &tile = atlas.getTile(wrapper.shadowSlot, 0);
+    if (tile != this->_tile)
+        this->_cacheValid = false;
+    this->_tile = tile;
+    if (!tile.size || (this->_cacheValid && !this->_dynamicCasters && !this->_drewDynamicCasters))
+    {
+        // The tile still holds last frame's shadows
+        this->_cullStats = CullStats();
+        return;
+    }
+
+    this->_context.getState().clearColor(1.0, 1.0, 1.0, 1);
 
     this->_loadShader();
 
     this->_loadInputFramebuffers();
 
-    this->_loadOutputFramebuffer();
-
-    glEnable(GL_DEPTH_TEST);
-
-    // 1. first render to depth map
-    glViewport(0, 0, 1620 * 2, 1080 * 2);
+    this->_context.getState().enable(GL_DEPTH_TEST);
 
-    glClear(GL_DEPTH_BUFFER_BIT);
+    this->_context.getState().viewport(tile.x, tile.y, tile.size, tile.size);
 
     this->_shader.setMat4("lightSpaceMatrix", this->_lightSpaceMatrix);
 
+    // Casters are gathered first and drawn with one multi-draw per geometry page
     glm::mat4x4 m;
-    this->_renderRec(this->_sceneGraph.getRoot(), &m);
+    this->_draws.clear();
+    this->_staticDraws.clear();
+    this->_cullStats = CullStats();
+    this->_renderRec(this->_sceneGraph.getRoot(), &m, true, false);
+
+    // 1. first render the static casters to the cache layer when they changed
+    if (!this->_cacheValid)
+    {
+        this->_context.loadFramebuffer(&atlas.getCacheFramebuffer());
+        atlas.clearTile(this->_context, tile);
+        this->_staticDraws.upload(this->_context);
+        this->_staticDraws.cull(this->_context, this->_lightSpaceMatrix, false); // Casters hidden from the camera still cast shadows
+        this->_staticDraws.draw(this->_context);
+        this->_cacheValid = true;
+    }
+
+    // 2. then the dynamic ones over a copy of it, in the light's tile of the shadow atlas
+    atlas.copyCachedTile(tile);
+    if (this->_draws.size())
+    {
+        this->_loadOutputFramebuffer();
+        this->_draws.upload(this->_context);
+        this->_draws.cull(this->_context, this->_lightSpaceMatrix, false);
+        this->_draws.draw(this->_context);
+    }
+    this->_drewDynamicCasters = this->_draws.size() > 0;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    this->_context.getState().bindFramebuffer(GL_FRAMEBUFFER, 0);
     // 2. then render scene as normal with shadow mapping (using depth map)
-    glViewport(0, 0, 1620, 1080);
+    this->_context.getState().viewport(0, 0, 1620, 1080);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void ShadowMappingNode::_renderRec(const Entity *root, const glm::mat4x4 *matrix)
+void ShadowMappingNode::_renderRec(const Entity *root, const glm::mat4x4 *matrix, bool testBounds, bool dynamic)
 {
+    unsigned int nbVolumes = root->getSubtreeVolumeCount();
+    if (!nbVolumes)
+        return;
+    if (testBounds)
+    {
+        this->_cullStats.tested++;
+        FrustumTest result = this->_frustum.test(root->getSubtreeBounds());
+        if (result == OUTSIDE_FRUSTUM)
+        {
+            this->_cullStats.culled += nbVolumes;
+            return;
+        }
+        testBounds = result == INTERSECTS_FRUSTUM;
+    }
+
     const glm::mat4x4 *newMatrix = matrix;
     const IComponent *p_component;
     p_component = root->getComponent(ComponentType::TRANSFORMATION);
     if (p_component)
     {
         newMatrix = &(static_cast<const Transformation *>(p_component))->getTransformationMatrix();
-        this->_shader.setMat4("model", *newMatrix);
+        dynamic = dynamic || this->_sceneContext.isDynamicCaster(root->getId());
     }
 
     p_component = root->getComponent(ComponentType::VOLUME);
     if (p_component)
     {
-        this->_context.drawVolume(*static_cast<const Volume *>(p_component),
-                                  this->_sceneContext.bufferCollections.find(p_component->getId())->second);
+        bool visible = true;
+        if (testBounds && root->getChildren().size())
+        {
+            this->_cullStats.tested++;
+            visible = this->_frustum.test(root->getWorldBounds()) != OUTSIDE_FRUSTUM;
+        }
+        // Static casters are only needed to redraw the cache
+        MultiDrawBuffer *draws = dynamic ? &this->_draws : (this->_cacheValid ? nullptr : &this->_staticDraws);
+        if (visible && draws)
+        {
+            this->_cullStats.visible++;
+            draws->add(this->_context.getGeometryPool().allocate(*static_cast<const Volume *>(p_component)), *newMatrix);
+        }
+        else if (!visible)
+            this->_cullStats.culled++;
     }
 
     for (auto &child : root->getChildren())
-        this->_renderRec(child.second, newMatrix);
-    if (newMatrix != matrix)
-        this->_shader.setMat4("model", *matrix);
+        this->_renderRec(child.second, newMatrix, testBounds, dynamic);
 }
 
 void ShadowMappingNode::_loadShader()
 {
     RenderNode::_loadShader();
     this->_shader.use();
-
-    glm::mat4 m;
-    this->_shader.setMat4("model", m);
 }
 
 void ShadowMappingNode::setLightSpaceMatrix(glm::mat4x4 lightSpaceMatrix)
 {
     this->_lightSpaceMatrix = lightSpaceMatrix;
+    this->_frustum = Frustum(lightSpaceMatrix);
+    this->_cacheValid = false;
 }
 
 void ShadowMappingNode::notified(Subject *subject, Event event)
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <renderer/render-node.hpp>
+#include <renderer/multi-draw-buffer.hpp>
+#include <renderer/shadow-atlas.hpp>
 #include <controller/observer.hpp>
 
 namespace leo
@@ -10,6 +12,11 @@ class DirectionLight;
 class Entity;
 class SceneGraph;
 
+/* Shadow map of a direction light, in its tile of the SceneContext's ShadowAtlas.
+   * The static casters are drawn to the atlas' cache layer and kept there until the tile moves or the
+   * SceneContext invalidates the cache, the dynamic ones are drawn over a copy of it on the frames where
+   * one of them is in the light's reach.
+   */
 class ShadowMappingNode : public RenderNode
 {
   public:
@@ -19,14 +26,23 @@ class ShadowMappingNode : public RenderNode
     virtual void render() override;
     virtual void notified(Subject *subject, Event event) override;
     void setLightSpaceMatrix(glm::mat4x4 lightSpaceMatrix);
+    void invalidateCache() { this->_cacheValid = false; }
+    void setDynamicCasters(bool inReach) { this->_dynamicCasters = inReach; }
 
   private:
-    void _renderRec(const Entity *root, const glm::mat4x4 *matrix);
+    void _renderRec(const Entity *root, const glm::mat4x4 *matrix, bool testBounds, bool dynamic);
     virtual void _loadShader() override;
 
   private:
     const DirectionLight &_light;
     const SceneGraph &_sceneGraph;
+    MultiDrawBuffer _draws;       // Dynamic casters
+    MultiDrawBuffer _staticDraws; // Only gathered when the cache is redrawn
     glm::mat4x4 _lightSpaceMatrix;
+    Frustum _frustum; // Box of the orthographic light projection
+    AtlasTile _tile;  // Of the last frame
+    bool _cacheValid = false;
+    bool _dynamicCasters = false;     // In the light's reach this frame, set by the SceneContext
+    bool _drewDynamicCasters = false; // Over the cached tile, last frame
 };
 } // namespace leo
\ No newline at end of file
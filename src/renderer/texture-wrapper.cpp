@@ -1,12 +1,71 @@
 #include "texture-wrapper.hpp"
 
+#include <renderer/gl-extensions.hpp>
+#include <renderer/gl-state-cache.hpp>
+#include <renderer/gpu-memory-tracker.hpp>
+
+#include <utils/packed-float.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
 namespace leo
 {
 
+namespace
+{
+
+typedef struct CookedTextureHeader
+{
+    char magic[4] = {'B', 'C', '6', 'H'};
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t levels = 0;
+    uint32_t size = 0; // Of the blocks of every level, from the largest
+} CookedTextureHeader;
+
+// 16 bytes per 4x4 block, partial blocks at the edges are padded
+size_t getBC6HLevelSize(unsigned int width, unsigned int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+}
+
+// 2x2 box filter of RGB floats, the last row or column is repeated on odd sizes
+void downsampleRGB(const std::vector<float> &source, unsigned int width, unsigned int height, std::vector<float> &destination)
+{
+    unsigned int halfWidth = width > 1 ? width / 2 : 1;
+    unsigned int halfHeight = height > 1 ? height / 2 : 1;
+    destination.resize((size_t)halfWidth * halfHeight * 3);
+    for (unsigned int y = 0; y < halfHeight; ++y)
+    {
+        unsigned int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (unsigned int x = 0; x < halfWidth; ++x)
+        {
+            unsigned int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (unsigned int c = 0; c < 3; ++c)
+            {
+                destination[((size_t)y * halfWidth + x) * 3 + c] =
+                    0.25f * (source[((size_t)y0 * width + x0) * 3 + c] + source[((size_t)y0 * width + x1) * 3 + c] +
+                             source[((size_t)y1 * width + x0) * 3 + c] + source[((size_t)y1 * width + x1) * 3 + c]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+std::map<GLuint, GLuint64> TextureWrapper::_residentHandles;
+
 TextureWrapper::TextureWrapper(const Texture &texture, GLTextureOptions glOptions, TextureOptions textureOptions)
     : _id(0), _texture(&texture), _glOptions(glOptions), _options(textureOptions)
 {
-    init(texture.data, texture.width, texture.height);
+    if (texture.hdrData)
+        this->_initHdr(texture);
+    else
+        init(texture.data, texture.width, texture.height);
 }
 
 TextureWrapper::TextureWrapper(unsigned int width, unsigned int height, GLTextureOptions glOptions, TextureOptions textureOptions)
@@ -26,8 +85,16 @@ TextureWrapper::TextureWrapper(const std::vector<std::shared_ptr<Texture>> &text
     init(textures[0]->data, textures[0]->width, textures[0]->height, &textures);
 }
 
+TextureWrapper::TextureWrapper(const TextureArray &textureArray, GLTextureOptions glOptions, TextureOptions textureOptions)
+    : _id(0), _glOptions(glOptions), _options(textureOptions)
+{
+    this->_initArray(textureArray);
+}
+
 TextureWrapper::TextureWrapper(const TextureWrapper &other)
-    : _id(other._id), _texture(other._texture), _options(other._options)
+    : _id(other._id), _texture(other._texture), _options(other._options), _glOptions(other._glOptions),
+      _width(other._width), _height(other._height), _levels(other._levels), _layers(other._layers),
+      _sizedInternalFormat(other._sizedInternalFormat)
 {
 }
 
@@ -41,6 +108,11 @@ TextureWrapper &TextureWrapper::operator=(const TextureWrapper &other)
     this->_texture = other._texture;
     this->_glOptions = other._glOptions;
     this->_options = other._options;
+    this->_width = other._width;
+    this->_height = other._height;
+    this->_levels = other._levels;
+    this->_layers = other._layers;
+    this->_sizedInternalFormat = other._sizedInternalFormat;
     return *this;
 }
 
@@ -49,10 +121,16 @@ void TextureWrapper::init(unsigned char *data, unsigned int width, unsigned int
     glGenTextures(1, &this->_id);
 
     GLuint textureType = this->_glOptions.textureType;
-    glBindTexture(textureType, this->_id);
-    GLuint internalFormat = this->_glOptions.internalFormat;
+    GLStateCache::getInstance()->bindTexture(textureType, this->_id);
+    GLuint internalFormat = getSizedInternalFormat(this->_glOptions.internalFormat, this->_glOptions.type);
     GLuint format = this->_glOptions.format;
     GLuint type = this->_glOptions.type;
+    bool isDepth = format == GL_DEPTH_COMPONENT;
+    GLsizei levels = this->_options.mipmaps && textureType != GL_TEXTURE_2D_MULTISAMPLE ? getLevelCount(width, height) : 1;
+    this->_width = width;
+    this->_height = height;
+    this->_levels = levels;
+    this->_sizedInternalFormat = internalFormat;
 
     if (textureType != GL_TEXTURE_2D_MULTISAMPLE)
     { // The following is not applicable to multisampled textures
@@ -60,40 +138,53 @@ void TextureWrapper::init(unsigned char *data, unsigned int width, unsigned int
         glTexParameteri(textureType, GL_TEXTURE_WRAP_S, wrapping);
         glTexParameteri(textureType, GL_TEXTURE_WRAP_T, wrapping);
         glTexParameteri(textureType, GL_TEXTURE_WRAP_R, wrapping);
-        if (internalFormat == GL_DEPTH_COMPONENT)
+        if (isDepth)
         {
             float borderColor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
             glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
         }
-        glTexParameteri(textureType, GL_TEXTURE_MIN_FILTER, internalFormat == GL_DEPTH_COMPONENT ? GL_NEAREST : GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(textureType, GL_TEXTURE_MAG_FILTER, internalFormat == GL_DEPTH_COMPONENT ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(textureType, GL_TEXTURE_MIN_FILTER, isDepth ? GL_NEAREST : levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(textureType, GL_TEXTURE_MAG_FILTER, isDepth ? GL_NEAREST : GL_LINEAR);
+    }
+
+    // Immutable storage with the exact number of levels we need
+    if (textureType == GL_TEXTURE_2D_MULTISAMPLE)
+    {
+        glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, this->_options.nbSamples, internalFormat, width, height, GL_TRUE);
+    }
+    else if (textureType == GL_TEXTURE_2D_ARRAY)
+    {
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, this->_layers);
+    }
+    else
+    {
+        glTexStorage2D(textureType, levels, internalFormat, width, height);
     }
 
     if (textureType == GL_TEXTURE_CUBE_MAP)
     {
         for (int i = 0; i < 6; ++i)
         {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                         0, internalFormat, width, height, 0, format, type,
-                         textures ? (*textures)[i]->data : data);
+            const unsigned char *faceData = textures ? (*textures)[i]->data : data;
+            if (faceData)
+                glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, width, height, format, type, faceData);
         }
     }
-    else if (textureType == GL_TEXTURE_2D_MULTISAMPLE)
-    {
-        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, this->_options.nbSamples, internalFormat, width, height, GL_TRUE);
-    }
-    else  // GL_TEXTURE_2D
+    else if (textureType == GL_TEXTURE_2D && data)
     {
-        glTexImage2D(textureType, 0, internalFormat, width, height, 0, format,
-                     type, data ? data : 0);
+        glTexSubImage2D(textureType, 0, 0, 0, width, height, format, type, data);
     }
 
-    if (textureType != GL_TEXTURE_2D_MULTISAMPLE)
-    { // The following is not applicable to multisampled textures
+    if (levels > 1 && (data || textures))
+    {
         glGenerateMipmap(textureType);
     }
 
-    glBindTexture(textureType, 0);
+    GLStateCache::getInstance()->bindTexture(textureType, 0);
+
+    // Render targets are reclassified by their framebuffer
+    GPUMemoryTracker::getInstance()->track(GL_TEXTURE, this->_id, GPUMemoryCategory::MATERIAL_TEXTURES, this->getMemorySize(),
+                                           this->_texture ? this->_texture->path : textureType == GL_TEXTURE_2D_ARRAY ? "texture array" : "texture");
 }
 
 GLuint TextureWrapper::getId() const
@@ -101,4 +192,297 @@ GLuint TextureWrapper::getId() const
     return this->_id;
 }
 
+GLuint64 TextureWrapper::getBindlessHandle() const
+{
+    if (!GLExtensions::bindlessTexture || !this->_id)
+        return 0;
+    auto it = _residentHandles.find(this->_id);
+    if (it != _residentHandles.end())
+        return it->second;
+    // The texture parameters become immutable once a handle exists
+    GLuint64 handle = GLExtensions::glGetTextureHandleARB(this->_id);
+    GLExtensions::glMakeTextureHandleResidentARB(handle);
+    _residentHandles.insert(std::pair<GLuint, GLuint64>(this->_id, handle));
+    return handle;
+}
+
+void TextureWrapper::destroy()
+{
+    // Wrappers are copied around freely, only the owner of the texture may call this
+    auto it = _residentHandles.find(this->_id);
+    if (it != _residentHandles.end())
+    {
+        GLExtensions::glMakeTextureHandleNonResidentARB(it->second);
+        _residentHandles.erase(it);
+    }
+    GPUMemoryTracker::getInstance()->untrack(GL_TEXTURE, this->_id);
+    GLStateCache::getInstance()->forgetTexture(this->_id);
+    glDeleteTextures(1, &this->_id);
+    this->_id = 0;
+}
+
+size_t TextureWrapper::getMemorySize() const
+{
+    size_t size = 0;
+    unsigned int width = this->_width;
+    unsigned int height = this->_height;
+    for (GLsizei level = 0; level < this->_levels; ++level)
+    {
+        size += (size_t)(width * height * getBytesPerPixel(this->_sizedInternalFormat));
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    if (this->_glOptions.textureType == GL_TEXTURE_CUBE_MAP)
+        size *= 6;
+    else if (this->_glOptions.textureType == GL_TEXTURE_2D_ARRAY)
+        size *= this->_layers;
+    else if (this->_glOptions.textureType == GL_TEXTURE_2D_MULTISAMPLE)
+        size *= this->_options.nbSamples;
+    return size;
+}
+
+GLTextureOptions TextureWrapper::getDefaultOptions(const Texture &texture)
+{
+    GLTextureOptions options;
+    if (texture.mode == HDR)
+    {
+        // Shared exponent keeps the full dynamic range in 4 bytes per texel instead of 12 for RGB32F
+        options.internalFormat = GL_RGB9_E5;
+        options.format = GL_RGB;
+        options.type = GL_FLOAT;
+    }
+    else if (texture.mode == RGBA || texture.mode == SRGBA)
+    {
+        options.format = options.internalFormat = GL_RGBA;
+    }
+    else
+    {
+        options.format = options.internalFormat = GL_RGB;
+    }
+    return options;
+}
+
+GLuint TextureWrapper::getSizedInternalFormat(GLuint internalFormat, GLuint type)
+{
+    // glTexStorage* only accepts sized formats
+    switch (internalFormat)
+    {
+    case GL_RGBA:
+        return type == GL_FLOAT ? GL_RGBA32F : GL_RGBA8;
+    case GL_RGB:
+        return type == GL_FLOAT ? GL_RGB32F : GL_RGB8;
+    case GL_RG:
+        return type == GL_FLOAT ? GL_RG32F : GL_RG8;
+    case GL_RED:
+        return type == GL_FLOAT ? GL_R32F : GL_R8;
+    case GL_DEPTH_COMPONENT:
+        return type == GL_FLOAT ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24;
+    case GL_DEPTH_STENCIL:
+        return GL_DEPTH24_STENCIL8;
+    default:
+        return internalFormat;
+    }
+}
+
+GLsizei TextureWrapper::getLevelCount(unsigned int width, unsigned int height)
+{
+    GLsizei levels = 1;
+    for (unsigned int size = width > height ? width : height; size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+float TextureWrapper::getBytesPerPixel(GLuint sizedInternalFormat)
+{
+    switch (sizedInternalFormat)
+    {
+    case GL_R8:
+        return 1.f;
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+        return 2.f;
+    case GL_RGB8:
+    case GL_SRGB8:
+    case GL_DEPTH_COMPONENT24:
+        return 3.f;
+    case GL_RGBA8:
+    case GL_SRGB8_ALPHA8:
+    case GL_RG16F:
+    case GL_R32F:
+    case GL_RGB9_E5:
+    case GL_R11F_G11F_B10F:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+        return 4.f;
+    case GL_RGB16F:
+        return 6.f;
+    case GL_RGBA16F:
+    case GL_RG32F:
+        return 8.f;
+    case GL_RGB32F:
+        return 12.f;
+    case GL_RGBA32F:
+        return 16.f;
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        return 1.f; // 16 bytes per 4x4 block
+    default:
+        return 4.f;
+    }
+}
+
+void TextureWrapper::_initHdr(const Texture &texture)
+{
+    GLuint internalFormat = this->_glOptions.internalFormat;
+    if (internalFormat == GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT)
+    {
+        this->_initBC6H(texture);
+        return;
+    }
+
+    this->_glOptions.format = GL_RGB;
+    if (internalFormat != GL_RGB9_E5 && internalFormat != GL_R11F_G11F_B10F)
+    { // Plain float formats, let the driver convert
+        this->_glOptions.type = GL_FLOAT;
+        init(reinterpret_cast<unsigned char *>(texture.hdrData), texture.width, texture.height);
+        return;
+    }
+
+    // Pack on the CPU so that only 4 bytes per texel are sent to the driver
+    std::vector<uint32_t> packed(texture.width * texture.height);
+    for (size_t i = 0; i < packed.size(); ++i)
+    {
+        const float *rgb = texture.hdrData + i * 3;
+        packed[i] = internalFormat == GL_RGB9_E5 ? PackedFloat::packRGB9E5(rgb) : PackedFloat::packR11G11B10F(rgb);
+    }
+    this->_glOptions.type = internalFormat == GL_RGB9_E5 ? GL_UNSIGNED_INT_5_9_9_9_REV : GL_UNSIGNED_INT_10F_11F_11F_REV;
+    init(reinterpret_cast<unsigned char *>(packed.data()), texture.width, texture.height);
+}
+
+void TextureWrapper::_initBC6H(const Texture &texture)
+{
+    // BPTC formats are not color-renderable, glGenerateMipmap cannot fill them: every level is uploaded
+    this->_glOptions.format = GL_RGB;
+    this->_glOptions.type = GL_FLOAT;
+    init(nullptr, texture.width, texture.height);
+    GLStateCache::getInstance()->bindTexture(GL_TEXTURE_2D, this->_id);
+
+    std::string cookedPath = texture.path + ".bc6h";
+    std::vector<char> blocks;
+    if (_readCookedTexture(cookedPath, texture, this->_levels, blocks))
+    {
+        size_t offset = 0;
+        unsigned int width = texture.width, height = texture.height;
+        for (GLsizei level = 0; level < this->_levels; ++level)
+        {
+            size_t size = getBC6HLevelSize(width, height);
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,
+                                      (GLsizei)size, blocks.data() + offset);
+            offset += size;
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+        GLStateCache::getInstance()->bindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    // Not cooked yet: filter the float data on the CPU and let the driver encode each level, then save the blocks
+    std::vector<float> mip(texture.hdrData, texture.hdrData + (size_t)texture.width * texture.height * 3);
+    std::vector<float> nextMip;
+    bool encoded = true;
+    unsigned int width = texture.width, height = texture.height;
+    for (GLsizei level = 0; level < this->_levels; ++level)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_RGB, GL_FLOAT, mip.data());
+        GLint compressed = GL_FALSE;
+        GLint size = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        if (compressed == GL_TRUE && (size_t)size == getBC6HLevelSize(width, height))
+        {
+            size_t offset = blocks.size();
+            blocks.resize(offset + size);
+            glGetCompressedTexImage(GL_TEXTURE_2D, level, blocks.data() + offset);
+        }
+        else
+        {
+            encoded = false;
+        }
+        if (level + 1 < this->_levels)
+        {
+            downsampleRGB(mip, width, height, nextMip);
+            mip.swap(nextMip);
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+    }
+    if (encoded)
+        _writeCookedTexture(cookedPath, texture, this->_levels, blocks);
+    else
+        std::cerr << "TextureWrapper: BC6H encoding not supported by the driver for " << texture.path << std::endl;
+    GLStateCache::getInstance()->bindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureWrapper::_initArray(const TextureArray &textureArray)
+{
+    this->_glOptions.textureType = GL_TEXTURE_2D_ARRAY;
+    this->_layers = (GLsizei)textureArray.layers.size();
+    init(nullptr, textureArray.width, textureArray.height);
+
+    GLStateCache::getInstance()->bindTexture(GL_TEXTURE_2D_ARRAY, this->_id);
+    for (GLsizei i = 0; i < this->_layers; ++i)
+    {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, textureArray.width, textureArray.height, 1,
+                        this->_glOptions.format, this->_glOptions.type, textureArray.layers[i]->data);
+    }
+    if (this->_levels > 1)
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    GLStateCache::getInstance()->bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+bool TextureWrapper::_readCookedTexture(const std::string &path, const Texture &texture, GLsizei levels, std::vector<char> &blocks)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open())
+        return false;
+
+    CookedTextureHeader header;
+    CookedTextureHeader expected;
+    size_t size = 0;
+    for (GLsizei level = 0; level < levels; ++level)
+        size += getBC6HLevelSize(std::max(texture.width >> level, 1), std::max(texture.height >> level, 1));
+    ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!ifs || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) ||
+        header.width != (uint32_t)texture.width || header.height != (uint32_t)texture.height ||
+        header.levels != (uint32_t)levels || header.size != size)
+    {
+        std::cerr << "TextureWrapper: Ignoring stale cooked texture " << path << std::endl;
+        return false;
+    }
+
+    blocks.resize(header.size);
+    ifs.read(blocks.data(), header.size);
+    return (bool)ifs;
+}
+
+void TextureWrapper::_writeCookedTexture(const std::string &path, const Texture &texture, GLsizei levels, const std::vector<char> &blocks)
+{
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs.is_open())
+    {
+        std::cerr << "TextureWrapper: Cannot write cooked texture " << path << std::endl;
+        return;
+    }
+
+    CookedTextureHeader header;
+    header.width = texture.width;
+    header.height = texture.height;
+    header.levels = (uint32_t)levels;
+    header.size = (uint32_t)blocks.size();
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(blocks.data(), blocks.size());
+}
+
 } // namespace leo
\ No newline at end of file
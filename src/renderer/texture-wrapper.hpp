@@ -4,6 +4,10 @@
 
 #include <utils/texture.hpp>
 
+#include <model/texture-array.hpp>
+
+#include <map>
+#include <string>
 #include <vector>
 
 namespace leo
@@ -20,8 +24,8 @@ GLuint wrapping=GL_REPEAT;
 
 typedef struct TextureOptions
 {
-  
   unsigned int nbSamples = 4;
+  bool mipmaps = true;  // Render targets never sample lower levels, they should disable this
 } TextureOptions;
 
 class TextureWrapper
@@ -36,6 +40,7 @@ public:
   TextureWrapper(const Texture &texture, GLTextureOptions glOptions = {}, TextureOptions textureOptions = {});
   TextureWrapper(unsigned int width, unsigned int height, GLTextureOptions glOptions = {}, TextureOptions textureOptions = {});
   TextureWrapper(const std::vector<std::shared_ptr<Texture>> &textures, GLTextureOptions glOptions, TextureOptions textureOptions = {});
+  TextureWrapper(const TextureArray &textureArray, GLTextureOptions glOptions, TextureOptions textureOptions = {});
   TextureWrapper(const TextureWrapper &other);
   ~TextureWrapper();
   TextureWrapper &operator=(const TextureWrapper &other);
@@ -43,6 +48,25 @@ public:
 public:
   void init(unsigned char *data, unsigned int width, unsigned int height, const std::vector<std::shared_ptr<Texture>> *textures = nullptr);
   GLuint getId() const;
+  GLuint64 getBindlessHandle() const;
+  void destroy();
+  size_t getMemorySize() const;
+
+public:
+  static GLTextureOptions getDefaultOptions(const Texture &texture);
+  static GLuint getSizedInternalFormat(GLuint internalFormat, GLuint type);
+  static GLsizei getLevelCount(unsigned int width, unsigned int height);
+  static float getBytesPerPixel(GLuint sizedInternalFormat);
+
+private:
+  void _initHdr(const Texture &texture);
+  void _initBC6H(const Texture &texture);
+  void _initArray(const TextureArray &textureArray);
+  static bool _readCookedTexture(const std::string &path, const Texture &texture, GLsizei levels, std::vector<char> &blocks);
+  static void _writeCookedTexture(const std::string &path, const Texture &texture, GLsizei levels, const std::vector<char> &blocks);
+
+private:
+  static std::map<GLuint, GLuint64> _residentHandles; // Shared by the copies of a wrapper, keyed by texture id
 
 private:
   GLuint _id = 0;
@@ -50,6 +74,11 @@ private:
   TextureOptions _options;
   GLTextureOptions _glOptions;
   bool _gammaCorrection = true;
+  unsigned int _width = 0;
+  unsigned int _height = 0;
+  GLsizei _levels = 0;
+  GLsizei _layers = 1;
+  GLuint _sizedInternalFormat = 0;
 };
 
 } // namespace leo
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "uniform-table.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace leo
+{
+
+UniformTable::UniformTable(GLuint program) : _program(program)
+{
+  GLint nbUniforms = 0;
+  GLint maxLength = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &nbUniforms);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<GLchar> buffer(maxLength + 1);
+  for (GLint i = 0; i < nbUniforms; ++i)
+  {
+    GLuint index = i;
+    GLint blockIndex = -1;
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+    if (blockIndex != -1)
+      continue; // Backed by a buffer, no location
+
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program, index, (GLsizei)buffer.size(), nullptr, &size, &type, buffer.data());
+    std::string name(buffer.data());
+    size_t bracket = name.rfind("[0]");
+    if (bracket == std::string::npos || bracket + 3 != name.size())
+    {
+      this->_addUniform(name);
+      continue;
+    }
+    // Arrays are reported once as "name[0]". The bare name is not registered: it aliases the first
+    // element and would get its own, possibly stale, value cache
+    std::string base = name.substr(0, bracket);
+    for (GLint element = 0; element < size; ++element)
+      this->_addUniform(base + "[" + std::to_string(element) + "]");
+  }
+  std::sort(this->_uniforms.begin(), this->_uniforms.end(),
+            [](const UniformInfo &a, const UniformInfo &b) { return a.hash < b.hash; });
+
+  GLint nbBlocks = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &nbBlocks);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+  buffer.resize(maxLength + 1);
+  for (GLint i = 0; i < nbBlocks; ++i)
+  {
+    UniformBlockInfo block;
+    glGetActiveUniformBlockName(program, i, (GLsizei)buffer.size(), nullptr, buffer.data());
+    block.name = buffer.data();
+    block.hash = hash(block.name.c_str());
+    block.index = i;
+    GLint binding = 0;
+    glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+    block.binding = binding;
+    this->_blocks.push_back(block);
+  }
+}
+
+int UniformTable::find(const char *name) const
+{
+  uint32_t h = hash(name);
+  auto it = std::lower_bound(this->_uniforms.begin(), this->_uniforms.end(), h,
+                             [](const UniformInfo &u, uint32_t value) { return u.hash < value; });
+  for (; it != this->_uniforms.end() && it->hash == h; ++it)
+    if (!std::strcmp(it->name.c_str(), name))
+      return (int)(it - this->_uniforms.begin());
+  return -1;
+}
+
+bool UniformTable::updateValue(int handle, const void *value, size_t size)
+{
+  if (handle < 0)
+    return false;
+  UniformInfo &uniform = this->_uniforms[handle];
+  if (uniform.hasValue && !std::memcmp(uniform.value.data(), value, size))
+    return false;
+  std::memcpy(uniform.value.data(), value, size);
+  uniform.hasValue = true;
+  return true;
+}
+
+void UniformTable::bindBlock(const char *name, GLuint binding)
+{
+  uint32_t h = hash(name);
+  for (UniformBlockInfo &block : this->_blocks)
+  {
+    if (block.hash != h || block.name != name)
+      continue;
+    if (block.binding != binding)
+    {
+      glUniformBlockBinding(this->_program, block.index, binding);
+      block.binding = binding;
+    }
+    return;
+  }
+}
+
+uint32_t UniformTable::hash(const char *name)
+{
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for (; *name; ++name)
+  {
+    h ^= (unsigned char)*name;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void UniformTable::_addUniform(const std::string &name)
+{
+  UniformInfo uniform;
+  uniform.name = name;
+  uniform.hash = hash(name.c_str());
+  uniform.location = glGetUniformLocation(this->_program, name.c_str());
+  if (uniform.location != -1)
+    this->_uniforms.push_back(uniform);
+}
+
+UniformNameTable::UniformNameTable(const char *prefix, unsigned int count, const char *suffix)
+{
+  for (unsigned int i = 0; i < count; ++i)
+    this->_names.push_back(prefix + std::to_string(i) + suffix);
+}
+
+} // namespace leo
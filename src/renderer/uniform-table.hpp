@@ -0,0 +1,73 @@
+#pragma once
+
+#include <renderer/global.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace leo
+{
+
+typedef struct UniformInfo
+{
+  std::string name;
+  uint32_t hash = 0;
+  GLint location = -1;
+  std::array<unsigned char, 64> value; // Last uploaded value, large enough for a mat4
+  bool hasValue = false;
+} UniformInfo;
+
+typedef struct UniformBlockInfo
+{
+  std::string name;
+  uint32_t hash = 0;
+  GLuint index = GL_INVALID_INDEX;
+  GLuint binding = GL_INVALID_INDEX;
+} UniformBlockInfo;
+
+/* Reflection of the default block uniforms and uniform blocks of a linked program.
+   * Uniforms are addressed by handles (indices in the table), found by name hash without allocating.
+   * The last value uploaded to each uniform is kept so that redundant uploads can be skipped, which
+   * assumes every upload to the program goes through its table.
+   */
+class UniformTable
+{
+public:
+  UniformTable(GLuint program);
+
+public:
+  int find(const char *name) const;
+  GLint getLocation(int handle) const { return this->_uniforms[handle].location; }
+  bool updateValue(int handle, const void *value, size_t size);
+  void bindBlock(const char *name, GLuint binding);
+
+public:
+  static uint32_t hash(const char *name);
+
+private:
+  void _addUniform(const std::string &name);
+
+private:
+  GLuint _program = 0;
+  std::vector<UniformInfo> _uniforms; // Sorted by hash
+  std::vector<UniformBlockInfo> _blocks;
+};
+
+/* Precomputed names of indexed uniforms such as "shadowMap0", to avoid building strings every frame.
+   */
+class UniformNameTable
+{
+public:
+  UniformNameTable(const char *prefix, unsigned int count, const char *suffix = "");
+
+public:
+  const char *operator[](unsigned int i) const { return this->_names[i].c_str(); }
+  unsigned int size() const { return (unsigned int)this->_names.size(); }
+
+private:
+  std::vector<std::string> _names;
+};
+
+} // namespace leo
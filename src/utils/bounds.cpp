@@ -0,0 +1,63 @@
+#include "bounds.hpp"
+
+#include <algorithm>
+
+namespace leo
+{
+
+void AABB::add(const glm::vec3 &point)
+{
+  this->min = glm::min(this->min, point);
+  this->max = glm::max(this->max, point);
+}
+
+void AABB::add(const AABB &other)
+{
+  if (other.isEmpty())
+    return;
+  this->min = glm::min(this->min, other.min);
+  this->max = glm::max(this->max, other.max);
+}
+
+AABB AABB::transform(const glm::mat4 &matrix) const
+{
+  if (this->isEmpty())
+    return *this;
+  // The extent of the new box is the extent of the old one through the absolute linear part (Arvo)
+  glm::vec3 center = glm::vec3(matrix * glm::vec4(this->getCenter(), 1.f));
+  glm::mat3 linear = glm::mat3(matrix);
+  glm::vec3 extent = this->getExtent();
+  glm::vec3 newExtent = glm::abs(linear[0]) * extent.x + glm::abs(linear[1]) * extent.y + glm::abs(linear[2]) * extent.z;
+  AABB result;
+  result.min = center - newExtent;
+  result.max = center + newExtent;
+  return result;
+}
+
+bool AABB::intersects(const AABB &other) const
+{
+  return !this->isEmpty() && !other.isEmpty() &&
+         glm::all(glm::lessThanEqual(this->min, other.max)) && glm::all(glm::lessThanEqual(other.min, this->max));
+}
+
+BoundingSphere BoundingSphere::transform(const glm::mat4 &matrix) const
+{
+  if (this->isEmpty())
+    return *this;
+  BoundingSphere result;
+  result.center = glm::vec3(matrix * glm::vec4(this->center, 1.f));
+  float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+  result.radius = this->radius * scale;
+  return result;
+}
+
+bool BoundingSphere::intersects(const AABB &box) const
+{
+  if (this->isEmpty() || box.isEmpty())
+    return false;
+  glm::vec3 closest = glm::clamp(this->center, box.min, box.max);
+  glm::vec3 d = closest - this->center;
+  return glm::dot(d, d) <= this->radius * this->radius;
+}
+
+} // namespace leo
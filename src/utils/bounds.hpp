@@ -0,0 +1,37 @@
+#pragma once
+
+#define GLM_FORCE_CTOR_INIT
+#include <glm/glm.hpp>
+
+#include <limits>
+
+namespace leo
+{
+
+/* Axis aligned box, empty (min > max) until a point or a box is added to it.
+   */
+typedef struct AABB
+{
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+  bool isEmpty() const { return this->min.x > this->max.x; }
+  glm::vec3 getCenter() const { return (this->min + this->max) * 0.5f; }
+  glm::vec3 getExtent() const { return (this->max - this->min) * 0.5f; }
+  void add(const glm::vec3 &point);
+  void add(const AABB &other);
+  AABB transform(const glm::mat4 &matrix) const; // Box around the transformed box
+  bool intersects(const AABB &other) const;
+} AABB;
+
+typedef struct BoundingSphere
+{
+  glm::vec3 center;
+  float radius = -1.f; // Negative when empty
+
+  bool isEmpty() const { return this->radius < 0.f; }
+  BoundingSphere transform(const glm::mat4 &matrix) const; // Scaled by the largest axis scaling
+  bool intersects(const AABB &box) const;
+} BoundingSphere;
+
+} // namespace leo
@@ -0,0 +1,86 @@
+#include "frustum.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LEO_FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+#include <cmath>
+
+namespace leo
+{
+
+Frustum::Frustum()
+{
+  for (int i = 0; i < 8; ++i)
+  {
+    this->_x[i] = this->_y[i] = this->_z[i] = 0.f;
+    this->_w[i] = 1.f;
+  }
+}
+
+Frustum::Frustum(const glm::mat4 &viewProjection) : Frustum()
+{
+  // Gribb-Hartmann: the clip space tests -w <= x, y, z <= w written with the rows of the matrix
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; ++i)
+    rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+  this->_setPlane(0, rows[3] + rows[0]); // Left
+  this->_setPlane(1, rows[3] - rows[0]); // Right
+  this->_setPlane(2, rows[3] + rows[1]); // Bottom
+  this->_setPlane(3, rows[3] - rows[1]); // Top
+  this->_setPlane(4, rows[3] + rows[2]); // Near
+  this->_setPlane(5, rows[3] - rows[2]); // Far
+}
+
+void Frustum::_setPlane(int i, const glm::vec4 &plane)
+{
+  float length = glm::length(glm::vec3(plane));
+  this->_planes[i] = length > 0.f ? plane / length : plane;
+  this->_x[i] = this->_planes[i].x;
+  this->_y[i] = this->_planes[i].y;
+  this->_z[i] = this->_planes[i].z;
+  this->_w[i] = this->_planes[i].w;
+}
+
+FrustumTest Frustum::test(const AABB &box) const
+{
+  if (box.isEmpty())
+    return OUTSIDE_FRUSTUM;
+  // For each plane the box spans center distance +- the projection of its extent on the normal
+  glm::vec3 c = box.getCenter();
+  glm::vec3 e = box.getExtent();
+#ifdef LEO_FRUSTUM_SSE
+  const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+  const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+  const __m128 signMask = _mm_set1_ps(-0.f);
+  const __m128 zero = _mm_setzero_ps();
+  int outside = 0;
+  int intersects = 0;
+  for (int i = 0; i < 8; i += 4)
+  {
+    __m128 nx = _mm_load_ps(this->_x + i), ny = _mm_load_ps(this->_y + i), nz = _mm_load_ps(this->_z + i);
+    __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                                 _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(this->_w + i)));
+    __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                               _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+    outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+    intersects |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+  }
+#else
+  bool outside = false;
+  bool intersects = false;
+  for (int i = 0; i < NB_PLANES; ++i)
+  {
+    float distance = this->_x[i] * c.x + this->_y[i] * c.y + this->_z[i] * c.z + this->_w[i];
+    float radius = std::fabs(this->_x[i]) * e.x + std::fabs(this->_y[i]) * e.y + std::fabs(this->_z[i]) * e.z;
+    outside |= distance + radius < 0.f;
+    intersects |= distance - radius < 0.f;
+  }
+#endif
+  if (outside)
+    return OUTSIDE_FRUSTUM;
+  return intersects ? INTERSECTS_FRUSTUM : INSIDE_FRUSTUM;
+}
+
+} // namespace leo
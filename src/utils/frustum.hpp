@@ -0,0 +1,54 @@
+#pragma once
+
+#include <utils/bounds.hpp>
+
+#define GLM_FORCE_CTOR_INIT
+#include <glm/glm.hpp>
+
+namespace leo
+{
+
+enum FrustumTest
+{
+  OUTSIDE_FRUSTUM,
+  INTERSECTS_FRUSTUM,
+  INSIDE_FRUSTUM // Nothing under a box inside the frustum needs to be tested again
+};
+
+typedef struct CullStats
+{
+  unsigned int tested = 0;   // Bounds tested against the frustum
+  unsigned int visible = 0;  // Volumes kept
+  unsigned int culled = 0;   // Volumes rejected, with the subtrees they belong to
+  unsigned int occluded = 0; // Volumes in the frustum but hidden behind occluders
+} CullStats;
+
+/* Planes of a view-projection matrix, pointing inwards.
+   * They are stored by component so that a box is tested against four planes at once with SSE,
+   * the two extra lanes of the second batch hold planes that accept everything.
+   */
+class Frustum
+{
+public:
+  Frustum(); // Accepts everything
+  Frustum(const glm::mat4 &viewProjection);
+
+public:
+  FrustumTest test(const AABB &box) const;
+  const glm::vec4 &getPlane(int i) const { return this->_planes[i]; }
+
+public:
+  static const int NB_PLANES = 6;
+
+private:
+  void _setPlane(int i, const glm::vec4 &plane);
+
+private:
+  glm::vec4 _planes[NB_PLANES];
+  alignas(16) float _x[8];
+  alignas(16) float _y[8];
+  alignas(16) float _z[8];
+  alignas(16) float _w[8];
+};
+
+} // namespace leo
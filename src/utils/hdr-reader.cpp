@@ -0,0 +1,125 @@
+#include "hdr-reader.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace leo
+{
+
+float *HdrReader::readFile(const char *fileName, int &width, int &height)
+{
+  std::FILE *file = std::fopen(fileName, "rb");
+  if (!file)
+  {
+    std::cerr << "<HdrReader> ERROR: Cannot open file " << fileName << std::endl;
+    return nullptr;
+  }
+
+  // Header: "#?RADIANCE" followed by variables, terminated by an empty line
+  char line[256];
+  bool rgbe = false;
+  if (!std::fgets(line, sizeof(line), file) || std::strncmp(line, "#?", 2))
+  {
+    std::cerr << "<HdrReader> ERROR: Not a Radiance file " << fileName << std::endl;
+    std::fclose(file);
+    return nullptr;
+  }
+  while (std::fgets(line, sizeof(line), file) && line[0] != '\n' && line[0] != '\r')
+  {
+    if (!std::strncmp(line, "FORMAT=32-bit_rle_rgbe", 22))
+      rgbe = true;
+  }
+  if (!rgbe || !std::fgets(line, sizeof(line), file) || std::sscanf(line, "-Y %d +X %d", &height, &width) != 2)
+  {
+    std::cerr << "<HdrReader> ERROR: Unsupported format or orientation in " << fileName << std::endl;
+    std::fclose(file);
+    return nullptr;
+  }
+
+  float *data = new float[width * height * 3];
+  std::vector<unsigned char> scanline(width * 4);
+  for (int y = 0; y < height; y++)
+  {
+    if (!_readScanline(file, scanline.data(), width))
+    {
+      std::cerr << "<HdrReader> ERROR: Truncated or corrupted data in " << fileName << std::endl;
+      delete[] data;
+      std::fclose(file);
+      return nullptr;
+    }
+    float *row = data + y * width * 3;
+    for (int x = 0; x < width; x++)
+      _rgbeToFloat(&scanline[x * 4], row + x * 3);
+  }
+
+  std::fclose(file);
+  return data;
+}
+
+bool HdrReader::_readScanline(std::FILE *file, unsigned char *scanline, int width)
+{
+  unsigned char header[4];
+  if (std::fread(header, 1, 4, file) != 4)
+    return false;
+
+  // Flat scanline (also used for very short or very long lines)
+  if (width < 8 || width > 0x7fff || header[0] != 2 || header[1] != 2 || (header[2] & 0x80))
+  {
+    std::memcpy(scanline, header, 4);
+    return std::fread(scanline + 4, 4, width - 1, file) == (size_t)(width - 1);
+  }
+
+  if (((header[2] << 8) | header[3]) != width)
+    return false;
+
+  // New RLE: each of the four channels is stored separately as runs or literal dumps
+  for (int channel = 0; channel < 4; channel++)
+  {
+    int x = 0;
+    while (x < width)
+    {
+      int count = std::fgetc(file);
+      if (count == EOF)
+        return false;
+      if (count > 128)
+      {
+        count -= 128;
+        int value = std::fgetc(file);
+        if (value == EOF || x + count > width)
+          return false;
+        while (count--)
+          scanline[(x++) * 4 + channel] = (unsigned char)value;
+      }
+      else
+      {
+        if (count == 0 || x + count > width)
+          return false;
+        while (count--)
+        {
+          int value = std::fgetc(file);
+          if (value == EOF)
+            return false;
+          scanline[(x++) * 4 + channel] = (unsigned char)value;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void HdrReader::_rgbeToFloat(const unsigned char *rgbe, float *rgb)
+{
+  if (rgbe[3] == 0)
+  {
+    rgb[0] = rgb[1] = rgb[2] = 0.f;
+    return;
+  }
+  float f = std::ldexp(1.f, (int)rgbe[3] - (128 + 8));
+  rgb[0] = (rgbe[0] + 0.5f) * f;
+  rgb[1] = (rgbe[1] + 0.5f) * f;
+  rgb[2] = (rgbe[2] + 0.5f) * f;
+}
+
+} // namespace leo
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+
+namespace leo
+{
+
+/* Reads Radiance (.hdr) images stored as RGBE, flat or with the "new" run-length encoding.
+   * Pixels are decoded to tightly packed linear RGB floats, top row first like SOIL_load_image.
+   * The returned buffer must be released with delete[].
+   */
+class HdrReader
+{
+public:
+  static float *readFile(const char *fileName, int &width, int &height);
+
+private:
+  static bool _readScanline(std::FILE *file, unsigned char *scanline, int width);
+  static void _rgbeToFloat(const unsigned char *rgbe, float *rgb);
+};
+
+} // namespace leo
@@ -0,0 +1,79 @@
+#include "packed-float.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace leo
+{
+
+uint32_t PackedFloat::packRGB9E5(const float *rgb)
+{
+  // See EXT_texture_shared_exponent, 9 bits mantissas and a 5 bits exponent biased by 15
+  const int mantissaBits = 9;
+  const int bias = 15;
+  const float sharedExpMax = 65408.f;
+
+  float r = std::max(0.f, std::min(sharedExpMax, rgb[0]));
+  float g = std::max(0.f, std::min(sharedExpMax, rgb[1]));
+  float b = std::max(0.f, std::min(sharedExpMax, rgb[2]));
+  float maxRGB = std::max(r, std::max(g, b));
+  if (!(maxRGB > 0.f))
+    return 0;
+
+  int exponent = std::max(-bias - 1, (int)std::floor(std::log2(maxRGB))) + 1 + bias;
+  float denominator = std::ldexp(1.f, exponent - bias - mantissaBits);
+  if ((int)std::floor(maxRGB / denominator + 0.5f) == (1 << mantissaBits))
+  {
+    exponent++;
+    denominator *= 2.f;
+  }
+
+  uint32_t rm = (uint32_t)std::floor(r / denominator + 0.5f);
+  uint32_t gm = (uint32_t)std::floor(g / denominator + 0.5f);
+  uint32_t bm = (uint32_t)std::floor(b / denominator + 0.5f);
+  return rm | (gm << 9) | (bm << 18) | ((uint32_t)exponent << 27);
+}
+
+uint32_t PackedFloat::packR11G11B10F(const float *rgb)
+{
+  return _packUnsignedFloat(rgb[0], 6) |
+         (_packUnsignedFloat(rgb[1], 6) << 11) |
+         (_packUnsignedFloat(rgb[2], 5) << 22);
+}
+
+uint32_t PackedFloat::_packUnsignedFloat(float value, int mantissaBits)
+{
+  // Unsigned float with a 5 bits exponent biased by 15, negative values and NaN become 0
+  if (!(value > 0.f))
+    return 0;
+
+  const uint32_t maxFinite = (30u << mantissaBits) | ((1u << mantissaBits) - 1);
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  int exponent = (int)((bits >> 23) & 0xff) - 127;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (exponent > 15)
+    return maxFinite;
+
+  if (exponent >= -14)
+  {
+    int shift = 23 - mantissaBits;
+    uint32_t packed = mantissa >> shift;
+    packed += (mantissa >> (shift - 1)) & 1; // Round to nearest
+    if (packed == (1u << mantissaBits))
+    {
+      packed = 0;
+      exponent++;
+      if (exponent > 15)
+        return maxFinite;
+    }
+    return ((uint32_t)(exponent + 15) << mantissaBits) | packed;
+  }
+
+  // Denormal, rounding up to 1 << mantissaBits naturally gives the smallest normal value
+  return (uint32_t)std::floor(std::ldexp(value, 14 + mantissaBits) + 0.5f);
+}
+
+} // namespace leo
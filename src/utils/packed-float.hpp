@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace leo
+{
+
+/* CPU-side packing of linear RGB floats into the shared-exponent and small-float
+   * formats OpenGL accepts as GL_UNSIGNED_INT_5_9_9_9_REV and GL_UNSIGNED_INT_10F_11F_11F_REV.
+   * Both are 4 bytes per texel, a quarter of RGB32F.
+   */
+class PackedFloat
+{
+public:
+  static uint32_t packRGB9E5(const float *rgb);
+  static uint32_t packR11G11B10F(const float *rgb);
+
+private:
+  static uint32_t _packUnsignedFloat(float value, int mantissaBits);
+};
+
+} // namespace leo
@@ -1,4 +1,7 @@
 #include "texture.hpp"
+
+#include <utils/hdr-reader.hpp>
+
 #include <iostream>
 
 namespace leo
@@ -15,6 +18,11 @@ Texture::Texture(const char *path, TextureMode mode)
     : RegisteredObject(_count++), path(path),
       mode(mode)
 {
+  if (this->mode == HDR)
+  {
+    this->hdrData = HdrReader::readFile(path, this->width, this->height);
+    return;
+  }
   this->data = SOIL_load_image(path,
                                &this->width, &this->height, 0,
                                this->mode == RGBA || this->mode == SRGBA ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB);
@@ -26,6 +34,7 @@ Texture::~Texture()
   {
     SOIL_free_image_data(this->data);
   }
+  delete[] this->hdrData;
 }
 
 } // namespace leo
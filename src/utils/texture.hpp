@@ -32,6 +32,7 @@ public:
 
 public:
   unsigned char *data = nullptr;
+  float *hdrData = nullptr; // Linear RGB, only for TextureMode::HDR
   std::string path;
   int width = 0;
   int height = 0;
@@ -0,0 +1,107 @@
+#include "thread-pool.hpp"
+
+#include <algorithm>
+
+namespace leo
+{
+
+std::unique_ptr<ThreadPool> ThreadPool::_instance = std::unique_ptr<ThreadPool>(nullptr);
+
+ThreadPool *ThreadPool::getInstance()
+{
+  if (!_instance)
+  {
+    unsigned int nbCores = std::thread::hardware_concurrency();
+    _instance = std::unique_ptr<ThreadPool>(new ThreadPool(nbCores > 1 ? nbCores - 1 : 0));
+  }
+  return _instance.get();
+}
+
+ThreadPool::ThreadPool(size_t nbWorkers)
+{
+  for (size_t i = 0; i < nbWorkers; ++i)
+    this->_threads.push_back(std::thread(&ThreadPool::_work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_stop = true;
+  }
+  this->_wake.notify_all();
+  for (std::thread &thread : this->_threads)
+    thread.join();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &task)
+{
+  if (!count)
+    return;
+  if (this->_threads.empty() || count == 1)
+  {
+    for (size_t i = 0; i < count; ++i)
+      task(i);
+    return;
+  }
+
+  std::lock_guard<std::mutex> jobLock(this->_jobMutex);
+  {
+    // A worker that woke up too late for the previous job may still be leaving it
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_done.wait(lock, [this] { return this->_activeWorkers == 0; });
+    this->_task = &task;
+    this->_count = count;
+    this->_next = 0;
+    this->_remaining = count;
+    this->_generation++;
+  }
+  this->_wake.notify_all();
+
+  this->_runTasks(task, count);
+
+  std::unique_lock<std::mutex> lock(this->_mutex);
+  this->_done.wait(lock, [this] { return this->_remaining == 0 && this->_activeWorkers == 0; });
+  this->_task = nullptr;
+}
+
+void ThreadPool::_work()
+{
+  unsigned long long generation = 0;
+  while (true)
+  {
+    const std::function<void(size_t)> *task;
+    size_t count;
+    {
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      this->_wake.wait(lock, [this, generation] { return this->_stop || this->_generation != generation; });
+      if (this->_stop)
+        return;
+      generation = this->_generation;
+      if (!this->_task)
+        continue;
+      task = this->_task;
+      count = this->_count;
+      this->_activeWorkers++;
+    }
+
+    this->_runTasks(*task, count);
+
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_activeWorkers--;
+    }
+    this->_done.notify_all();
+  }
+}
+
+void ThreadPool::_runTasks(const std::function<void(size_t)> &task, size_t count)
+{
+  for (size_t i = this->_next++; i < count; i = this->_next++)
+  {
+    task(i);
+    this->_remaining--;
+  }
+}
+
+} // namespace leo
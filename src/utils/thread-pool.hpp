@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace leo
+{
+
+/* Worker threads shared by the CPU side jobs of the renderer, one per core besides the calling thread.
+   * parallelFor runs a task for every index of a range, the calling thread takes part and only
+   * returns once every index is done. A single job runs at a time.
+   */
+class ThreadPool
+{
+public:
+  static ThreadPool *getInstance();
+  ~ThreadPool();
+
+public:
+  void parallelFor(size_t count, const std::function<void(size_t)> &task);
+  size_t getNbThreads() const { return this->_threads.size() + 1; } // Including the calling thread
+
+private:
+  ThreadPool(size_t nbWorkers);
+  void _work();
+  void _runTasks(const std::function<void(size_t)> &task, size_t count);
+
+private:
+  static std::unique_ptr<ThreadPool> _instance;
+
+private:
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::mutex _jobMutex; // Serializes the callers
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  const std::function<void(size_t)> *_task = nullptr;
+  size_t _count = 0;
+  std::atomic<size_t> _next{0};
+  std::atomic<size_t> _remaining{0};
+  unsigned int _activeWorkers = 0; // Workers inside the current job
+  unsigned long long _generation = 0;
+  bool _stop = false;
+};
+
+} // namespace leo